@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pthread.h>
+
+#include "asyncwrite.h"
+#include "matrix.h"
+#include "message.h"
+
+/*
+ * Background matrix writes. A write takes a copy-on-write snapshot of the
+ * matrix, which costs O(1) and leaves the matrix free to be modified (the
+ * first modification copies the buffer instead), and queues it for a single
+ * I/O thread that writes the snapshots in submission order. Finished jobs
+ * stay listed until async_wait_matrix or async_flush collects their result,
+ * so errors reach the command that waits for them. The I/O thread prints
+ * nothing itself: the messages of a failed write are kept with its job and
+ * printed by the wait or flush that collects it, on the waiting thread.
+ **/
+
+typedef struct Async_Job {
+	struct Async_Job* next;
+	Matrix_t* snapshot;
+	char* filename;
+	char name[MATRIX_NAME_LEN];
+	Async_Write_Format_t format;
+	bool sync;
+	bool done;
+	bool ok;
+	char* messages; /* what a failed write printed, NULL when it succeeded */
+}Async_Job_t;
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t work_ready;
+	pthread_cond_t work_done;
+	pthread_t thread;
+	bool started;
+	bool stopping;
+	Async_Job_t* head;
+	Async_Job_t* tail;
+	Async_Job_t* next_job; /* oldest job the I/O thread has not started */
+}io = { .lock = PTHREAD_MUTEX_INITIALIZER, .work_ready = PTHREAD_COND_INITIALIZER,
+	.work_done = PTHREAD_COND_INITIALIZER };
+
+/*
+ * PURPOSE: writes queued snapshots one at a time until shutdown
+ * INPUTS:
+ *	arg unused
+ * RETURN:
+ *  NULL
+ *
+ **/
+static void* io_thread (void* arg) {
+	(void) arg;
+	pthread_mutex_lock(&io.lock);
+	for (;;) {
+		while (io.next_job == NULL && !io.stopping) {
+			pthread_cond_wait(&io.work_ready,&io.lock);
+		}
+		if (io.next_job == NULL) {
+			break;
+		}
+		Async_Job_t* job = io.next_job;
+		io.next_job = job->next;
+		pthread_mutex_unlock(&io.lock);
+
+		/* the messages of the write are kept for the thread that waits for it */
+		char* messages = NULL;
+		size_t messages_len = 0;
+		FILE* out = open_memstream(&messages,&messages_len);
+		message_set_stream(out);
+		bool ok;
+		if (job->format == ASYNC_WRITE_COMPRESSED) {
+			ok = write_matrix_compressed(job->filename,job->snapshot,job->sync);
+		}
+		else if (job->format == ASYNC_WRITE_TILED) {
+			ok = write_matrix_tiled(job->filename,job->snapshot,job->sync);
+		}
+		else {
+			ok = write_matrix_stream(job->filename,job->snapshot,job->sync);
+		}
+		if (!ok && out != NULL) {
+			message_printf("Background write of Matrix (%s) to %s failed\n", job->name, job->filename);
+		}
+		message_set_stream(NULL);
+		if (out != NULL) {
+			fclose(out);
+		}
+		if (ok) {
+			free(messages);
+			messages = NULL;
+		}
+		/* drops the snapshot reference, the buffer stays with the matrix */
+		destroy_matrix(&job->snapshot);
+
+		pthread_mutex_lock(&io.lock);
+		job->ok = ok;
+		job->messages = messages;
+		job->done = true;
+		pthread_cond_broadcast(&io.work_done);
+	}
+	pthread_mutex_unlock(&io.lock);
+	return NULL;
+}
+
+/* unlinks and frees every finished job that matches, io.lock held; prints
+ * the messages of the failed ones and returns false when there were any */
+static bool collect_jobs (const char* name, bool successful_only) {
+	bool ok = true;
+	Async_Job_t** link = &io.head;
+	io.tail = NULL;
+	while (*link != NULL) {
+		Async_Job_t* job = *link;
+		if (job->done && (name == NULL || strncmp(job->name,name,MATRIX_NAME_LEN) == 0)
+			&& (job->ok || !successful_only)) {
+			ok = ok && job->ok;
+			if (!job->ok) {
+				if (job->messages != NULL) {
+					message_printf("%s", job->messages);
+				}
+				else {
+					message_printf("Background write of Matrix (%s) to %s failed\n", job->name, job->filename);
+				}
+			}
+			*link = job->next;
+			free(job->messages);
+			free(job->filename);
+			free(job);
+		}
+		else {
+			io.tail = job;
+			link = &job->next;
+		}
+	}
+	return ok;
+}
+
+/*
+ * PURPOSE: queues a write of m to filename and returns at once, m may be
+ *	modified or deleted right away without affecting the written data
+ * INPUTS:
+ *	filename output file
+ *  m matrix to write, snapshotted copy-on-write
+ *  format file layout
+ *  sync force the data to disk before the write counts as done
+ * RETURN:
+ *  If the write was queued then true
+ *  else false; write errors are reported by async_wait_matrix and async_flush.
+ *
+ **/
+bool async_write_matrix (const char* filename, Matrix_t* m, Async_Write_Format_t format, bool sync) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (filename == NULL){
+		message_printf("the output file");
+		return false;
+	}
+	if (m == NULL){
+		message_printf("the matrix to be written");
+		return false;
+	}
+
+	Async_Job_t* job = calloc(1,sizeof(Async_Job_t));
+	if (!job) {
+		return false;
+	}
+	job->filename = strdup(filename);
+	if (!job->filename || !clone_matrix(&job->snapshot,m->name,m)) {
+		free(job->filename);
+		free(job);
+		return false;
+	}
+	memcpy(job->name,m->name,MATRIX_NAME_LEN);
+	job->format = format;
+	job->sync = sync;
+
+	pthread_mutex_lock(&io.lock);
+	if (!io.started) {
+		if (pthread_create(&io.thread,NULL,io_thread,NULL) != 0) {
+			pthread_mutex_unlock(&io.lock);
+			message_printf("failed to start the I/O thread\n");
+			destroy_matrix(&job->snapshot);
+			free(job->filename);
+			free(job);
+			return false;
+		}
+		io.started = true;
+	}
+	/* results nobody waited for are only kept while they carry an error */
+	collect_jobs(NULL,true);
+	if (io.tail) {
+		io.tail->next = job;
+	}
+	else {
+		io.head = job;
+	}
+	io.tail = job;
+	if (io.next_job == NULL) {
+		io.next_job = job;
+	}
+	pthread_cond_signal(&io.work_ready);
+	pthread_mutex_unlock(&io.lock);
+	return true;
+}
+
+/* true when no job matching name (NULL for any) is still queued or running */
+static bool jobs_done (const char* name) {
+	for (Async_Job_t* job = io.head; job != NULL; job = job->next) {
+		if (!job->done && (name == NULL || strncmp(job->name,name,MATRIX_NAME_LEN) == 0)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * PURPOSE: blocks until every background write of the matrix called name
+ *	has finished, returns at once when none is pending
+ * INPUTS:
+ *	name matrix name
+ * RETURN:
+ *  If every write of name succeeded then true
+ *  else false after printing what the failed writes reported.
+ *
+ **/
+bool async_wait_matrix (const char* name) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (name == NULL){
+		message_printf("no matrix to wait for");
+		return false;
+	}
+
+	pthread_mutex_lock(&io.lock);
+	while (!jobs_done(name)) {
+		pthread_cond_wait(&io.work_done,&io.lock);
+	}
+	const bool ok = collect_jobs(name,false);
+	pthread_mutex_unlock(&io.lock);
+	return ok;
+}
+
+/*
+ * PURPOSE: blocks until every queued background write has finished
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  If every write since the last flush or wait succeeded then true
+ *  else false after printing what the failed writes reported.
+ *
+ **/
+bool async_flush (void) {
+	pthread_mutex_lock(&io.lock);
+	while (!jobs_done(NULL)) {
+		pthread_cond_wait(&io.work_done,&io.lock);
+	}
+	const bool ok = collect_jobs(NULL,false);
+	pthread_mutex_unlock(&io.lock);
+	return ok;
+}
+
+/*
+ * PURPOSE: number of background writes queued or running
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  the count
+ *
+ **/
+size_t async_pending (void) {
+	size_t count = 0;
+	pthread_mutex_lock(&io.lock);
+	for (Async_Job_t* job = io.head; job != NULL; job = job->next) {
+		count += !job->done;
+	}
+	pthread_mutex_unlock(&io.lock);
+	return count;
+}
+
+/*
+ * PURPOSE: finishes the queued writes and stops the I/O thread, must run
+ *	before the memory pool is destroyed
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  nothing
+ *
+ **/
+void async_shutdown (void) {
+	async_flush();
+	pthread_mutex_lock(&io.lock);
+	if (!io.started) {
+		pthread_mutex_unlock(&io.lock);
+		return;
+	}
+	io.stopping = true;
+	pthread_cond_signal(&io.work_ready);
+	pthread_mutex_unlock(&io.lock);
+	pthread_join(io.thread,NULL);
+	io.started = false;
+	io.stopping = false;
+}
@@ -0,0 +1,22 @@
+#ifndef _ASYNCWRITE_H_
+#define _ASYNCWRITE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "matrix.h"
+
+/* file layout of a background write, see write_matrix_stream and friends */
+typedef enum {
+	ASYNC_WRITE_RAW,
+	ASYNC_WRITE_COMPRESSED,
+	ASYNC_WRITE_TILED
+}Async_Write_Format_t;
+
+bool async_write_matrix (const char* filename, Matrix_t* m, Async_Write_Format_t format, bool sync);
+bool async_wait_matrix (const char* name);
+bool async_flush (void);
+size_t async_pending (void);
+void async_shutdown (void);
+
+#endif
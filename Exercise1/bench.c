@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <unistd.h>
+
+#include "matrix.h"
+#include "threadpool.h"
+#include "mempool.h"
+
+#define BENCH_MAX_REPS 1000
+/* stop repeating an operation once this much time was spent on it */
+#define BENCH_TIME_BUDGET_NS 2000000000ULL
+
+static const unsigned int sizes[] = { 8, 32, 128, 512, 2048, 8192, 16384 };
+
+typedef enum {
+	OP_CREATE,
+	OP_RANDOM,
+	OP_ADD,
+	OP_SHIFT,
+	OP_SUM,
+	OP_EQUAL,
+	OP_DUPLICATE,
+	OP_WRITE,
+	OP_READ,
+	OP_COUNT
+}Bench_Op_t;
+
+static const char* op_names[OP_COUNT] = {
+	"create_matrix", "random_matrix", "add_matrices", "bitwise_shift_matrix",
+	"sum_matrix", "equal_matrices", "duplicate_matrix", "write_matrix", "read_matrix"
+};
+
+/* bytes each operation reads plus writes, in multiples of one matrix */
+static const unsigned int op_traffic[OP_COUNT] = { 1, 1, 3, 2, 1, 2, 2, 1, 1 };
+
+typedef struct {
+	Matrix_t* a;
+	Matrix_t* b;
+	Matrix_t* c;
+	const char* path;
+}Bench_State_t;
+
+/*
+ * PURPOSE: current monotonic time
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  nanoseconds since an arbitrary start
+ *
+ **/
+static uint64_t now_ns (void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int compare_u64 (const void* x, const void* y) {
+	const uint64_t a = *(const uint64_t*) x;
+	const uint64_t b = *(const uint64_t*) y;
+	return (a > b) - (a < b);
+}
+
+/*
+ * PURPOSE: untimed setup before each repetition of op, drops the cached
+ *	summaries sum_matrix and equal_matrices would otherwise answer from
+ * INPUTS:
+ *	op the operation
+ *  st matrices a, b, c of the current size
+ * RETURN:
+ *  nothing
+ *
+ **/
+static void prepare_op (Bench_Op_t op, Bench_State_t* st) {
+	switch (op) {
+		case OP_SUM:
+			touch_matrix(st->a);
+			break;
+		case OP_EQUAL:
+			touch_matrix(st->a);
+			touch_matrix(st->b);
+			break;
+		default:
+			break;
+	}
+}
+
+/*
+ * PURPOSE: runs one repetition of op on the prepared matrices
+ * INPUTS:
+ *	op the operation
+ *  st matrices a, b, c of the current size and the scratch file path
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+static bool run_op (Bench_Op_t op, Bench_State_t* st) {
+	Matrix_t* m = NULL;
+	bool ok = true;
+	switch (op) {
+		case OP_CREATE:
+			ok = create_matrix(&m,"bench_tmp",st->a->rows,st->a->cols);
+			if (ok) {
+				destroy_matrix(&m);
+			}
+			return ok;
+		case OP_RANDOM:
+			return random_matrix(st->a,0,1000,1);
+		case OP_ADD:
+			return add_matrices(st->a,st->b,st->c);
+		case OP_SHIFT:
+			return bitwise_shift_matrix(st->c,'r',1);
+		case OP_SUM: {
+			uint64_t sum = 0;
+			return sum_matrix(st->a,&sum);
+		}
+		case OP_EQUAL:
+			equal_matrices(st->a,st->b);
+			return true;
+		case OP_DUPLICATE:
+			/* the duplicate itself only shares the buffer, the first write to it
+			 * pays the copy */
+			return duplicate_matrix(st->a,st->c) && unshare_matrix(st->c);
+		case OP_WRITE:
+			return write_matrix(st->path,st->a);
+		case OP_READ:
+			ok = read_matrix(st->path,&m);
+			if (ok) {
+				destroy_matrix(&m);
+			}
+			return ok;
+		default:
+			return false;
+	}
+}
+
+/*
+ * PURPOSE: prints one result row in the selected format
+ * INPUTS:
+ *	json print a JSON object instead of a CSV line
+ *  first first row of the JSON array
+ *  op, n, reps, median, p99 measured values
+ * RETURN:
+ *  nothing
+ *
+ **/
+static void report (bool json, bool first, Bench_Op_t op, unsigned int n, unsigned int reps,
+			uint64_t median, uint64_t p99) {
+	const double bytes = (double) op_traffic[op] * n * n * sizeof(unsigned int);
+	const double gbps = median > 0 ? bytes / median : 0.0;
+	if (json) {
+		printf("%s\n  {\"op\": \"%s\", \"rows\": %u, \"cols\": %u, \"reps\": %u, "
+			"\"median_ns\": %llu, \"p99_ns\": %llu, \"gb_per_s\": %.3f}",
+			first ? "" : ",", op_names[op], n, n, reps,
+			(unsigned long long) median, (unsigned long long) p99, gbps);
+	}
+	else {
+		printf("%s,%u,%u,%u,%llu,%llu,%.3f\n", op_names[op], n, n, reps,
+			(unsigned long long) median, (unsigned long long) p99, gbps);
+	}
+	fflush(stdout);
+}
+
+/*
+ * PURPOSE: benchmark driver, times every matrix.c operation over square sizes
+ *	from 8x8 up to --max with warmup and repeated runs
+ * INPUTS:
+ *	argc the number of argument
+ *  **argv [--max N] [--reps R] [--json] [--threads N] [--file path]
+ * RETURN:
+ *  0 on success, -1 on bad arguments or a failing operation
+ *
+ **/
+int main (int argc, char **argv) {
+	unsigned int max_size = 16384;
+	unsigned int max_reps = 50;
+	unsigned int num_threads = 0;
+	bool json = false;
+	const char* path = "bench_matrix.bin";
+
+	for (int i = 1; i < argc; ++i) {
+		if (strncmp(argv[i],"--max",strlen("--max") + 1) == 0 && i + 1 < argc) {
+			max_size = atoi(argv[++i]);
+		}
+		else if (strncmp(argv[i],"--reps",strlen("--reps") + 1) == 0 && i + 1 < argc) {
+			max_reps = atoi(argv[++i]);
+		}
+		else if (strncmp(argv[i],"--threads",strlen("--threads") + 1) == 0 && i + 1 < argc) {
+			num_threads = atoi(argv[++i]);
+		}
+		else if (strncmp(argv[i],"--file",strlen("--file") + 1) == 0 && i + 1 < argc) {
+			path = argv[++i];
+		}
+		else if (strncmp(argv[i],"--json",strlen("--json") + 1) == 0) {
+			json = true;
+		}
+		else {
+			printf("usage: %s [--max N] [--reps R] [--json] [--threads N] [--file path]\n", argv[0]);
+			return -1;
+		}
+	}
+	if (max_reps == 0 || max_reps > BENCH_MAX_REPS) {
+		max_reps = BENCH_MAX_REPS;
+	}
+	threadpool_init(num_threads);
+
+	if (json) {
+		printf("[");
+	}
+	else {
+		printf("op,rows,cols,reps,median_ns,p99_ns,gb_per_s\n");
+	}
+
+	uint64_t samples[BENCH_MAX_REPS];
+	bool first = true;
+	int status = 0;
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]) && sizes[s] <= max_size; ++s) {
+		const unsigned int n = sizes[s];
+		Bench_State_t st = { .path = path };
+		if (!create_matrix(&st.a,"bench_a",n,n) || !create_matrix(&st.b,"bench_b",n,n)
+			|| !create_matrix(&st.c,"bench_c",n,n)) {
+			fprintf(stderr,"failed to allocate %ux%u matrices\n", n, n);
+			status = -1;
+			break;
+		}
+		/* same seed, so equal_matrices compares every element instead of
+		 * stopping at the first difference */
+		random_matrix(st.a,0,1000,1);
+		random_matrix(st.b,0,1000,1);
+
+		for (int op = 0; op < OP_COUNT; ++op) {
+			/* warmup, write_matrix runs before read_matrix and leaves its file behind */
+			prepare_op(op,&st);
+			if (!run_op(op,&st)) {
+				fprintf(stderr,"%s failed at %ux%u\n", op_names[op], n, n);
+				status = -1;
+				continue;
+			}
+			unsigned int reps = 0;
+			const uint64_t budget_start = now_ns();
+			while (reps < max_reps && (reps < 3 || now_ns() - budget_start < BENCH_TIME_BUDGET_NS)) {
+				prepare_op(op,&st);
+				const uint64_t t0 = now_ns();
+				run_op(op,&st);
+				samples[reps++] = now_ns() - t0;
+			}
+			qsort(samples,reps,sizeof(uint64_t),compare_u64);
+			const uint64_t median = samples[reps / 2];
+			const uint64_t p99 = samples[(reps * 99) / 100 < reps ? (reps * 99) / 100 : reps - 1];
+			report(json,first,op,n,reps,median,p99);
+			first = false;
+		}
+		destroy_matrix(&st.a);
+		destroy_matrix(&st.b);
+		destroy_matrix(&st.c);
+		mempool_trim();
+	}
+	if (json) {
+		printf("\n]\n");
+	}
+	unlink(path);
+	mempool_destroy();
+	threadpool_destroy();
+	return status;
+}
@@ -0,0 +1,962 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "matrix.h"
+#include "registry.h"
+#include "expr.h"
+#include "threadpool.h"
+#include "mempool.h"
+#include "compress.h"
+
+/*
+ * Checks of the matrix library, built and run by make check. A failed
+ * condition is printed with its line and makes the program exit with
+ * status 1; checks named on the command line run alone.
+ **/
+
+typedef void (*Check_t) (void);
+
+static unsigned int failures;
+
+#define CHECK(cond) check_condition((cond),#cond,__LINE__)
+
+/*
+ * PURPOSE: counts and prints a failed condition
+ * INPUTS:
+ *	ok result of the condition
+ *  text source text of the condition
+ *  line line of the condition in check.c
+ * RETURN:
+ *  ok
+ *
+ **/
+static bool check_condition (bool ok, const char* text, int line) {
+	if (!ok) {
+		printf("check.c:%d: %s failed\n", line, text);
+		failures++;
+	}
+	return ok;
+}
+
+/* FNV-1a as registry.c hashes names, to pick names probing from the same slot */
+static uint64_t name_hash (const char* name) {
+	uint64_t h = 14695981039346656037ULL;
+	for (; *name; ++name) {
+		h ^= (unsigned char) *name;
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+/* a 1 x 1 matrix holding value, so a lookup shows which matrix it found */
+static Matrix_t* tagged_matrix (const char* name, unsigned int value) {
+	Matrix_t* m = NULL;
+	if (!create_matrix(&m,name,1,1)) {
+		return NULL;
+	}
+	m->data[0] = value;
+	return m;
+}
+
+/* true when name is registered and holds value */
+static bool holds (const Registry_t* reg, const char* name, unsigned int value) {
+	const Matrix_t* m = registry_find(reg,name);
+	return m != NULL && strncmp(m->name,name,MATRIX_NAME_LEN) == 0 && m->data[0] == value;
+}
+
+/*
+ * PURPOSE: registry insert, replace, remove and lookup with names sharing a
+ *	probe chain, names that are prefixes of each other, lookups past
+ *	tombstones and a table that grows under live entries
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  nothing
+ *
+ **/
+static void check_registry (void) {
+	Registry_t reg;
+	if (!CHECK(registry_init(&reg,0))) {
+		return;
+	}
+	const size_t initial_capacity = reg.capacity;
+
+	/* three names hashing to the same slot of the initial table, so they sit
+	 * next to each other on one probe chain */
+	char chain[3][MATRIX_NAME_LEN];
+	size_t found = 0;
+	uint64_t slot = 0;
+	for (unsigned int i = 0; found < 3; ++i) {
+		char name[MATRIX_NAME_LEN];
+		snprintf(name,sizeof(name),"c%u",i);
+		const uint64_t h = name_hash(name) & (initial_capacity - 1);
+		if (found == 0) {
+			slot = h;
+		}
+		if (h == slot) {
+			memcpy(chain[found++],name,sizeof(name));
+		}
+	}
+	for (unsigned int i = 0; i < 3; ++i) {
+		CHECK(registry_insert(&reg,tagged_matrix(chain[i],i + 1)));
+	}
+	const char* prefixes[] = { "x", "xy", "xyz", "xyzxyzxyzxyzxyzxyzxyzxyz" };
+	for (unsigned int i = 0; i < 4; ++i) {
+		CHECK(registry_insert(&reg,tagged_matrix(prefixes[i],100 + i)));
+	}
+	CHECK(registry_count(&reg) == 7);
+	for (unsigned int i = 0; i < 3; ++i) {
+		CHECK(holds(&reg,chain[i],i + 1));
+	}
+	for (unsigned int i = 0; i < 4; ++i) {
+		CHECK(holds(&reg,prefixes[i],100 + i));
+	}
+	CHECK(registry_find(&reg,"xyzx") == NULL);
+	CHECK(registry_find(&reg,"") == NULL);
+
+	/* the last name of the chain is found past two tombstones */
+	CHECK(registry_remove(&reg,chain[0]));
+	CHECK(registry_remove(&reg,chain[1]));
+	CHECK(!registry_remove(&reg,chain[1]));
+	CHECK(registry_find(&reg,chain[0]) == NULL);
+	CHECK(registry_find(&reg,chain[1]) == NULL);
+	CHECK(holds(&reg,chain[2],3));
+	CHECK(registry_count(&reg) == 5);
+
+	/* inserting a name already behind a tombstone replaces it, not duplicates it */
+	CHECK(registry_insert(&reg,tagged_matrix(chain[2],30)));
+	CHECK(holds(&reg,chain[2],30));
+	CHECK(registry_insert(&reg,tagged_matrix(chain[1],20)));
+	CHECK(holds(&reg,chain[1],20));
+	CHECK(holds(&reg,chain[2],30));
+	CHECK(registry_remove(&reg,chain[1]));
+	CHECK(holds(&reg,chain[2],30));
+	CHECK(registry_count(&reg) == 5);
+
+	/* replacing one prefix leaves the others alone */
+	CHECK(registry_insert(&reg,tagged_matrix("xy",111)));
+	CHECK(holds(&reg,"x",100));
+	CHECK(holds(&reg,"xy",111));
+	CHECK(holds(&reg,"xyz",102));
+	CHECK(registry_count(&reg) == 5);
+
+	/* grow the table several times over the tombstones and entries above */
+	for (unsigned int i = 0; i < 200; ++i) {
+		char name[MATRIX_NAME_LEN];
+		snprintf(name,sizeof(name),"m%u",i);
+		CHECK(registry_insert(&reg,tagged_matrix(name,1000 + i)));
+	}
+	CHECK(reg.capacity > initial_capacity);
+	CHECK(registry_count(&reg) == 205);
+	CHECK(registry_find(&reg,chain[0]) == NULL);
+	CHECK(registry_find(&reg,chain[1]) == NULL);
+	CHECK(holds(&reg,chain[2],30));
+	CHECK(holds(&reg,"x",100));
+	CHECK(holds(&reg,"xy",111));
+	CHECK(holds(&reg,"xyz",102));
+	CHECK(holds(&reg,prefixes[3],103));
+
+	/* every other entry removed, replaced and looked up across the grown table */
+	for (unsigned int i = 0; i < 200; i += 2) {
+		char name[MATRIX_NAME_LEN];
+		snprintf(name,sizeof(name),"m%u",i);
+		CHECK(registry_remove(&reg,name));
+	}
+	for (unsigned int i = 1; i < 200; i += 4) {
+		char name[MATRIX_NAME_LEN];
+		snprintf(name,sizeof(name),"m%u",i);
+		CHECK(registry_insert(&reg,tagged_matrix(name,2000 + i)));
+	}
+	for (unsigned int i = 0; i < 200; ++i) {
+		char name[MATRIX_NAME_LEN];
+		snprintf(name,sizeof(name),"m%u",i);
+		if (i % 2 == 0) {
+			CHECK(registry_find(&reg,name) == NULL);
+		}
+		else {
+			CHECK(holds(&reg,name,(i % 4 == 1 ? 2000 : 1000) + i));
+		}
+	}
+	CHECK(registry_count(&reg) == 105);
+	registry_destroy(&reg);
+}
+
+/*
+ * PURPOSE: random_matrix gives the same matrix for one seed on one thread
+ *	and on pools of several sizes, for a size the chunks do not divide evenly
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  nothing
+ *
+ **/
+static void check_random (void) {
+	const unsigned int pool_sizes[] = { 1, 2, 4, 7 };
+	const unsigned int ranges[][2] = { { 0, 1000 }, { 5, 5 }, { 0, UINT_MAX }, { 1u << 31, UINT_MAX } };
+	const size_t rows = 517;
+	const size_t cols = 391;
+	Matrix_t* m = NULL;
+	if (!CHECK(create_matrix(&m,"random",rows,cols))) {
+		return;
+	}
+	unsigned int* expected = malloc(rows * cols * sizeof(unsigned int));
+	if (!CHECK(expected != NULL)) {
+		destroy_matrix(&m);
+		return;
+	}
+	for (size_t r = 0; r < sizeof(ranges) / sizeof(ranges[0]); ++r) {
+		for (size_t p = 0; p < sizeof(pool_sizes) / sizeof(pool_sizes[0]); ++p) {
+			threadpool_init(pool_sizes[p]);
+			CHECK(random_matrix(m,ranges[r][0],ranges[r][1],12345));
+			if (p == 0) {
+				memcpy(expected,m->data,rows * cols * sizeof(unsigned int));
+				bool in_range = true;
+				for (size_t i = 0; i < rows * cols; ++i) {
+					in_range = in_range && expected[i] >= ranges[r][0] && expected[i] <= ranges[r][1];
+				}
+				CHECK(in_range);
+			}
+			else {
+				CHECK(memcmp(expected,m->data,rows * cols * sizeof(unsigned int)) == 0);
+			}
+		}
+	}
+	/* and another seed gives another matrix */
+	CHECK(random_matrix(m,0,UINT_MAX,12346));
+	CHECK(memcmp(expected,m->data,rows * cols * sizeof(unsigned int)) != 0);
+	threadpool_init(0);
+	free(expected);
+	destroy_matrix(&m);
+}
+
+/* replaces path with the len bytes of buf */
+static bool write_file (const char* path, const void* buf, size_t len) {
+	FILE* f = fopen(path,"wb");
+	if (f == NULL) {
+		return false;
+	}
+	const bool ok = fwrite(buf,1,len,f) == len;
+	return fclose(f) == 0 && ok;
+}
+
+/* a matrix file in the original layout: u32 name_len, the name with its
+ * NUL, u32 rows, u32 cols, then the data */
+static size_t legacy_file (unsigned char* buf, const char* name, uint32_t rows, uint32_t cols,
+			const unsigned int* data) {
+	const uint32_t name_len = strlen(name) + 1;
+	size_t offset = 0;
+	memcpy(&buf[offset],&name_len,sizeof(uint32_t));
+	offset += sizeof(uint32_t);
+	memcpy(&buf[offset],name,name_len);
+	offset += name_len;
+	memcpy(&buf[offset],&rows,sizeof(uint32_t));
+	offset += sizeof(uint32_t);
+	memcpy(&buf[offset],&cols,sizeof(uint32_t));
+	offset += sizeof(uint32_t);
+	memcpy(&buf[offset],data,(size_t) rows * cols * sizeof(unsigned int));
+	return offset + (size_t) rows * cols * sizeof(unsigned int);
+}
+
+/* the header fields read_matrix_file_header finds in path */
+static bool file_header (const char* path, char name[MATRIX_NAME_LEN], size_t* rows, size_t* cols,
+			size_t* data_offset, uint32_t* flags) {
+	const int fd = open(path,O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	const bool ok = read_matrix_file_header(fd,name,rows,cols,data_offset,flags);
+	close(fd);
+	return ok;
+}
+
+/* true when m is a rows x cols matrix called name holding data */
+static bool matches (const Matrix_t* m, const char* name, size_t rows, size_t cols,
+			const unsigned int* data) {
+	return m != NULL && strncmp(m->name,name,MATRIX_NAME_LEN) == 0 && m->rows == rows
+		&& m->cols == cols && memcmp(m->data,data,rows * cols * sizeof(unsigned int)) == 0;
+}
+
+/*
+ * PURPOSE: version 2 matrix files written and read back, files in the
+ *	original u32 layout read with aligned and unaligned data, and truncated
+ *	files rejected by every reader
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  nothing
+ *
+ **/
+static void check_file_format (void) {
+	const char* path = "check_matrix.bin";
+	const size_t rows = 37;
+	const size_t cols = 53;
+	Matrix_t* src = NULL;
+	if (!CHECK(create_matrix(&src,"format",rows,cols))) {
+		return;
+	}
+	CHECK(random_matrix(src,0,UINT_MAX,7));
+
+	/* the header init_matrix_file_header fills in, with the name cut to fit */
+	Matrix_File_Header_t header;
+	init_matrix_file_header(&header,"abcdefghijklmnopqrstuvwxyz0123",rows,cols,MATRIX_FILE_TILED);
+	CHECK(sizeof(header) == 64);
+	CHECK(memcmp(header.magic,MATRIX_FILE_MAGIC,4) == 0);
+	CHECK(header.version == MATRIX_FILE_VERSION);
+	CHECK(header.header_len == sizeof(header));
+	CHECK(header.flags == MATRIX_FILE_TILED);
+	CHECK(header.rows == rows && header.cols == cols);
+	CHECK(strncmp(header.name,"abcdefghijklmnopqrstuvwx",sizeof(header.name)) == 0);
+
+	/* version 2 written by write_matrix */
+	char name[MATRIX_NAME_LEN];
+	size_t got_rows = 0;
+	size_t got_cols = 0;
+	size_t data_offset = 0;
+	uint32_t flags = ~0u;
+	Matrix_t* m = NULL;
+	CHECK(write_matrix(path,src));
+	CHECK(file_header(path,name,&got_rows,&got_cols,&data_offset,&flags));
+	CHECK(strncmp(name,"format",MATRIX_NAME_LEN) == 0);
+	CHECK(got_rows == rows && got_cols == cols);
+	CHECK(data_offset == sizeof(Matrix_File_Header_t) && flags == 0);
+	CHECK(read_matrix(path,&m) && matches(m,"format",rows,cols,src->data));
+	destroy_matrix(&m);
+	CHECK(read_matrix_mmap(path,&m) && matches(m,"format",rows,cols,src->data));
+	destroy_matrix(&m);
+
+	const size_t max_len = sizeof(Matrix_File_Header_t) + rows * cols * sizeof(unsigned int) + 64;
+	unsigned char* buf = malloc(max_len);
+	if (!CHECK(buf != NULL)) {
+		destroy_matrix(&src);
+		return;
+	}
+
+	/* a version 2 header with the data further back at an odd offset */
+	init_matrix_file_header(&header,"padded",rows,cols,0);
+	header.header_len = sizeof(header) + 3;
+	memset(buf,0xEE,max_len);
+	memcpy(buf,&header,sizeof(header));
+	memcpy(&buf[header.header_len],src->data,rows * cols * sizeof(unsigned int));
+	CHECK(write_file(path,buf,header.header_len + rows * cols * sizeof(unsigned int)));
+	CHECK(file_header(path,name,&got_rows,&got_cols,&data_offset,&flags));
+	CHECK(data_offset == sizeof(header) + 3);
+	CHECK(read_matrix(path,&m) && matches(m,"padded",rows,cols,src->data));
+	destroy_matrix(&m);
+	CHECK(!read_matrix_mmap(path,&m) && m == NULL);
+
+	/* the original layout, "old" puts the data on a 4 byte boundary, "odd" does not */
+	const char* legacy_names[] = { "old", "odd1" };
+	for (unsigned int i = 0; i < 2; ++i) {
+		const size_t len = legacy_file(buf,legacy_names[i],rows,cols,src->data);
+		const size_t expected_offset = sizeof(uint32_t) * 3 + strlen(legacy_names[i]) + 1;
+		CHECK(write_file(path,buf,len));
+		CHECK(file_header(path,name,&got_rows,&got_cols,&data_offset,&flags));
+		CHECK(strncmp(name,legacy_names[i],MATRIX_NAME_LEN) == 0);
+		CHECK(got_rows == rows && got_cols == cols);
+		CHECK(data_offset == expected_offset && flags == 0);
+		CHECK(read_matrix(path,&m) && matches(m,legacy_names[i],rows,cols,src->data));
+		destroy_matrix(&m);
+		if (expected_offset % sizeof(unsigned int) == 0) {
+			CHECK(read_matrix_mmap(path,&m) && matches(m,legacy_names[i],rows,cols,src->data));
+			destroy_matrix(&m);
+		}
+		else {
+			CHECK(!read_matrix_mmap(path,&m) && m == NULL);
+		}
+
+		/* one element short */
+		CHECK(write_file(path,buf,len - sizeof(unsigned int)));
+		CHECK(!read_matrix(path,&m) && m == NULL);
+		CHECK(!read_matrix_mmap(path,&m) && m == NULL);
+	}
+
+	/* legacy files too short for name_len, rows and cols, whatever name_len says */
+	for (size_t cut = 4; cut < sizeof(uint32_t) * 3; ++cut) {
+		const uint32_t name_len = cut % 2 ? 1 : 200;
+		memset(buf,'n',cut);
+		memcpy(buf,&name_len,sizeof(uint32_t));
+		CHECK(write_file(path,buf,cut));
+		CHECK(!file_header(path,name,&got_rows,&got_cols,&data_offset,&flags));
+		CHECK(!read_matrix(path,&m) && m == NULL);
+		CHECK(!read_matrix_mmap(path,&m) && m == NULL);
+		CHECK(!read_matrix_region(path,0,0,1,1,"window",&m) && m == NULL);
+	}
+
+	/* a legacy name running past the end of the file */
+	const uint32_t long_name = 1000;
+	memcpy(buf,&long_name,sizeof(uint32_t));
+	CHECK(write_file(path,buf,64));
+	CHECK(!file_header(path,name,&got_rows,&got_cols,&data_offset,&flags));
+	CHECK(!read_matrix(path,&m) && m == NULL);
+
+	/* a version 2 file cut in the data, in the header and before the magic */
+	init_matrix_file_header(&header,"cut",rows,cols,0);
+	memcpy(buf,&header,sizeof(header));
+	memcpy(&buf[sizeof(header)],src->data,rows * cols * sizeof(unsigned int));
+	const size_t cuts[] = { sizeof(header) + rows * cols * sizeof(unsigned int) - 1,
+		sizeof(header) + 1, sizeof(header), sizeof(header) - 1, 20, 3, 0 };
+	for (size_t i = 0; i < sizeof(cuts) / sizeof(cuts[0]); ++i) {
+		CHECK(write_file(path,buf,cuts[i]));
+		CHECK(!read_matrix(path,&m) && m == NULL);
+		CHECK(!read_matrix_mmap(path,&m) && m == NULL);
+		if (cuts[i] < sizeof(header)) {
+			CHECK(!file_header(path,name,&got_rows,&got_cols,&data_offset,&flags));
+		}
+	}
+
+	/* unknown versions, flags and header lengths */
+	init_matrix_file_header(&header,"bad",rows,cols,0);
+	header.version = MATRIX_FILE_VERSION + 1;
+	memcpy(buf,&header,sizeof(header));
+	CHECK(write_file(path,buf,sizeof(header) + rows * cols * sizeof(unsigned int)));
+	CHECK(!file_header(path,name,&got_rows,&got_cols,&data_offset,&flags));
+	init_matrix_file_header(&header,"bad",rows,cols,0x80);
+	memcpy(buf,&header,sizeof(header));
+	CHECK(write_file(path,buf,sizeof(header) + rows * cols * sizeof(unsigned int)));
+	CHECK(!file_header(path,name,&got_rows,&got_cols,&data_offset,&flags));
+	init_matrix_file_header(&header,"bad",rows,cols,0);
+	header.header_len = sizeof(header) - 4;
+	memcpy(buf,&header,sizeof(header));
+	CHECK(write_file(path,buf,sizeof(header) + rows * cols * sizeof(unsigned int)));
+	CHECK(!file_header(path,name,&got_rows,&got_cols,&data_offset,&flags));
+
+	unlink(path);
+	free(buf);
+	destroy_matrix(&src);
+}
+
+/*
+ * PURPOSE: encodes n elements, checks the encoding stays inside
+ *	compress_bound, decodes it back and checks that the encoding cut
+ *	short or followed by a stray byte is rejected
+ * INPUTS:
+ *	in elements to encode
+ *  n number of elements
+ *  max_len largest encoding expected for in, 0 for compress_bound
+ *  delta_mode 1 when the first miniblock must use delta mode, 0 when it
+ *	must not, -1 for either
+ * RETURN:
+ *  nothing
+ *
+ **/
+static void check_codec_round_trip (const unsigned int* in, size_t n, size_t max_len, int delta_mode) {
+	const size_t bound = compress_bound(n);
+	unsigned char* encoded = malloc(bound + 16);
+	unsigned int* decoded = malloc((n + 1) * sizeof(unsigned int));
+	if (!CHECK(encoded != NULL && decoded != NULL)) {
+		free(encoded);
+		free(decoded);
+		return;
+	}
+	memset(encoded,0xA5,bound + 16);
+	const size_t len = compress_block(in,n,encoded);
+	CHECK(len > 0 && len <= bound);
+	CHECK(max_len == 0 || len <= max_len);
+	CHECK(encoded[bound] == 0xA5);
+	if (delta_mode >= 0) {
+		/* bit 6 of the mode byte of the first miniblock */
+		CHECK(((encoded[0] & 0x40) != 0) == (delta_mode == 1));
+	}
+
+	memset(decoded,0,(n + 1) * sizeof(unsigned int));
+	CHECK(decompress_block(encoded,len,decoded,n));
+	CHECK(memcmp(decoded,in,n * sizeof(unsigned int)) == 0);
+
+	/* every shorter prefix of a small block, a few of a large one */
+	const size_t step = len > 512 ? len / 97 + 1 : 1;
+	bool truncated_rejected = true;
+	for (size_t cut = 0; cut < len; cut += step) {
+		truncated_rejected = truncated_rejected && !decompress_block(encoded,cut,decoded,n);
+	}
+	CHECK(truncated_rejected);
+	CHECK(!decompress_block(encoded,len - 1,decoded,n));
+	encoded[len] = 0;
+	CHECK(!decompress_block(encoded,len + 1,decoded,n));
+	free(encoded);
+	free(decoded);
+}
+
+/*
+ * PURPOSE: compress_block and decompress_block round trips over zero runs,
+ *	ramps taking delta mode, full 32-bit values and wrapping deltas, for
+ *	whole blocks and a last miniblock or block that is only partly filled
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  nothing
+ *
+ **/
+static void check_compress (void) {
+	const size_t sizes[] = { COMPRESS_BLOCK_ELEMENTS, COMPRESS_BLOCK_ELEMENTS - 37,
+		COMPRESS_MINIBLOCK * 3, COMPRESS_MINIBLOCK + 1, COMPRESS_MINIBLOCK - 1, 2, 1 };
+	unsigned int* in = malloc(COMPRESS_BLOCK_ELEMENTS * sizeof(unsigned int));
+	if (!CHECK(in != NULL)) {
+		return;
+	}
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+		const size_t n = sizes[s];
+		const size_t miniblocks = (n + COMPRESS_MINIBLOCK - 1) / COMPRESS_MINIBLOCK;
+
+		/* zero runs need only a mode and a base byte per miniblock */
+		memset(in,0,n * sizeof(unsigned int));
+		check_codec_round_trip(in,n,miniblocks * 2,0);
+
+		/* a constant large value, the base takes a full varint */
+		for (size_t i = 0; i < n; ++i) {
+			in[i] = UINT_MAX;
+		}
+		check_codec_round_trip(in,n,miniblocks * 6,0);
+
+		/* ramps up and down from a large base, 3 bits per zigzag delta */
+		for (size_t i = 0; i < n; ++i) {
+			in[i] = 3000000000u + 3 * (unsigned int) i;
+		}
+		check_codec_round_trip(in,n,miniblocks * 6 + (n * 3 + 7) / 8,n > 2 ? 1 : -1);
+		for (size_t i = 0; i < n; ++i) {
+			in[i] = 5000000 - 2 * (unsigned int) i;
+		}
+		check_codec_round_trip(in,n,miniblocks * 6 + (n * 3 + 7) / 8,n > 2 ? 1 : -1);
+
+		/* 0 and UINT_MAX alternating: frame of reference needs 32 bits, the
+		 * wrapping deltas of -1 and +1 zigzag to 1 and 2 */
+		for (size_t i = 0; i < n; ++i) {
+			in[i] = (i & 1) ? UINT_MAX : 0;
+		}
+		check_codec_round_trip(in,n,miniblocks * 6 + (n * 2 + 7) / 8,n > 2 ? 1 : -1);
+
+		/* full 32-bit values, stored at the full width in either mode */
+		Matrix_t m = { .rows = 1, .cols = n, .data = in };
+		random_matrix(&m,0,UINT_MAX,(uint64_t) n);
+		in[0] = 0;
+		if (n > 1) {
+			in[1] = UINT_MAX;
+		}
+		check_codec_round_trip(in,n,0,-1);
+
+		/* small noise over a large base, frame of reference wins */
+		random_matrix(&m,4000000000u,4000000015u,(uint64_t) n + 1);
+		check_codec_round_trip(in,n,miniblocks * 6 + (n * 4 + 7) / 8,n > 2 ? 0 : -1);
+	}
+
+	/* a stream claiming more elements than it holds */
+	unsigned char encoded[64];
+	unsigned int decoded[COMPRESS_MINIBLOCK + 1];
+	memset(in,0,sizeof(decoded));
+	const size_t len = compress_block(in,COMPRESS_MINIBLOCK,encoded);
+	CHECK(!decompress_block(encoded,len,decoded,COMPRESS_MINIBLOCK + 1));
+	free(in);
+}
+
+/* true when m holds the rows x cols window of src at (r0,c0) */
+static bool holds_window (const Matrix_t* m, const Matrix_t* src, size_t r0, size_t c0,
+			size_t rows, size_t cols) {
+	if (m == NULL || m->rows != rows || m->cols != cols) {
+		return false;
+	}
+	for (size_t r = 0; r < rows; ++r) {
+		if (memcmp(&m->data[r * cols],&src->data[(r0 + r) * src->cols + c0],
+			cols * sizeof(unsigned int)) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * PURPOSE: write_matrix_tiled and read_matrix_region give back the data of
+ *	the matrix for the whole of it and for windows crossing tile edges or
+ *	ending on the partial tiles at the matrix edge, from a tiled and a raw
+ *	file alike; windows past the edge are refused
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  nothing
+ *
+ **/
+static void check_tiled (void) {
+	const char* tiled_path = "check_tiled.bin";
+	const char* raw_path = "check_raw.bin";
+	/* 256 x 256 tiles, so 3 x 3 tiles with 88 rows and 18 columns in the last ones */
+	const size_t rows = 600;
+	const size_t cols = 530;
+	Matrix_t* src = NULL;
+	if (!CHECK(create_matrix(&src,"tiled",rows,cols))) {
+		return;
+	}
+	CHECK(random_matrix(src,0,UINT_MAX,99));
+	CHECK(write_matrix_tiled(tiled_path,src,false));
+	CHECK(write_matrix(raw_path,src));
+
+	Matrix_t* m = NULL;
+	CHECK(read_matrix(tiled_path,&m) && matches(m,"tiled",rows,cols,src->data));
+	destroy_matrix(&m);
+	CHECK(read_matrix_mmap(tiled_path,&m) && matches(m,"tiled",rows,cols,src->data));
+	destroy_matrix(&m);
+
+	const size_t windows[][4] = {
+		{ 0, 0, rows, cols },
+		{ 0, 0, 1, 1 },
+		{ 250, 250, 10, 10 },      /* corner shared by four tiles */
+		{ 255, 0, 2, cols },       /* one tile row into the next, full width */
+		{ 0, 255, rows, 2 },       /* one tile column into the next, full height */
+		{ 256, 256, 256, 256 },    /* exactly one inner tile */
+		{ 512, 512, 88, 18 },      /* exactly the partial corner tile */
+		{ 300, 100, 300, 430 },    /* down to the bottom right corner */
+		{ 599, 0, 1, cols },       /* the last row */
+		{ 0, 529, rows, 1 },       /* the last column */
+		{ 599, 529, 1, 1 },
+		{ 1, 1, rows - 2, cols - 2 },
+	};
+	for (size_t w = 0; w < sizeof(windows) / sizeof(windows[0]); ++w) {
+		const size_t* win = windows[w];
+		CHECK(read_matrix_region(tiled_path,win[0],win[1],win[2],win[3],"window",&m)
+			&& holds_window(m,src,win[0],win[1],win[2],win[3]));
+		destroy_matrix(&m);
+		CHECK(read_matrix_region(raw_path,win[0],win[1],win[2],win[3],"window",&m)
+			&& holds_window(m,src,win[0],win[1],win[2],win[3]));
+		destroy_matrix(&m);
+	}
+
+	/* windows at pseudo random places and sizes, clipped to end inside the matrix */
+	uint64_t state = 1;
+	bool all_match = true;
+	for (unsigned int i = 0; i < 200; ++i) {
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		const size_t r0 = (state >> 33) % rows;
+		const size_t c0 = (state >> 17) % cols;
+		size_t h = 1 + (state >> 45) % 300;
+		size_t w = 1 + (state >> 5) % 300;
+		h = h > rows - r0 ? rows - r0 : h;
+		w = w > cols - c0 ? cols - c0 : w;
+		all_match = all_match && read_matrix_region(tiled_path,r0,c0,h,w,"window",&m)
+			&& holds_window(m,src,r0,c0,h,w);
+		destroy_matrix(&m);
+	}
+	CHECK(all_match);
+
+	/* one element past the bottom or right edge */
+	CHECK(!read_matrix_region(tiled_path,rows - 10,0,11,cols,"window",&m) && m == NULL);
+	CHECK(!read_matrix_region(tiled_path,0,cols - 10,rows,11,"window",&m) && m == NULL);
+	CHECK(!read_matrix_region(tiled_path,rows + 1,0,0,1,"window",&m) && m == NULL);
+	CHECK(!read_matrix_region(raw_path,rows - 10,0,11,cols,"window",&m) && m == NULL);
+
+	/* a 4 x 4 matrix is one tile of its own size; tile sizes patched into its
+	 * table must not exceed the matrix, except the 256 x 256 tiles older
+	 * files of small matrices carry */
+	Matrix_t* small = NULL;
+	CHECK(create_matrix(&small,"small",4,4) && random_matrix(small,0,UINT_MAX,5));
+	CHECK(write_matrix_tiled(tiled_path,small,false));
+	const uint32_t tile_sizes[][3] = { { 4, 4, 1 }, { 256, 256, 1 }, { 256, 4, 1 },
+		{ 257, 4, 0 }, { 4, 257, 0 }, { 1u << 31, 1u << 31, 0 }, { 1u << 31, 4, 0 } };
+	for (size_t i = 0; i < sizeof(tile_sizes) / sizeof(tile_sizes[0]); ++i) {
+		const int fd = open(tiled_path,O_RDWR);
+		uint32_t table[2] = { 0, 0 };
+		CHECK(fd >= 0 && pread(fd,table,sizeof(table),sizeof(Matrix_File_Header_t)) == sizeof(table));
+		if (i == 0) {
+			CHECK(table[0] == 4 && table[1] == 4);
+		}
+		table[0] = tile_sizes[i][0];
+		table[1] = tile_sizes[i][1];
+		CHECK(fd >= 0 && pwrite(fd,table,sizeof(table),sizeof(Matrix_File_Header_t)) == sizeof(table));
+		if (fd >= 0) {
+			close(fd);
+		}
+		if (tile_sizes[i][2]) {
+			CHECK(read_matrix(tiled_path,&m) && matches(m,"small",4,4,small->data));
+			destroy_matrix(&m);
+			CHECK(read_matrix_region(tiled_path,1,1,3,3,"window",&m) && holds_window(m,small,1,1,3,3));
+			destroy_matrix(&m);
+		}
+		else {
+			CHECK(!read_matrix(tiled_path,&m) && m == NULL);
+			CHECK(!read_matrix_region(tiled_path,1,1,3,3,"window",&m) && m == NULL);
+		}
+	}
+	destroy_matrix(&small);
+
+	unlink(tiled_path);
+	unlink(raw_path);
+	destroy_matrix(&src);
+}
+
+typedef enum {
+	COW_SHIFT,
+	COW_ADD,
+	COW_RANDOM,
+	COW_EVAL,
+	COW_TRANSPOSE,
+	COW_OP_COUNT
+}Cow_Op_t;
+
+/*
+ * PURPOSE: writes one side of a copy-on-write pair and checks the other
+ *	side still holds the original data and the writer got the result
+ * INPUTS:
+ *	op the operation writing the matrix
+ *  write_source true to write the source, false to write the duplicate
+ * RETURN:
+ *  nothing
+ *
+ **/
+static void check_cow_write (Cow_Op_t op, bool write_source) {
+	const size_t rows = 300;
+	const size_t cols = 300;
+	const size_t n = rows * cols;
+	Registry_t reg;
+	if (!CHECK(registry_init(&reg,0))) {
+		return;
+	}
+	Matrix_t* src = NULL;
+	Matrix_t* dup = NULL;
+	unsigned int* before = malloc(n * sizeof(unsigned int));
+	if (!CHECK(before != NULL && create_matrix(&src,"src",rows,cols) && create_matrix(&dup,"dup",rows,cols))) {
+		free(before);
+		if (src) {
+			destroy_matrix(&src);
+		}
+		registry_destroy(&reg);
+		return;
+	}
+	CHECK(random_matrix(src,0,1000000,42));
+	memcpy(before,src->data,n * sizeof(unsigned int));
+	CHECK(duplicate_matrix(src,dup));
+	CHECK(src->data == dup->data && src->shared != NULL && src->shared == dup->shared);
+	CHECK(src->shared != NULL && *src->shared == 2);
+	CHECK(registry_insert(&reg,src) && registry_insert(&reg,dup));
+
+	Matrix_t* writer = write_source ? src : dup;
+	Matrix_t* other = write_source ? dup : src;
+	bool written = false;
+	switch (op) {
+	case COW_SHIFT:
+		written = bitwise_shift_matrix(writer,'l',1);
+		break;
+	case COW_ADD:
+		/* the writer reads the buffer it shared as an operand */
+		written = add_matrices(other,writer,writer);
+		break;
+	case COW_RANDOM:
+		written = random_matrix(writer,0,1000000,43);
+		break;
+	case COW_EVAL:
+		written = eval_expression(&reg,write_source ? "src = dup + src * 2" : "dup = src + dup * 2");
+		break;
+	case COW_TRANSPOSE:
+		/* the writer is the destination of its own transpose */
+		written = transpose_matrix(other,writer);
+		break;
+	default:
+		break;
+	}
+	CHECK(written);
+	CHECK(registry_find(&reg,writer->name) == writer);
+	CHECK(writer->data != other->data);
+	CHECK(writer->shared == NULL);
+	CHECK(memcmp(other->data,before,n * sizeof(unsigned int)) == 0);
+
+	bool result = true;
+	for (size_t i = 0; i < n && op != COW_RANDOM; ++i) {
+		const unsigned int expected = op == COW_SHIFT ? before[i] << 1
+			: op == COW_ADD ? before[i] * 2
+			: op == COW_TRANSPOSE ? before[(i % cols) * cols + i / cols] : before[i] * 3;
+		result = result && writer->data[i] == expected;
+	}
+	CHECK(result);
+	if (op == COW_RANDOM) {
+		CHECK(memcmp(writer->data,before,n * sizeof(unsigned int)) != 0);
+	}
+
+	/* the other side now holds the buffer alone, so writing it copies nothing */
+	unsigned int* data = other->data;
+	CHECK(bitwise_shift_matrix(other,'r',1));
+	CHECK(other->data == data && other->shared == NULL);
+	free(before);
+	registry_destroy(&reg);
+}
+
+/*
+ * PURPOSE: a matrix in shared memory is copied when it is duplicated, so its
+ *	writes still go to the segment and never reach the duplicates
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  nothing
+ *
+ **/
+static void check_cow_shm (void) {
+	const size_t n = 300 * 300;
+	char shm_name[32];
+	snprintf(shm_name,sizeof(shm_name),"matlab_check_%d",(int) getpid());
+	Matrix_t* owner = NULL;
+	Matrix_t* first = NULL;
+	Matrix_t* second = NULL;
+	Matrix_t* peer = NULL;
+	unsigned int* before = malloc(n * sizeof(unsigned int));
+	if (!CHECK(before != NULL && create_matrix(&owner,"owner",300,300)
+		&& create_matrix(&second,"second",300,300))) {
+		free(before);
+		if (owner) {
+			destroy_matrix(&owner);
+		}
+		return;
+	}
+	CHECK(random_matrix(owner,0,1000000,45));
+	memcpy(before,owner->data,n * sizeof(unsigned int));
+	if (!CHECK(share_matrix_shm(owner,shm_name))) {
+		destroy_matrix(&owner);
+		destroy_matrix(&second);
+		free(before);
+		return;
+	}
+	CHECK(clone_matrix(&first,"first",owner) && duplicate_matrix(owner,second));
+	CHECK(owner->shared == NULL && first->shared == NULL && second->shared == NULL);
+	CHECK(first->shm == NULL && second->shm == NULL);
+	CHECK(first->data != owner->data && second->data != owner->data);
+
+	/* the owner is written in place, an attached peer sees the write */
+	unsigned int* data = owner->data;
+	CHECK(bitwise_shift_matrix(owner,'l',1));
+	CHECK(owner->shm != NULL && owner->data == data);
+	if (CHECK(attach_matrix_shm(shm_name,"peer",&peer))) {
+		bool shifted = true;
+		for (size_t i = 0; i < n; ++i) {
+			shifted = shifted && peer->data[i] == before[i] << 1;
+		}
+		CHECK(shifted);
+		destroy_matrix(&peer);
+	}
+	CHECK(memcmp(first->data,before,n * sizeof(unsigned int)) == 0);
+	CHECK(memcmp(second->data,before,n * sizeof(unsigned int)) == 0);
+
+	/* writing a duplicate leaves the segment alone */
+	CHECK(bitwise_shift_matrix(second,'r',1));
+	CHECK(owner->data[0] == before[0] << 1);
+
+	destroy_matrix(&owner);
+	destroy_matrix(&first);
+	destroy_matrix(&second);
+	/* the last holder removed the segment */
+	CHECK(!attach_matrix_shm(shm_name,"peer",&peer));
+	free(before);
+}
+
+/*
+ * PURPOSE: duplicates share their data until either side is written by
+ *	shift, add, random, eval or transpose, writing one side never changes the other,
+ *	and the reference count follows every destroy down to the last holder;
+ *	shared memory matrices are copied instead
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  nothing
+ *
+ **/
+static void check_cow (void) {
+	for (int op = 0; op < COW_OP_COUNT; ++op) {
+		check_cow_write(op,true);
+		check_cow_write(op,false);
+	}
+
+	/* three holders of one buffer destroyed one by one, the source first */
+	const size_t n = 300 * 300;
+	Matrix_t* src = NULL;
+	Matrix_t* first = NULL;
+	Matrix_t* second = NULL;
+	if (!CHECK(create_matrix(&src,"src",300,300))) {
+		return;
+	}
+	CHECK(random_matrix(src,0,UINT_MAX,44));
+	unsigned int* before = malloc(n * sizeof(unsigned int));
+	if (!CHECK(before != NULL && clone_matrix(&first,"first",src) && clone_matrix(&second,"second",first))) {
+		free(before);
+		destroy_matrix(&src);
+		if (first) {
+			destroy_matrix(&first);
+		}
+		return;
+	}
+	memcpy(before,src->data,n * sizeof(unsigned int));
+	size_t* count = src->shared;
+	unsigned int* data = src->data;
+	CHECK(count != NULL && *count == 3 && first->shared == count && second->shared == count);
+	destroy_matrix(&src);
+	CHECK(*count == 2 && first->data == data && second->data == data);
+	CHECK(memcmp(first->data,before,n * sizeof(unsigned int)) == 0);
+	destroy_matrix(&first);
+	CHECK(*count == 1 && second->shared == count);
+	CHECK(memcmp(second->data,before,n * sizeof(unsigned int)) == 0);
+	/* the last holder drops the count on its first write, keeping the buffer */
+	CHECK(bitwise_shift_matrix(second,'l',2));
+	CHECK(second->data == data && second->shared == NULL);
+	destroy_matrix(&second);
+
+	/* a duplicate destroyed while its source lives frees the count with the source */
+	CHECK(create_matrix(&src,"src",300,300) && clone_matrix(&first,"first",src));
+	destroy_matrix(&first);
+	CHECK(src->shared != NULL && *src->shared == 1);
+	destroy_matrix(&src);
+	free(before);
+
+	check_cow_shm();
+}
+
+static const struct {
+	const char* name;
+	Check_t run;
+} checks[] = {
+	{ "registry", check_registry },
+	{ "random", check_random },
+	{ "format", check_file_format },
+	{ "compress", check_compress },
+	{ "tiled", check_tiled },
+	{ "cow", check_cow },
+};
+
+/*
+ * PURPOSE: runs every check, or the ones named as arguments
+ * INPUTS:
+ *	argc the number of argument
+ *  **argv argument pointer
+ * RETURN:
+ *  If every condition held then 0
+ *  else 1.
+ *
+ **/
+int main (int argc, char **argv) {
+	const size_t num_checks = sizeof(checks) / sizeof(checks[0]);
+	for (int i = 1; i < argc; ++i) {
+		bool known = false;
+		for (size_t c = 0; c < num_checks; ++c) {
+			known = known || strncmp(argv[i],checks[c].name,strlen(checks[c].name) + 1) == 0;
+		}
+		if (!known) {
+			printf("usage: %s [check]...\n", argv[0]);
+			return -1;
+		}
+	}
+	threadpool_init(0);
+
+	for (size_t c = 0; c < num_checks; ++c) {
+		bool selected = argc == 1;
+		for (int i = 1; i < argc; ++i) {
+			selected = selected || strncmp(argv[i],checks[c].name,strlen(checks[c].name) + 1) == 0;
+		}
+		if (!selected) {
+			continue;
+		}
+		const unsigned int before = failures;
+		checks[c].run();
+		printf("%-10s %s\n", checks[c].name, failures == before ? "ok" : "FAILED");
+	}
+	threadpool_destroy();
+	mempool_destroy();
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <unistd.h>
+#include<readline/readline.h>
+
+#include "netclient.h"
+#include "server.h"
+
+/*
+ * PURPOSE: runs one line on the server and prints its output
+ * INPUTS:
+ *	client connected client
+ *  line command line
+ *  ok set to whether the command succeeded
+ * RETURN:
+ *  If the server answered then true
+ *  else false.
+ *
+ **/
+static bool run_line (Net_Client_t* client, const char* line, bool* ok) {
+	if (!client_request(client,line,ok)) {
+		printf("lost the connection to the server\n");
+		return false;
+	}
+	fwrite(client->reply,1,client->reply_len,stdout);
+	fflush(stdout);
+	return true;
+}
+
+/*
+ * PURPOSE: command line client of matlab --serve; runs the command given
+ *	after the socket, else every line of stdin, with a prompt on a terminal
+ * INPUTS:
+ *	argc the number of argument
+ *  **argv argument pointer
+ * RETURN:
+ *  If every command succeeded then 0
+ *  else 1 for a failed command and -1 when the server could not be reached.
+ *
+ **/
+int main (int argc, char **argv) {
+	if (argc < 2) {
+		printf("usage: %s socket [command ...]\n", argv[0]);
+		return -1;
+	}
+	Net_Client_t client;
+	if (!client_connect(&client,argv[1])) {
+		return -1;
+	}
+
+	bool ok = true;
+	if (argc > 2) {
+		/* the remaining arguments form one command line */
+		char line[SERVER_MAX_LINE];
+		size_t len = 0;
+		for (int i = 2; i < argc; ++i) {
+			const size_t arg_len = strlen(argv[i]);
+			if (len + arg_len + 1 >= sizeof(line)) {
+				printf("command is too long\n");
+				client_close(&client);
+				return -1;
+			}
+			if (len > 0) {
+				line[len++] = ' ';
+			}
+			memcpy(&line[len],argv[i],arg_len);
+			len += arg_len;
+		}
+		line[len] = '\0';
+		const bool answered = run_line(&client,line,&ok);
+		client_close(&client);
+		return answered ? (ok ? 0 : 1) : -1;
+	}
+
+	const bool interactive = isatty(STDIN_FILENO);
+	char* line = NULL;
+	size_t line_cap = 0;
+	bool all_ok = true;
+	bool answered = true;
+	for (;;) {
+		if (interactive) {
+			free(line);
+			line = readline("> ");
+			if (line == NULL) {
+				break;
+			}
+		}
+		else {
+			const ssize_t got = getline(&line,&line_cap,stdin);
+			if (got < 0) {
+				break;
+			}
+			if (got > 0 && line[got - 1] == '\n') {
+				line[got - 1] = '\0';
+			}
+		}
+		if (strncmp(line,"exit", strlen("exit")  + 1) == 0) {
+			break;
+		}
+		answered = run_line(&client,line,&ok);
+		if (!answered) {
+			break;
+		}
+		all_ok = all_ok && ok;
+	}
+	free(line);
+	client_close(&client);
+	return answered ? (all_ok ? 0 : 1) : -1;
+}
@@ -4,77 +4,66 @@
 #include <stdbool.h>
 
 #include "command.h"
+#include "message.h"
 
-#define MAX_CMD_COUNT 50
-#define MAX_CMD_LEN 25
 
+/* 
+ * PURPOSE: tells whether c separates two tokens
+ * INPUTS: 
+ *	c : character of the input line
+ * RETURN:
+ *  true for blanks and line endings
+ *
+ **/
+static inline bool is_separator (char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
 
 /* 
- * PURPOSE: read what use input is  
+ * PURPOSE: split users' input into tokens in place, separators are overwritten
+ *	with NUL and cmd->cmds points at the start of every token, so no memory
+ *	is allocated and the line may be any length
  * INPUTS: 
- *	input : users' input;
- *  cmd: put users' input into command information
+ *	input : users' input, modified;
+ *  cmd: reusable command, filled from input
  * RETURN:
- *  If no errors occurred during instantiation then true
- *  else false for an error in the process.
+ *  If no errors occurred then true
+ *  else false when the line has more than MAX_CMD_COUNT tokens.
  *
  **/
 
-bool parse_user_input (const char* input, Commands_t** cmd) {
+bool parse_user_input (char* input, Commands_t* cmd) {
 	
 	// ERROR CHECK INCOMING PARAMETERS
 	if (input == NULL){
-		printf("no input from user");
+		message_printf("no input from user");
 		return false;
 	}
-	if (strlen(input) > MAX_CMD_LEN){
-		printf("too long input");
+	if (cmd == NULL){
+		message_printf("no command to fill");
 		return false;
 	}
-	//no limit on **cmd
-
-	char *string = strdup(input);
-	
-	*cmd = calloc (1,sizeof(Commands_t));
-	(*cmd)->cmds = calloc(MAX_CMD_COUNT,sizeof(char*));
 
-	unsigned int i = 0;
-	char *token;
-	token = strtok(string, " \n");
-	for (; token != NULL && i < MAX_CMD_COUNT; ++i) {
-		(*cmd)->cmds[i] = calloc(MAX_CMD_LEN,sizeof(char));
-		if (!(*cmd)->cmds[i]) {
-			perror("Allocation Error\n");
+	cmd->num_cmds = 0;
+	char* p = input;
+	for (;;) {
+		while (is_separator(*p)) {
+			++p;
+		}
+		if (*p == '\0') {
+			return true;
+		}
+		if (cmd->num_cmds == MAX_CMD_COUNT) {
+			message_printf("too many arguments");
 			return false;
-		}	
-		strncpy((*cmd)->cmds[i],token, strlen(token) + 1);
-		(*cmd)->num_cmds++;
-		token = strtok(NULL, " \n");
-	}
-	free(string);
-	return true;
-}
-
-/* 
- * PURPOSE: solve the problem of memory leaking for command 
- * INPUTS: 
- *	cmd: users' command;
- * RETURN:
- *  print something based on process;
- **/
-void destroy_commands(Commands_t** cmd) {
-
-	// ERROR CHECK INCOMING PARAMETERS
-	if ((*cmd) == NULL){
-		printf("no command in destroy_commands!");
-		return;
+		}
+		cmd->cmds[cmd->num_cmds++] = p;
+		while (*p != '\0' && !is_separator(*p)) {
+			++p;
+		}
+		if (*p == '\0') {
+			return true;
+		}
+		*p++ = '\0';
 	}
-	
-	for (int i = 0; i < (*cmd)->num_cmds; ++i) {
-		free((*cmd)->cmds[i]);
-	}
-	free((*cmd)->cmds);
-	free((*cmd));
-	*cmd = NULL;
 }
-
@@ -1,12 +1,14 @@
 #ifndef _COMMAND_H_
 #define _COMMAND_H_
-    
+
+#define MAX_CMD_COUNT 50
+
+/* tokens point into the parsed line, which must outlive the Commands_t use */
 typedef struct {
 	unsigned int num_cmds;
-	char** cmds;
+	char* cmds[MAX_CMD_COUNT];
 }Commands_t;
 
-bool parse_user_input (const char* input, Commands_t** cmd);
-void destroy_commands(Commands_t** cmd);
+bool parse_user_input (char* input, Commands_t* cmd);
 
 #endif
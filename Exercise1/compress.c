@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "compress.h"
+
+/*
+ * Block codec for compressed matrix files. A block is cut into miniblocks of
+ * COMPRESS_MINIBLOCK elements, each stored as
+ *	u8 mode : bits 0-5 bit width (0..32), bit 6 set for delta mode
+ *	varint base : LEB128, the minimum (frame of reference) or the first value (delta)
+ *	packed values : width bits each, LSB first, padded to a whole byte
+ * Frame of reference stores x - min for every element. Delta mode stores the
+ * zigzag encoded difference to the previous element for every element but
+ * the first. Whichever needs fewer bits is written, so zero runs, small
+ * values and smooth ramps all shrink to a few bits per element.
+ **/
+
+#define MODE_DELTA 0x40
+#define MODE_WIDTH 0x3F
+/* mode byte plus the longest u32 varint */
+#define MINIBLOCK_OVERHEAD 6
+
+static inline unsigned int bit_width (uint32_t v) {
+	return v ? 32 - __builtin_clz(v) : 0;
+}
+
+static inline uint32_t zigzag (uint32_t diff) {
+	return (diff << 1) ^ (uint32_t) ((int32_t) diff >> 31);
+}
+
+static inline uint32_t unzigzag (uint32_t v) {
+	return (v >> 1) ^ (0u - (v & 1));
+}
+
+/*
+ * PURPOSE: largest encoding compress_block can produce for n elements
+ * INPUTS:
+ *	n number of elements
+ * RETURN:
+ *  the number of bytes to reserve
+ *
+ **/
+size_t compress_bound (size_t n) {
+	const size_t miniblocks = (n + COMPRESS_MINIBLOCK - 1) / COMPRESS_MINIBLOCK;
+	return miniblocks * MINIBLOCK_OVERHEAD + n * sizeof(unsigned int);
+}
+
+/*
+ * PURPOSE: packs n values of width bits each after out
+ * INPUTS:
+ *	values values that all fit in width bits
+ *  n number of values
+ *  width bits per value, 1 to 32
+ *  out destination, (n * width + 7) / 8 bytes
+ * RETURN:
+ *  number of bytes written
+ *
+ **/
+static size_t pack_bits (const uint32_t* values, size_t n, unsigned int width, unsigned char* out) {
+	uint64_t acc = 0;
+	unsigned int bits = 0;
+	size_t pos = 0;
+	for (size_t i = 0; i < n; ++i) {
+		acc |= (uint64_t) values[i] << bits;
+		bits += width;
+		if (bits >= 32) {
+			const uint32_t word = (uint32_t) acc;
+			memcpy(&out[pos],&word,sizeof(word));
+			pos += sizeof(word);
+			acc >>= 32;
+			bits -= 32;
+		}
+	}
+	while (bits > 0) {
+		out[pos++] = (unsigned char) acc;
+		acc >>= 8;
+		bits = bits > 8 ? bits - 8 : 0;
+	}
+	return pos;
+}
+
+/*
+ * PURPOSE: unpacks n values of width bits each, the inverse of pack_bits
+ * INPUTS:
+ *	in packed bytes
+ *  len bytes available at in
+ *  n number of values
+ *  width bits per value, 1 to 32
+ *  values destination
+ * RETURN:
+ *  number of bytes consumed, 0 when in is too short
+ *
+ **/
+static size_t unpack_bits (const unsigned char* in, size_t len, size_t n, unsigned int width,
+			uint32_t* values) {
+	const size_t bytes = (n * width + 7) / 8;
+	if (bytes > len) {
+		return 0;
+	}
+	const uint64_t mask = (width == 32) ? 0xFFFFFFFFull : ((1ull << width) - 1);
+	uint64_t acc = 0;
+	unsigned int avail = 0;
+	size_t pos = 0;
+	for (size_t i = 0; i < n; ++i) {
+		if (avail < width) {
+			if (pos + sizeof(uint32_t) <= bytes) {
+				uint32_t word;
+				memcpy(&word,&in[pos],sizeof(word));
+				acc |= (uint64_t) word << avail;
+				pos += sizeof(word);
+				avail += 32;
+			}
+			else {
+				while (avail < width) {
+					acc |= (uint64_t) in[pos++] << avail;
+					avail += 8;
+				}
+			}
+		}
+		values[i] = (uint32_t) (acc & mask);
+		acc >>= width;
+		avail -= width;
+	}
+	return bytes;
+}
+
+/*
+ * PURPOSE: encodes n elements into out
+ * INPUTS:
+ *	in elements to encode
+ *  n number of elements, at most COMPRESS_BLOCK_ELEMENTS
+ *  out destination with room for compress_bound(n) bytes
+ * RETURN:
+ *  number of bytes written
+ *
+ **/
+size_t compress_block (const unsigned int* in, size_t n, unsigned char* out) {
+	uint32_t residuals[COMPRESS_MINIBLOCK];
+	size_t pos = 0;
+	for (size_t start = 0; start < n; start += COMPRESS_MINIBLOCK) {
+		const size_t count = (n - start < COMPRESS_MINIBLOCK) ? n - start : COMPRESS_MINIBLOCK;
+		const unsigned int* x = &in[start];
+
+		uint32_t min = x[0], max = x[0], deltas = 0;
+		for (size_t i = 1; i < count; ++i) {
+			min = x[i] < min ? x[i] : min;
+			max = x[i] > max ? x[i] : max;
+			deltas |= zigzag(x[i] - x[i - 1]);
+		}
+		const unsigned int for_width = bit_width(max - min);
+		const unsigned int delta_width = bit_width(deltas);
+		const bool delta = (uint64_t) delta_width * (count - 1) < (uint64_t) for_width * count;
+
+		uint32_t base;
+		unsigned int width;
+		size_t packed;
+		if (delta) {
+			base = x[0];
+			width = delta_width;
+			for (size_t i = 1; i < count; ++i) {
+				residuals[i - 1] = zigzag(x[i] - x[i - 1]);
+			}
+			packed = count - 1;
+		}
+		else {
+			base = min;
+			width = for_width;
+			for (size_t i = 0; i < count; ++i) {
+				residuals[i] = x[i] - min;
+			}
+			packed = count;
+		}
+
+		out[pos++] = (unsigned char) (width | (delta ? MODE_DELTA : 0));
+		do {
+			out[pos++] = (unsigned char) ((base & 0x7F) | (base > 0x7F ? 0x80 : 0));
+			base >>= 7;
+		} while (base);
+		if (width > 0) {
+			pos += pack_bits(residuals,packed,width,&out[pos]);
+		}
+	}
+	return pos;
+}
+
+/*
+ * PURPOSE: decodes a block written by compress_block
+ * INPUTS:
+ *	in encoded block
+ *  len length of the encoding
+ *  out destination for n elements
+ *  n number of elements the block holds
+ * RETURN:
+ *  If the block decoded to exactly n elements then true
+ *  else false for a corrupt block.
+ *
+ **/
+bool decompress_block (const unsigned char* in, size_t len, unsigned int* out, size_t n) {
+	uint32_t residuals[COMPRESS_MINIBLOCK];
+	size_t pos = 0;
+	for (size_t start = 0; start < n; start += COMPRESS_MINIBLOCK) {
+		const size_t count = (n - start < COMPRESS_MINIBLOCK) ? n - start : COMPRESS_MINIBLOCK;
+		unsigned int* x = &out[start];
+		if (pos >= len) {
+			return false;
+		}
+		const unsigned char mode = in[pos++];
+		const unsigned int width = mode & MODE_WIDTH;
+		if (width > 32) {
+			return false;
+		}
+		uint32_t base = 0;
+		for (unsigned int shift = 0; ; shift += 7) {
+			if (pos >= len || shift > 28) {
+				return false;
+			}
+			const unsigned char byte = in[pos++];
+			base |= (uint32_t) (byte & 0x7F) << shift;
+			if (!(byte & 0x80)) {
+				break;
+			}
+		}
+
+		const size_t packed = (mode & MODE_DELTA) ? count - 1 : count;
+		if (width == 0) {
+			memset(residuals,0,packed * sizeof(uint32_t));
+		}
+		else {
+			const size_t used = unpack_bits(&in[pos],len - pos,packed,width,residuals);
+			if (used == 0 && packed > 0) {
+				return false;
+			}
+			pos += used;
+		}
+
+		if (mode & MODE_DELTA) {
+			x[0] = base;
+			for (size_t i = 1; i < count; ++i) {
+				x[i] = x[i - 1] + unzigzag(residuals[i - 1]);
+			}
+		}
+		else {
+			for (size_t i = 0; i < count; ++i) {
+				x[i] = base + residuals[i];
+			}
+		}
+	}
+	return pos == len;
+}
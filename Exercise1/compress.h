@@ -0,0 +1,17 @@
+#ifndef _COMPRESS_H_
+#define _COMPRESS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* elements per independently decodable block of a compressed matrix file */
+#define COMPRESS_BLOCK_ELEMENTS 16384
+/* elements sharing one width and base inside a block */
+#define COMPRESS_MINIBLOCK 128
+
+size_t compress_bound (size_t n);
+size_t compress_block (const unsigned int* in, size_t n, unsigned char* out);
+bool decompress_block (const unsigned char* in, size_t len, unsigned int* out, size_t n);
+
+#endif
@@ -0,0 +1,493 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <limits.h>
+
+#include "expr.h"
+#include "matrix.h"
+#include "kernels.h"
+#include "threadpool.h"
+#include "message.h"
+
+/*
+ * Element-wise expressions such as "c = (a + b) << 2". The right hand side
+ * is parsed into nodes in evaluation order, children before their parent,
+ * and then evaluated in one fused pass: every worker walks its range in
+ * EXPR_TILE element tiles and runs all nodes over a tile while it is in L1,
+ * so no intermediate matrix is ever allocated or written.
+ *
+ * Grammar, with C precedence and associativity:
+ *	or := xor ('|' xor)*     xor := and ('^' and)*     and := shift ('&' shift)*
+ *	shift := sum (('<<' | '>>') sum)*     sum := product (('+' | '-') product)*
+ *	product := primary ('*' primary)*     primary := matrix | number | '(' or ')'
+ * Arithmetic wraps like unsigned int, shifts of 32 or more give 0.
+ **/
+
+/* elements of one tile, every intermediate node owns one tile of scratch */
+#define EXPR_TILE 512
+#define EXPR_VECTOR 8
+
+typedef unsigned int Expr_Vec_t __attribute__((vector_size(EXPR_VECTOR * sizeof(unsigned int))));
+
+typedef enum {
+	EXPR_MATRIX,
+	EXPR_CONST,
+	EXPR_ADD,
+	EXPR_SUB,
+	EXPR_MUL,
+	EXPR_AND,
+	EXPR_OR,
+	EXPR_XOR,
+	EXPR_SHL,
+	EXPR_SHR
+}Expr_Op_t;
+
+typedef struct {
+	Expr_Op_t op;
+	unsigned int left;
+	unsigned int right;
+	const unsigned int* data;
+	unsigned int value;
+}Expr_Node_t;
+
+typedef struct {
+	Expr_Node_t nodes[EXPR_MAX_NODES];
+	unsigned int count;
+	const char* p;
+	Registry_t* mats;
+	const Matrix_t* shape;
+	bool failed;
+}Expr_Parser_t;
+
+typedef struct {
+	const Expr_Node_t* nodes;
+	unsigned int count;
+	unsigned int* out;
+}Expr_Task_t;
+
+static unsigned int parse_or (Expr_Parser_t* ps);
+
+static void skip_blanks (Expr_Parser_t* ps) {
+	while (isspace((unsigned char) *ps->p)) {
+		ps->p++;
+	}
+}
+
+static bool is_name_char (char c) {
+	return isalnum((unsigned char) c) || c == '_' || c == '.';
+}
+
+/*
+ * PURPOSE: appends a node, folding operators whose operands are both constants
+ * INPUTS:
+ *	ps parser
+ *  node node to append
+ * RETURN:
+ *  index of the node, 0 after an error (the parser is marked failed)
+ *
+ **/
+static unsigned int add_node (Expr_Parser_t* ps, Expr_Node_t node) {
+	if (ps->failed) {
+		return 0;
+	}
+	if (node.op > EXPR_CONST && ps->nodes[node.left].op == EXPR_CONST
+		&& ps->nodes[node.right].op == EXPR_CONST && node.right == ps->count - 1
+		&& node.left == ps->count - 2) {
+		const unsigned int x = ps->nodes[node.left].value;
+		const unsigned int y = ps->nodes[node.right].value;
+		unsigned int v = 0;
+		switch (node.op) {
+			case EXPR_ADD: v = x + y; break;
+			case EXPR_SUB: v = x - y; break;
+			case EXPR_MUL: v = x * y; break;
+			case EXPR_AND: v = x & y; break;
+			case EXPR_OR: v = x | y; break;
+			case EXPR_XOR: v = x ^ y; break;
+			case EXPR_SHL: v = y >= 32 ? 0 : x << y; break;
+			case EXPR_SHR: v = y >= 32 ? 0 : x >> y; break;
+			default: break;
+		}
+		ps->count -= 2;
+		node = (Expr_Node_t) { .op = EXPR_CONST, .value = v };
+	}
+	if (ps->count == EXPR_MAX_NODES) {
+		message_printf("expression has more than %d operands and operators\n", EXPR_MAX_NODES);
+		ps->failed = true;
+		return 0;
+	}
+	ps->nodes[ps->count] = node;
+	return ps->count++;
+}
+
+static unsigned int parse_primary (Expr_Parser_t* ps) {
+	skip_blanks(ps);
+	if (*ps->p == '(') {
+		ps->p++;
+		const unsigned int inner = parse_or(ps);
+		skip_blanks(ps);
+		if (*ps->p != ')') {
+			if (!ps->failed) {
+				message_printf("missing ) in expression\n");
+			}
+			ps->failed = true;
+			return 0;
+		}
+		ps->p++;
+		return inner;
+	}
+	if (isdigit((unsigned char) *ps->p)) {
+		char* end = NULL;
+		const unsigned long long value = strtoull(ps->p,&end,0);
+		if (value > UINT_MAX || is_name_char(*end)) {
+			message_printf("bad number in expression at %s\n", ps->p);
+			ps->failed = true;
+			return 0;
+		}
+		ps->p = end;
+		return add_node(ps,(Expr_Node_t) { .op = EXPR_CONST, .value = (unsigned int) value });
+	}
+	const char* start = ps->p;
+	while (is_name_char(*ps->p)) {
+		ps->p++;
+	}
+	const size_t len = ps->p - start;
+	if (len == 0 || len >= MATRIX_NAME_LEN) {
+		message_printf("expected a matrix name or number at \"%s\"\n", start);
+		ps->failed = true;
+		return 0;
+	}
+	char name[MATRIX_NAME_LEN];
+	memcpy(name,start,len);
+	name[len] = '\0';
+	Matrix_t* m = registry_find(ps->mats,name);
+	if (m == NULL) {
+		message_printf("Matrix (%s) doesn't exist\n", name);
+		ps->failed = true;
+		return 0;
+	}
+	if (ps->shape == NULL) {
+		ps->shape = m;
+	}
+	else if (m->rows != ps->shape->rows || m->cols != ps->shape->cols) {
+		message_printf("Matrix (%s) is %zux%zu but (%s) is %zux%zu\n", m->name, m->rows, m->cols,
+			ps->shape->name, ps->shape->rows, ps->shape->cols);
+		ps->failed = true;
+		return 0;
+	}
+	return add_node(ps,(Expr_Node_t) { .op = EXPR_MATRIX, .data = m->data });
+}
+
+/*
+ * PURPOSE: matches one of the binary operators of a precedence level
+ * INPUTS:
+ *	ps parser, advanced past the operator when it matches
+ *  ops operator spellings of this level
+ *  codes node op of each spelling
+ *  count number of operators
+ *  op receives the matched node op
+ * RETURN:
+ *  true when an operator of this level follows
+ *
+ **/
+static bool match_operator (Expr_Parser_t* ps, const char* const* ops, const Expr_Op_t* codes,
+			unsigned int count, Expr_Op_t* op) {
+	skip_blanks(ps);
+	for (unsigned int i = 0; i < count; ++i) {
+		const size_t len = strlen(ops[i]);
+		if (strncmp(ps->p,ops[i],len) == 0) {
+			/* || and && are not element-wise operators */
+			if (len == 1 && ps->p[1] == ps->p[0] && (ps->p[0] == '|' || ps->p[0] == '&')) {
+				return false;
+			}
+			ps->p += len;
+			*op = codes[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+/* one left associative level: next (op next)* */
+static unsigned int parse_level (Expr_Parser_t* ps, unsigned int (*next) (Expr_Parser_t*),
+			const char* const* ops, const Expr_Op_t* codes, unsigned int count) {
+	unsigned int left = next(ps);
+	Expr_Op_t op;
+	while (!ps->failed && match_operator(ps,ops,codes,count,&op)) {
+		const unsigned int right = next(ps);
+		left = add_node(ps,(Expr_Node_t) { .op = op, .left = left, .right = right });
+	}
+	return left;
+}
+
+static unsigned int parse_product (Expr_Parser_t* ps) {
+	static const char* const ops[] = { "*" };
+	static const Expr_Op_t codes[] = { EXPR_MUL };
+	return parse_level(ps,parse_primary,ops,codes,1);
+}
+
+static unsigned int parse_sum (Expr_Parser_t* ps) {
+	static const char* const ops[] = { "+", "-" };
+	static const Expr_Op_t codes[] = { EXPR_ADD, EXPR_SUB };
+	return parse_level(ps,parse_product,ops,codes,2);
+}
+
+static unsigned int parse_shift (Expr_Parser_t* ps) {
+	static const char* const ops[] = { "<<", ">>" };
+	static const Expr_Op_t codes[] = { EXPR_SHL, EXPR_SHR };
+	return parse_level(ps,parse_sum,ops,codes,2);
+}
+
+static unsigned int parse_and (Expr_Parser_t* ps) {
+	static const char* const ops[] = { "&" };
+	static const Expr_Op_t codes[] = { EXPR_AND };
+	return parse_level(ps,parse_shift,ops,codes,1);
+}
+
+static unsigned int parse_xor (Expr_Parser_t* ps) {
+	static const char* const ops[] = { "^" };
+	static const Expr_Op_t codes[] = { EXPR_XOR };
+	return parse_level(ps,parse_and,ops,codes,1);
+}
+
+static unsigned int parse_or (Expr_Parser_t* ps) {
+	static const char* const ops[] = { "|" };
+	static const Expr_Op_t codes[] = { EXPR_OR };
+	return parse_level(ps,parse_xor,ops,codes,1);
+}
+
+/* d = x op y over n elements, EXPR_VECTOR at a time then a scalar tail */
+#define EXPR_LOOP(vector_op, scalar_op) \
+	do { \
+		size_t i = 0; \
+		for (; i + EXPR_VECTOR <= n; i += EXPR_VECTOR) { \
+			Expr_Vec_t vx, vy, vd; \
+			memcpy(&vx,&x[i],sizeof(vx)); \
+			memcpy(&vy,&y[i],sizeof(vy)); \
+			vd = (vector_op); \
+			memcpy(&d[i],&vd,sizeof(vd)); \
+		} \
+		for (; i < n; ++i) { \
+			d[i] = (scalar_op); \
+		} \
+	} while (0)
+
+/*
+ * PURPOSE: runs every node over one tile, always inlined into the per-ISA
+ *	wrappers below so the vector code is compiled once for each target
+ * INPUTS:
+ *	nodes nodes in evaluation order, the last one is the result
+ *  count number of nodes
+ *  begin index of the first element of the tile
+ *  n elements in the tile, at most EXPR_TILE
+ *  regs one scratch tile per node, constants are already filled in
+ *  out destination of the result
+ * RETURN:
+ *  nothing
+ *
+ **/
+static inline __attribute__((always_inline)) void eval_tile (const Expr_Node_t* nodes,
+			unsigned int count, size_t begin, size_t n, unsigned int (*regs)[EXPR_TILE],
+			unsigned int* out) {
+	const unsigned int* src[EXPR_MAX_NODES];
+	const Expr_Vec_t limit = { 32, 32, 32, 32, 32, 32, 32, 32 };
+	const Expr_Vec_t low_bits = limit - 1;
+	for (unsigned int k = 0; k < count; ++k) {
+		const Expr_Node_t* node = &nodes[k];
+		if (node->op == EXPR_MATRIX) {
+			src[k] = &node->data[begin];
+			continue;
+		}
+		if (node->op == EXPR_CONST) {
+			src[k] = regs[k];
+			continue;
+		}
+		const unsigned int* x = src[node->left];
+		const unsigned int* y = src[node->right];
+		unsigned int* d = regs[k];
+		switch (node->op) {
+			case EXPR_ADD: EXPR_LOOP(vx + vy, x[i] + y[i]); break;
+			case EXPR_SUB: EXPR_LOOP(vx - vy, x[i] - y[i]); break;
+			case EXPR_MUL: EXPR_LOOP(vx * vy, x[i] * y[i]); break;
+			case EXPR_AND: EXPR_LOOP(vx & vy, x[i] & y[i]); break;
+			case EXPR_OR: EXPR_LOOP(vx | vy, x[i] | y[i]); break;
+			case EXPR_XOR: EXPR_LOOP(vx ^ vy, x[i] ^ y[i]); break;
+			case EXPR_SHL:
+				EXPR_LOOP((Expr_Vec_t) (vy < limit) & (vx << (vy & low_bits)),
+					y[i] >= 32 ? 0 : x[i] << y[i]);
+				break;
+			case EXPR_SHR:
+				EXPR_LOOP((Expr_Vec_t) (vy < limit) & (vx >> (vy & low_bits)),
+					y[i] >= 32 ? 0 : x[i] >> y[i]);
+				break;
+			default:
+				break;
+		}
+		src[k] = d;
+	}
+	memcpy(out,src[count - 1],n * sizeof(unsigned int));
+}
+
+/*
+ * PURPOSE: evaluates [begin,end) tile by tile with scratch on the stack
+ * INPUTS:
+ *	t the compiled expression and destination
+ *  begin, end element range
+ * RETURN:
+ *  nothing
+ *
+ **/
+static inline __attribute__((always_inline)) void eval_range (const Expr_Task_t* t,
+			size_t begin, size_t end) {
+	unsigned int regs[EXPR_MAX_NODES][EXPR_TILE];
+	for (unsigned int k = 0; k < t->count; ++k) {
+		if (t->nodes[k].op == EXPR_CONST) {
+			for (size_t i = 0; i < EXPR_TILE; ++i) {
+				regs[k][i] = t->nodes[k].value;
+			}
+		}
+	}
+	for (size_t tile = begin; tile < end; tile += EXPR_TILE) {
+		const size_t n = (end - tile < EXPR_TILE) ? end - tile : EXPR_TILE;
+		eval_tile(t->nodes,t->count,tile,n,regs,&t->out[tile]);
+	}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static void eval_range_avx2 (const Expr_Task_t* t, size_t begin, size_t end) {
+	eval_range(t,begin,end);
+}
+#endif
+
+static void eval_range_default (const Expr_Task_t* t, size_t begin, size_t end) {
+	eval_range(t,begin,end);
+}
+
+static void eval_task (size_t begin, size_t end, void* arg) {
+	const Expr_Task_t* t = arg;
+#if defined(__x86_64__) || defined(__i386__)
+	if (kernel_isa() >= KERNEL_ISA_AVX2) {
+		eval_range_avx2(t,begin,end);
+		return;
+	}
+#endif
+	eval_range_default(t,begin,end);
+}
+
+/*
+ * PURPOSE: lists the matrix names an expression text mentions without looking
+ *	them up, so a caller can lock them before eval_expression runs
+ * INPUTS:
+ *	text part or all of "dest = expression"
+ *  names receives the names in order of appearance, the destination first
+ *  max capacity of names
+ * RETURN:
+ *  number of names stored
+ *
+ **/
+size_t expr_matrix_names (const char* text, char names[][MATRIX_NAME_LEN], size_t max) {
+	size_t count = 0;
+	const char* p = text;
+	while (p != NULL && *p != '\0' && count < max) {
+		if (!is_name_char(*p)) {
+			++p;
+			continue;
+		}
+		const char* start = p;
+		while (is_name_char(*p)) {
+			++p;
+		}
+		/* numbers such as 0x0f are not names */
+		if (isdigit((unsigned char) *start)) {
+			continue;
+		}
+		const size_t len = (size_t) (p - start) < MATRIX_NAME_LEN ? (size_t) (p - start) : MATRIX_NAME_LEN - 1;
+		memcpy(names[count],start,len);
+		names[count++][len] = '\0';
+	}
+	return count;
+}
+
+/*
+ * PURPOSE: parses "dest = expression" and evaluates it in one fused pass, dest
+ *	is overwritten in place when it already has the right shape (it may
+ *	appear in the expression) and is created otherwise
+ * INPUTS:
+ *	mats registry holding the operands, receives dest
+ *  text assignment such as "c = (a + b) << 2"
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false after printing why.
+ *
+ **/
+bool eval_expression (Registry_t* mats, const char* text) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (mats == NULL || text == NULL) {
+		message_printf("no expression to evaluate");
+		return false;
+	}
+
+	Expr_Parser_t ps = { .p = text, .mats = mats };
+	skip_blanks(&ps);
+	const char* start = ps.p;
+	while (is_name_char(*ps.p)) {
+		ps.p++;
+	}
+	const size_t len = ps.p - start;
+	skip_blanks(&ps);
+	if (len == 0 || len >= MATRIX_NAME_LEN || *ps.p != '=') {
+		message_printf("eval needs <matrix> = <expression>\n");
+		return false;
+	}
+	ps.p++;
+	char dest_name[MATRIX_NAME_LEN];
+	memcpy(dest_name,start,len);
+	dest_name[len] = '\0';
+
+	parse_or(&ps);
+	skip_blanks(&ps);
+	if (!ps.failed && *ps.p != '\0') {
+		message_printf("unexpected \"%s\" in expression\n", ps.p);
+		return false;
+	}
+	if (ps.failed) {
+		return false;
+	}
+
+	Matrix_t* dest = registry_find(mats,dest_name);
+	const Matrix_t* shape = ps.shape ? ps.shape : dest;
+	if (shape == NULL) {
+		message_printf("expression needs at least one matrix\n");
+		return false;
+	}
+	Matrix_t* created = NULL;
+	if (dest == NULL || dest->rows != shape->rows || dest->cols != shape->cols) {
+		if (!create_matrix(&created,dest_name,shape->rows,shape->cols)) {
+			message_printf("Failure to create the result Matrix (%s)\n", dest_name);
+			return false;
+		}
+		dest = created;
+	}
+	/* operands still read the buffer dest shared, which outlives this pass */
+	else if (!unshare_matrix(dest)) {
+		return false;
+	}
+
+	Expr_Task_t task = { .nodes = ps.nodes, .count = ps.count, .out = dest->data };
+	parallel_for(shape->rows * shape->cols,sizeof(unsigned int),eval_task,&task);
+	touch_matrix(dest);
+
+	/* inserted last, replacing a same named matrix of another shape only now
+	 * that the expression no longer reads it */
+	if (created != NULL && !registry_insert(mats,created)) {
+		message_printf("fail to add matrix when running eval");
+		destroy_matrix(&created);
+		return false;
+	}
+	return true;
+}
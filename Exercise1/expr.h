@@ -0,0 +1,15 @@
+#ifndef _EXPR_H_
+#define _EXPR_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "registry.h"
+
+/* operators and operands one expression may hold */
+#define EXPR_MAX_NODES 32
+
+bool eval_expression (Registry_t* mats, const char* text);
+size_t expr_matrix_names (const char* text, char names[][MATRIX_NAME_LEN], size_t max);
+
+#endif
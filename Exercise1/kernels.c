@@ -0,0 +1,1073 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNELS_X86 1
+#endif
+
+#include "kernels.h"
+
+/* register tile computed by one call of the inner kernel */
+#define MR 4
+#define NR 8
+
+/* cache blocking: KC x NC panel of B stays in L2, MC rows of A are swept over it */
+#define KC 256
+#define NC 1024
+#define MC 128
+
+typedef void (*Tile_Kernel_t) (const unsigned int** a_rows, const unsigned int* b_panel,
+			const size_t kc, unsigned int* tile);
+
+/*
+ * PURPOSE: picks the widest instruction set the running cpu supports
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  the detected Kernel_Isa_t, cached after the first call
+ *
+ **/
+Kernel_Isa_t kernel_isa (void) {
+	static int detected = -1;
+	if (detected < 0) {
+		detected = KERNEL_ISA_SCALAR;
+#if defined(KERNELS_X86) && defined(__GNUC__)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) {
+			detected = KERNEL_ISA_AVX2;
+		}
+		else if (__builtin_cpu_supports("sse4.1")) {
+			detected = KERNEL_ISA_SSE41;
+		}
+		else if (__builtin_cpu_supports("sse2")) {
+			detected = KERNEL_ISA_SSE2;
+		}
+#endif
+	}
+	return (Kernel_Isa_t) detected;
+}
+
+/*
+ * PURPOSE: human readable name of the dispatched instruction set
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  constant string such as "avx2"
+ *
+ **/
+const char* kernel_isa_name (void) {
+	switch (kernel_isa()) {
+		case KERNEL_ISA_AVX2:
+			return "avx2";
+		case KERNEL_ISA_SSE41:
+			return "sse4.1";
+		case KERNEL_ISA_SSE2:
+			return "sse2";
+		default:
+			return "scalar";
+	}
+}
+
+/*
+ * PURPOSE: MR x NR register tile of a*b in plain C
+ * INPUTS:
+ *	a_rows : MR pointers to the first A element of each row of the tile
+ *  b_panel : packed B panel, NR values per k step
+ *  kc : depth of the panel
+ *  tile : MR * NR output, overwritten
+ * RETURN:
+ *  nothing
+ *
+ **/
+static void tile_scalar (const unsigned int** a_rows, const unsigned int* b_panel,
+			const size_t kc, unsigned int* tile) {
+	unsigned int acc[MR][NR];
+	memset(acc,0,sizeof(acc));
+	for (size_t p = 0; p < kc; ++p) {
+		const unsigned int* b = &b_panel[p * NR];
+		for (int i = 0; i < MR; ++i) {
+			const unsigned int a = a_rows[i][p];
+			for (int j = 0; j < NR; ++j) {
+				acc[i][j] += a * b[j];
+			}
+		}
+	}
+	memcpy(tile,acc,sizeof(acc));
+}
+
+#ifdef KERNELS_X86
+
+/*
+ * PURPOSE: MR x NR register tile of a*b with SSE4.1 (two xmm per row)
+ * INPUTS:
+ *	same as tile_scalar
+ * RETURN:
+ *  nothing
+ *
+ **/
+__attribute__((target("sse4.1")))
+static void tile_sse41 (const unsigned int** a_rows, const unsigned int* b_panel,
+			const size_t kc, unsigned int* tile) {
+	__m128i c00 = _mm_setzero_si128(), c01 = _mm_setzero_si128();
+	__m128i c10 = _mm_setzero_si128(), c11 = _mm_setzero_si128();
+	__m128i c20 = _mm_setzero_si128(), c21 = _mm_setzero_si128();
+	__m128i c30 = _mm_setzero_si128(), c31 = _mm_setzero_si128();
+	const unsigned int* a0 = a_rows[0];
+	const unsigned int* a1 = a_rows[1];
+	const unsigned int* a2 = a_rows[2];
+	const unsigned int* a3 = a_rows[3];
+	for (size_t p = 0; p < kc; ++p) {
+		const __m128i b0 = _mm_loadu_si128((const __m128i*) &b_panel[p * NR]);
+		const __m128i b1 = _mm_loadu_si128((const __m128i*) &b_panel[p * NR + 4]);
+		__m128i a = _mm_set1_epi32((int) a0[p]);
+		c00 = _mm_add_epi32(c00,_mm_mullo_epi32(a,b0));
+		c01 = _mm_add_epi32(c01,_mm_mullo_epi32(a,b1));
+		a = _mm_set1_epi32((int) a1[p]);
+		c10 = _mm_add_epi32(c10,_mm_mullo_epi32(a,b0));
+		c11 = _mm_add_epi32(c11,_mm_mullo_epi32(a,b1));
+		a = _mm_set1_epi32((int) a2[p]);
+		c20 = _mm_add_epi32(c20,_mm_mullo_epi32(a,b0));
+		c21 = _mm_add_epi32(c21,_mm_mullo_epi32(a,b1));
+		a = _mm_set1_epi32((int) a3[p]);
+		c30 = _mm_add_epi32(c30,_mm_mullo_epi32(a,b0));
+		c31 = _mm_add_epi32(c31,_mm_mullo_epi32(a,b1));
+	}
+	_mm_storeu_si128((__m128i*) &tile[0 * NR], c00);
+	_mm_storeu_si128((__m128i*) &tile[0 * NR + 4], c01);
+	_mm_storeu_si128((__m128i*) &tile[1 * NR], c10);
+	_mm_storeu_si128((__m128i*) &tile[1 * NR + 4], c11);
+	_mm_storeu_si128((__m128i*) &tile[2 * NR], c20);
+	_mm_storeu_si128((__m128i*) &tile[2 * NR + 4], c21);
+	_mm_storeu_si128((__m128i*) &tile[3 * NR], c30);
+	_mm_storeu_si128((__m128i*) &tile[3 * NR + 4], c31);
+}
+
+/*
+ * PURPOSE: MR x NR register tile of a*b with AVX2 (one ymm per row)
+ * INPUTS:
+ *	same as tile_scalar
+ * RETURN:
+ *  nothing
+ *
+ **/
+__attribute__((target("avx2")))
+static void tile_avx2 (const unsigned int** a_rows, const unsigned int* b_panel,
+			const size_t kc, unsigned int* tile) {
+	__m256i c0 = _mm256_setzero_si256();
+	__m256i c1 = _mm256_setzero_si256();
+	__m256i c2 = _mm256_setzero_si256();
+	__m256i c3 = _mm256_setzero_si256();
+	const unsigned int* a0 = a_rows[0];
+	const unsigned int* a1 = a_rows[1];
+	const unsigned int* a2 = a_rows[2];
+	const unsigned int* a3 = a_rows[3];
+	for (size_t p = 0; p < kc; ++p) {
+		const __m256i b = _mm256_loadu_si256((const __m256i*) &b_panel[p * NR]);
+		c0 = _mm256_add_epi32(c0,_mm256_mullo_epi32(_mm256_set1_epi32((int) a0[p]),b));
+		c1 = _mm256_add_epi32(c1,_mm256_mullo_epi32(_mm256_set1_epi32((int) a1[p]),b));
+		c2 = _mm256_add_epi32(c2,_mm256_mullo_epi32(_mm256_set1_epi32((int) a2[p]),b));
+		c3 = _mm256_add_epi32(c3,_mm256_mullo_epi32(_mm256_set1_epi32((int) a3[p]),b));
+	}
+	_mm256_storeu_si256((__m256i*) &tile[0 * NR], c0);
+	_mm256_storeu_si256((__m256i*) &tile[1 * NR], c1);
+	_mm256_storeu_si256((__m256i*) &tile[2 * NR], c2);
+	_mm256_storeu_si256((__m256i*) &tile[3 * NR], c3);
+}
+
+#endif
+
+/*
+ * PURPOSE: copies a kc x nc block of row-major B into NR wide column panels,
+ *	zero padding the last panel so the inner kernel never needs a column tail
+ * INPUTS:
+ *	b : first element of the block
+ *  ldb : row stride of B
+ *  kc, nc : block dimensions
+ *  packed : destination, kc * round_up(nc,NR) elements
+ * RETURN:
+ *  nothing
+ *
+ **/
+static void pack_b_panel (const unsigned int* b, const size_t ldb, const size_t kc,
+			const size_t nc, unsigned int* packed) {
+	for (size_t jr = 0; jr < nc; jr += NR) {
+		const size_t nr = (nc - jr < NR) ? nc - jr : NR;
+		for (size_t p = 0; p < kc; ++p) {
+			const unsigned int* src = &b[p * ldb + jr];
+			size_t j = 0;
+			for (; j < nr; ++j) {
+				packed[j] = src[j];
+			}
+			for (; j < NR; ++j) {
+				packed[j] = 0;
+			}
+			packed += NR;
+		}
+	}
+}
+
+/*
+ * PURPOSE: c = a * b for row-major unsigned int matrices (wrapping arithmetic),
+ *	blocked for cache with a packed B panel and a SIMD register tile
+ * INPUTS:
+ *	a : m x k matrix data
+ *  b : k x n matrix data
+ *  c : m x n result data, must not alias a or b
+ *  m, n, k : dimensions
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false when the panel buffer could not be allocated.
+ *
+ **/
+bool kernel_multiply (const unsigned int* a, const unsigned int* b, unsigned int* c,
+			const size_t m, const size_t n, const size_t k) {
+
+	memset(c,0,m * n * sizeof(unsigned int));
+	if (m == 0 || n == 0 || k == 0) {
+		return true;
+	}
+
+	Tile_Kernel_t tile_kernel = tile_scalar;
+#ifdef KERNELS_X86
+	if (kernel_isa() >= KERNEL_ISA_AVX2) {
+		tile_kernel = tile_avx2;
+	}
+	else if (kernel_isa() >= KERNEL_ISA_SSE41) {
+		tile_kernel = tile_sse41;
+	}
+#endif
+
+	const size_t panel_cols = ((NC < n ? NC : n) + NR - 1) / NR * NR;
+	const size_t panel_depth = KC < k ? KC : k;
+	unsigned int* packed = NULL;
+	if (posix_memalign((void**) &packed,64,panel_depth * panel_cols * sizeof(unsigned int))) {
+		return false;
+	}
+
+	unsigned int tile[MR * NR];
+	const unsigned int* a_rows[MR];
+
+	for (size_t jc = 0; jc < n; jc += NC) {
+		const size_t nc = (n - jc < NC) ? n - jc : NC;
+		for (size_t pc = 0; pc < k; pc += KC) {
+			const size_t kc = (k - pc < KC) ? k - pc : KC;
+			pack_b_panel(&b[pc * n + jc],n,kc,nc,packed);
+
+			for (size_t ic = 0; ic < m; ic += MC) {
+				const size_t mc = (m - ic < MC) ? m - ic : MC;
+				for (size_t jr = 0; jr < nc; jr += NR) {
+					const size_t nr = (nc - jr < NR) ? nc - jr : NR;
+					const unsigned int* b_panel = &packed[jr * kc];
+					for (size_t ir = 0; ir < mc; ir += MR) {
+						const size_t mr = (mc - ir < MR) ? mc - ir : MR;
+						/* missing rows of a short tile reuse row 0 and are dropped below */
+						for (size_t i = 0; i < MR; ++i) {
+							a_rows[i] = &a[(ic + ir + (i < mr ? i : 0)) * k + pc];
+						}
+						tile_kernel(a_rows,b_panel,kc,tile);
+
+						for (size_t i = 0; i < mr; ++i) {
+							unsigned int* c_row = &c[(ic + ir + i) * n + jc + jr];
+							for (size_t j = 0; j < nr; ++j) {
+								c_row[j] += tile[i * NR + j];
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+	free(packed);
+	return true;
+}
+
+/*
+ * Flat element-wise kernels. The matrix data is one contiguous run of
+ * rows * cols elements, so every pass is a single loop: a vector body
+ * followed by a scalar tail.
+ **/
+
+#ifdef KERNELS_X86
+
+__attribute__((target("avx2")))
+static size_t add_avx2 (const unsigned int* a, const unsigned int* b, unsigned int* c, const size_t n) {
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		const __m256i a0 = _mm256_loadu_si256((const __m256i*) &a[i]);
+		const __m256i a1 = _mm256_loadu_si256((const __m256i*) &a[i + 8]);
+		const __m256i b0 = _mm256_loadu_si256((const __m256i*) &b[i]);
+		const __m256i b1 = _mm256_loadu_si256((const __m256i*) &b[i + 8]);
+		_mm256_storeu_si256((__m256i*) &c[i], _mm256_add_epi32(a0,b0));
+		_mm256_storeu_si256((__m256i*) &c[i + 8], _mm256_add_epi32(a1,b1));
+	}
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t add_sse2 (const unsigned int* a, const unsigned int* b, unsigned int* c, const size_t n) {
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i a0 = _mm_loadu_si128((const __m128i*) &a[i]);
+		const __m128i a1 = _mm_loadu_si128((const __m128i*) &a[i + 4]);
+		const __m128i b0 = _mm_loadu_si128((const __m128i*) &b[i]);
+		const __m128i b1 = _mm_loadu_si128((const __m128i*) &b[i + 4]);
+		_mm_storeu_si128((__m128i*) &c[i], _mm_add_epi32(a0,b0));
+		_mm_storeu_si128((__m128i*) &c[i + 4], _mm_add_epi32(a1,b1));
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t shift_avx2 (unsigned int* a, const size_t n, const char direction, const unsigned int shift) {
+	const __m128i count = _mm_cvtsi32_si128((int) shift);
+	size_t i = 0;
+	if (direction == 'l') {
+		for (; i + 8 <= n; i += 8) {
+			const __m256i v = _mm256_loadu_si256((const __m256i*) &a[i]);
+			_mm256_storeu_si256((__m256i*) &a[i], _mm256_sll_epi32(v,count));
+		}
+	}
+	else {
+		for (; i + 8 <= n; i += 8) {
+			const __m256i v = _mm256_loadu_si256((const __m256i*) &a[i]);
+			_mm256_storeu_si256((__m256i*) &a[i], _mm256_srl_epi32(v,count));
+		}
+	}
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t shift_sse2 (unsigned int* a, const size_t n, const char direction, const unsigned int shift) {
+	const __m128i count = _mm_cvtsi32_si128((int) shift);
+	size_t i = 0;
+	if (direction == 'l') {
+		for (; i + 4 <= n; i += 4) {
+			const __m128i v = _mm_loadu_si128((const __m128i*) &a[i]);
+			_mm_storeu_si128((__m128i*) &a[i], _mm_sll_epi32(v,count));
+		}
+	}
+	else {
+		for (; i + 4 <= n; i += 4) {
+			const __m128i v = _mm_loadu_si128((const __m128i*) &a[i]);
+			_mm_storeu_si128((__m128i*) &a[i], _mm_srl_epi32(v,count));
+		}
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t sum_avx2 (const unsigned int* a, const size_t n, uint64_t* sum) {
+	__m256i acc0 = _mm256_setzero_si256();
+	__m256i acc1 = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i v = _mm256_loadu_si256((const __m256i*) &a[i]);
+		acc0 = _mm256_add_epi64(acc0,_mm256_cvtepu32_epi64(_mm256_castsi256_si128(v)));
+		acc1 = _mm256_add_epi64(acc1,_mm256_cvtepu32_epi64(_mm256_extracti128_si256(v,1)));
+	}
+	uint64_t lanes[4];
+	_mm256_storeu_si256((__m256i*) lanes, _mm256_add_epi64(acc0,acc1));
+	*sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t sum_sse2 (const unsigned int* a, const size_t n, uint64_t* sum) {
+	const __m128i zero = _mm_setzero_si128();
+	__m128i acc0 = _mm_setzero_si128();
+	__m128i acc1 = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128i v = _mm_loadu_si128((const __m128i*) &a[i]);
+		acc0 = _mm_add_epi64(acc0,_mm_unpacklo_epi32(v,zero));
+		acc1 = _mm_add_epi64(acc1,_mm_unpackhi_epi32(v,zero));
+	}
+	uint64_t lanes[2];
+	_mm_storeu_si128((__m128i*) lanes, _mm_add_epi64(acc0,acc1));
+	*sum += lanes[0] + lanes[1];
+	return i;
+}
+
+#endif
+
+/*
+ * PURPOSE: element-wise c = a + b over n contiguous elements (wrapping)
+ * INPUTS:
+ *	a, b : inputs
+ *  c : output, may alias a or b
+ *  n : number of elements
+ * RETURN:
+ *  nothing
+ *
+ **/
+void kernel_add (const unsigned int* a, const unsigned int* b, unsigned int* c, const size_t n) {
+	size_t i = 0;
+#ifdef KERNELS_X86
+	if (kernel_isa() >= KERNEL_ISA_AVX2) {
+		i = add_avx2(a,b,c,n);
+	}
+	else if (kernel_isa() >= KERNEL_ISA_SSE2) {
+		i = add_sse2(a,b,c,n);
+	}
+#endif
+	for (; i < n; ++i) {
+		c[i] = a[i] + b[i];
+	}
+}
+
+/*
+ * PURPOSE: shifts n contiguous elements in place, shifts of 32 or more give 0
+ * INPUTS:
+ *	a : data to shift
+ *  n : number of elements
+ *  direction : 'l' for left, anything else for right
+ *  shift : number of bits
+ * RETURN:
+ *  nothing
+ *
+ **/
+void kernel_shift (unsigned int* a, const size_t n, const char direction, const unsigned int shift) {
+	if (shift >= 32) {
+		memset(a,0,n * sizeof(unsigned int));
+		return;
+	}
+	size_t i = 0;
+#ifdef KERNELS_X86
+	if (kernel_isa() >= KERNEL_ISA_AVX2) {
+		i = shift_avx2(a,n,direction,shift);
+	}
+	else if (kernel_isa() >= KERNEL_ISA_SSE2) {
+		i = shift_sse2(a,n,direction,shift);
+	}
+#endif
+	if (direction == 'l') {
+		for (; i < n; ++i) {
+			a[i] <<= shift;
+		}
+	}
+	else {
+		for (; i < n; ++i) {
+			a[i] >>= shift;
+		}
+	}
+}
+
+/*
+ * PURPOSE: sum of n contiguous elements accumulated in 64 bits
+ * INPUTS:
+ *	a : data to reduce
+ *  n : number of elements
+ * RETURN:
+ *  the sum, exact for fewer than 2^32 elements
+ *
+ **/
+uint64_t kernel_sum (const unsigned int* a, const size_t n) {
+	uint64_t sum = 0;
+	size_t i = 0;
+#ifdef KERNELS_X86
+	if (kernel_isa() >= KERNEL_ISA_AVX2) {
+		i = sum_avx2(a,n,&sum);
+	}
+	else if (kernel_isa() >= KERNEL_ISA_SSE2) {
+		i = sum_sse2(a,n,&sum);
+	}
+#endif
+	for (; i < n; ++i) {
+		sum += a[i];
+	}
+	return sum;
+}
+
+#ifdef KERNELS_X86
+
+__attribute__((target("avx2")))
+static size_t moments_avx2 (const unsigned int* a, const size_t n, unsigned int* min,
+			unsigned int* max, uint64_t* sum, unsigned __int128* sumsq) {
+	const __m256i low32 = _mm256_set1_epi64x(0xFFFFFFFFll);
+	__m256i lo = _mm256_set1_epi32(-1);
+	__m256i hi = _mm256_setzero_si256();
+	__m256i s = _mm256_setzero_si256();
+	/* squares are split in 32-bit halves so the 64-bit lanes can not overflow */
+	__m256i q_lo = _mm256_setzero_si256();
+	__m256i q_hi = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i v = _mm256_loadu_si256((const __m256i*) &a[i]);
+		lo = _mm256_min_epu32(lo,v);
+		hi = _mm256_max_epu32(hi,v);
+		const __m256i odd = _mm256_srli_epi64(v,32);
+		s = _mm256_add_epi64(s,_mm256_add_epi64(_mm256_and_si256(v,low32),odd));
+		const __m256i sq0 = _mm256_mul_epu32(v,v);
+		const __m256i sq1 = _mm256_mul_epu32(odd,odd);
+		q_lo = _mm256_add_epi64(q_lo,_mm256_add_epi64(_mm256_and_si256(sq0,low32),
+			_mm256_and_si256(sq1,low32)));
+		q_hi = _mm256_add_epi64(q_hi,_mm256_add_epi64(_mm256_srli_epi64(sq0,32),
+			_mm256_srli_epi64(sq1,32)));
+	}
+	unsigned int lanes_lo[8], lanes_hi[8];
+	uint64_t lanes[4], squares_lo[4], squares_hi[4];
+	_mm256_storeu_si256((__m256i*) lanes_lo, lo);
+	_mm256_storeu_si256((__m256i*) lanes_hi, hi);
+	_mm256_storeu_si256((__m256i*) lanes, s);
+	_mm256_storeu_si256((__m256i*) squares_lo, q_lo);
+	_mm256_storeu_si256((__m256i*) squares_hi, q_hi);
+	for (int j = 0; j < 8; ++j) {
+		*min = lanes_lo[j] < *min ? lanes_lo[j] : *min;
+		*max = lanes_hi[j] > *max ? lanes_hi[j] : *max;
+	}
+	for (int j = 0; j < 4; ++j) {
+		*sum += lanes[j];
+		*sumsq += ((unsigned __int128) squares_hi[j] << 32) + squares_lo[j];
+	}
+	return i;
+}
+
+#endif
+
+/*
+ * PURPOSE: min, max, sum and sum of squares of n contiguous elements in one pass
+ * INPUTS:
+ *	a : data to reduce
+ *  n : number of elements, below 2^32
+ *  min, max : receive the extremes, UINT_MAX and 0 when n is 0
+ *  sumsq : receives the exact sum of squares
+ * RETURN:
+ *  the sum
+ *
+ **/
+uint64_t kernel_moments (const unsigned int* a, const size_t n, unsigned int* min,
+			unsigned int* max, unsigned __int128* sumsq) {
+	uint64_t sum = 0;
+	unsigned int lo = UINT_MAX;
+	unsigned int hi = 0;
+	unsigned __int128 squares = 0;
+	size_t i = 0;
+#ifdef KERNELS_X86
+	if (kernel_isa() >= KERNEL_ISA_AVX2) {
+		i = moments_avx2(a,n,&lo,&hi,&sum,&squares);
+	}
+#endif
+	for (; i < n; ++i) {
+		const unsigned int x = a[i];
+		lo = x < lo ? x : lo;
+		hi = x > hi ? x : hi;
+		sum += x;
+		squares += (uint64_t) x * x;
+	}
+	*min = lo;
+	*max = hi;
+	*sumsq = squares;
+	return sum;
+}
+
+/*
+ * PURPOSE: counts n contiguous elements into bins of width elements starting
+ *	at lo; bin = (x - lo) / width is computed with a multiply by the
+ *	precomputed reciprocal, exact for 32-bit values (Lemire's fastdiv)
+ * INPUTS:
+ *	a : data to count
+ *  n : number of elements
+ *  lo, hi : counted range, values outside it go to below and above
+ *  width : elements per bin, at least 1
+ *  counts : one counter per bin, incremented
+ *  below, above : incremented for values under lo and over hi
+ * RETURN:
+ *  nothing
+ *
+ **/
+void kernel_histogram (const unsigned int* a, const size_t n, const unsigned int lo,
+			const unsigned int hi, const uint64_t width, uint64_t* counts, uint64_t* below,
+			uint64_t* above) {
+	uint64_t under = 0;
+	uint64_t over = 0;
+	if (width == 1) {
+		for (size_t i = 0; i < n; ++i) {
+			const unsigned int x = a[i];
+			if (x < lo) {
+				++under;
+			}
+			else if (x > hi) {
+				++over;
+			}
+			else {
+				++counts[x - lo];
+			}
+		}
+	}
+	else {
+		const uint64_t reciprocal = UINT64_MAX / width + 1;
+		for (size_t i = 0; i < n; ++i) {
+			const unsigned int x = a[i];
+			if (x < lo) {
+				++under;
+			}
+			else if (x > hi) {
+				++over;
+			}
+			else {
+				++counts[(uint64_t) (((unsigned __int128) reciprocal * (x - lo)) >> 64)];
+			}
+		}
+	}
+	*below += under;
+	*above += over;
+}
+
+/*
+ * PURPOSE: finalizer of MurmurHash3, spreads every input bit over the output
+ * INPUTS:
+ *	x : value to mix
+ * RETURN:
+ *  the mixed value
+ *
+ **/
+static inline uint64_t mix64 (uint64_t x) {
+	x ^= x >> 33;
+	x *= 0xFF51AFD7ED558CCDull;
+	x ^= x >> 33;
+	x *= 0xC4CEB9FE1A85EC53ull;
+	x ^= x >> 33;
+	return x;
+}
+
+/*
+ * PURPOSE: sum, minimum, maximum and content hash of n contiguous elements in
+ *	one pass. The hash adds up a mix of every (index, value) pair, so the
+ *	hashes of consecutive runs add up to the hash of the whole buffer
+ *	whatever the split
+ * INPUTS:
+ *	a : data to reduce
+ *  n : number of elements, at least 1
+ *  first : index of a[0] in the whole buffer
+ *  min, max : receive the smallest and largest element
+ *  hash : receives the hash of the run
+ * RETURN:
+ *  the sum, exact for fewer than 2^32 elements
+ *
+ **/
+uint64_t kernel_summary (const unsigned int* a, const size_t n, const uint64_t first,
+			unsigned int* min, unsigned int* max, uint64_t* hash) {
+	uint64_t sum = 0;
+	uint64_t h = 0;
+	unsigned int lo = UINT_MAX;
+	unsigned int hi = 0;
+	for (size_t i = 0; i < n; ++i) {
+		const unsigned int x = a[i];
+		sum += x;
+		lo = x < lo ? x : lo;
+		hi = x > hi ? x : hi;
+		h += mix64(((first + i) * 0x9E3779B97F4A7C15ull) ^ x);
+	}
+	*min = lo;
+	*max = hi;
+	*hash = h;
+	return sum;
+}
+
+/*
+ * Counter-based random numbers. Element i of a fill is Philox4x32-10 applied
+ * to the counter (i, round) under the 64-bit seed, so any chunk can start at
+ * its own index without walking a generator state, and the result does not
+ * depend on how the fill was split across threads or vector lanes.
+ * Ranges are reduced with Lemire's multiply-shift; the few draws that would
+ * bias the result are rejected and redrawn with the next round number.
+ **/
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+
+/*
+ * PURPOSE: one 32-bit draw of Philox4x32-10 for a counter
+ * INPUTS:
+ *	index element index, the low 64 bits of the counter
+ *  round redraw number, the third counter word
+ *  seed the key
+ * RETURN:
+ *  the first output word
+ *
+ **/
+static uint32_t philox_draw (const uint64_t index, const uint32_t round, const uint64_t seed) {
+	uint32_t c0 = (uint32_t) index, c1 = (uint32_t) (index >> 32), c2 = round, c3 = 0;
+	uint32_t k0 = (uint32_t) seed, k1 = (uint32_t) (seed >> 32);
+	for (int r = 0; r < PHILOX_ROUNDS; ++r) {
+		const uint64_t p0 = (uint64_t) PHILOX_M0 * c0;
+		const uint64_t p1 = (uint64_t) PHILOX_M1 * c2;
+		c0 = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+		c1 = (uint32_t) p1;
+		c2 = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+		c3 = (uint32_t) p0;
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+	return c0;
+}
+
+/*
+ * PURPOSE: element index of a fill reduced to lo + [0, span) without bias
+ * INPUTS:
+ *	index element index
+ *  seed the key
+ *  lo smallest value
+ *  span number of values, 0 meaning all 2^32
+ *  threshold 2^32 mod span, products below it are rejected
+ * RETURN:
+ *  the element value
+ *
+ **/
+static uint32_t random_element (const uint64_t index, const uint64_t seed, const uint32_t lo,
+			const uint32_t span, const uint32_t threshold) {
+	if (span == 0) {
+		return philox_draw(index,0,seed);
+	}
+	for (uint32_t round = 0; ; ++round) {
+		const uint64_t product = (uint64_t) philox_draw(index,round,seed) * span;
+		if ((uint32_t) product >= threshold) {
+			return lo + (uint32_t) (product >> 32);
+		}
+	}
+}
+
+#ifdef KERNELS_X86
+
+/* 8 lanes of 32x32->64 multiply by a constant, split into low and high words */
+__attribute__((target("avx2")))
+static inline void mulhilo_avx2 (const __m256i a, const __m256i m, __m256i* lo, __m256i* hi) {
+	const __m256i even = _mm256_mul_epu32(a,m);
+	const __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a,32),m);
+	*lo = _mm256_blend_epi32(even,_mm256_slli_epi64(odd,32),0xAA);
+	*hi = _mm256_blend_epi32(_mm256_srli_epi64(even,32),odd,0xAA);
+}
+
+__attribute__((target("avx2")))
+static size_t random_avx2 (unsigned int* a, const size_t n, const uint64_t first, const uint64_t seed,
+			const uint32_t lo, const uint32_t span, const uint32_t threshold) {
+	const __m256i lane = _mm256_setr_epi32(0,1,2,3,4,5,6,7);
+	const __m256i m0 = _mm256_set1_epi32((int) PHILOX_M0);
+	const __m256i m1 = _mm256_set1_epi32((int) PHILOX_M1);
+	const __m256i vspan = _mm256_set1_epi32((int) span);
+	const __m256i vlo = _mm256_set1_epi32((int) lo);
+	const __m256i vthreshold = _mm256_set1_epi32((int) threshold);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const uint64_t index = first + i;
+		if ((uint32_t) index > UINT32_MAX - 7) {
+			/* the low counter word wraps inside this group */
+			for (unsigned int j = 0; j < 8; ++j) {
+				a[i + j] = random_element(index + j,seed,lo,span,threshold);
+			}
+			continue;
+		}
+		__m256i c0 = _mm256_add_epi32(_mm256_set1_epi32((int) (uint32_t) index),lane);
+		__m256i c1 = _mm256_set1_epi32((int) (uint32_t) (index >> 32));
+		__m256i c2 = _mm256_setzero_si256();
+		__m256i c3 = _mm256_setzero_si256();
+		uint32_t k0 = (uint32_t) seed, k1 = (uint32_t) (seed >> 32);
+		for (int r = 0; r < PHILOX_ROUNDS; ++r) {
+			__m256i lo0, hi0, lo1, hi1;
+			mulhilo_avx2(c0,m0,&lo0,&hi0);
+			mulhilo_avx2(c2,m1,&lo1,&hi1);
+			c0 = _mm256_xor_si256(_mm256_xor_si256(hi1,c1),_mm256_set1_epi32((int) k0));
+			c1 = lo1;
+			c2 = _mm256_xor_si256(_mm256_xor_si256(hi0,c3),_mm256_set1_epi32((int) k1));
+			c3 = lo0;
+			k0 += PHILOX_W0;
+			k1 += PHILOX_W1;
+		}
+		if (span == 0) {
+			_mm256_storeu_si256((__m256i*) &a[i],c0);
+			continue;
+		}
+		__m256i low, high;
+		mulhilo_avx2(c0,vspan,&low,&high);
+		_mm256_storeu_si256((__m256i*) &a[i],_mm256_add_epi32(high,vlo));
+		/* lanes whose low product word is below the threshold are redrawn */
+		const __m256i kept = _mm256_cmpeq_epi32(_mm256_max_epu32(low,vthreshold),low);
+		unsigned int rejected = ~_mm256_movemask_ps(_mm256_castsi256_ps(kept)) & 0xFF;
+		while (rejected) {
+			const unsigned int j = __builtin_ctz(rejected);
+			a[i + j] = random_element(index + j,seed,lo,span,threshold);
+			rejected &= rejected - 1;
+		}
+	}
+	return i;
+}
+
+#endif
+
+/*
+ * PURPOSE: fills n contiguous elements with uniform values in [lo, hi], the
+ *	values depend only on seed and first + position
+ * INPUTS:
+ *	a : output
+ *  n : number of elements
+ *  first : index of a[0] within the whole fill
+ *  seed : generator key
+ *  lo, hi : inclusive range, lo <= hi
+ * RETURN:
+ *  nothing
+ *
+ **/
+void kernel_random (unsigned int* a, const size_t n, const uint64_t first, const uint64_t seed,
+			const unsigned int lo, const unsigned int hi) {
+	/* a span of 2^32 wraps to 0 and means every value */
+	const uint32_t span = (uint32_t) (hi - lo + 1u);
+	const uint32_t threshold = span ? (uint32_t) (0u - span) % span : 0;
+	size_t i = 0;
+#ifdef KERNELS_X86
+	if (kernel_isa() >= KERNEL_ISA_AVX2) {
+		i = random_avx2(a,n,first,seed,lo,span,threshold);
+	}
+#endif
+	for (; i < n; ++i) {
+		a[i] = random_element(first + i,seed,lo,span,threshold);
+	}
+}
+
+/*
+ * Transposes. Both are cache-oblivious: the block is halved along its longer
+ * side until it fits TRANSPOSE_BASE x TRANSPOSE_BASE, so at every level of
+ * the memory hierarchy some recursion depth works on source and destination
+ * blocks that fit in it, whatever the matrix shape. The base case moves
+ * 8 x 8 (AVX2) or 4 x 4 (SSE2) register tiles, with scalar edges.
+ **/
+
+/* largest block handled without further splitting, 32 x 32 x 4 bytes is 4 KiB */
+#define TRANSPOSE_BASE 32
+
+#ifdef KERNELS_X86
+
+__attribute__((target("avx2")))
+static void transpose8_avx2 (const unsigned int* src, const size_t ss, unsigned int* dst,
+			const size_t ds) {
+	__m256i r[8], t[8], u[8];
+	for (int i = 0; i < 8; ++i) {
+		r[i] = _mm256_loadu_si256((const __m256i*) &src[i * ss]);
+	}
+	for (int i = 0; i < 8; i += 2) {
+		t[i] = _mm256_unpacklo_epi32(r[i],r[i + 1]);
+		t[i + 1] = _mm256_unpackhi_epi32(r[i],r[i + 1]);
+	}
+	for (int i = 0; i < 8; i += 4) {
+		u[i] = _mm256_unpacklo_epi64(t[i],t[i + 2]);
+		u[i + 1] = _mm256_unpackhi_epi64(t[i],t[i + 2]);
+		u[i + 2] = _mm256_unpacklo_epi64(t[i + 1],t[i + 3]);
+		u[i + 3] = _mm256_unpackhi_epi64(t[i + 1],t[i + 3]);
+	}
+	/* u[k] holds columns k and k + 4 of rows 0-3, u[k + 4] the same of rows 4-7 */
+	for (int k = 0; k < 4; ++k) {
+		_mm256_storeu_si256((__m256i*) &dst[k * ds], _mm256_permute2x128_si256(u[k],u[k + 4],0x20));
+		_mm256_storeu_si256((__m256i*) &dst[(k + 4) * ds], _mm256_permute2x128_si256(u[k],u[k + 4],0x31));
+	}
+}
+
+/* exchanges the transposes of the 8 x 8 tiles at a and b, a == b transposes in place */
+__attribute__((target("avx2")))
+static void swap8_avx2 (unsigned int* a, unsigned int* b, const size_t stride) {
+	unsigned int ta[64], tb[64];
+	transpose8_avx2(a,stride,ta,8);
+	transpose8_avx2(b,stride,tb,8);
+	for (int i = 0; i < 8; ++i) {
+		_mm256_storeu_si256((__m256i*) &b[i * stride], _mm256_loadu_si256((const __m256i*) &ta[i * 8]));
+		_mm256_storeu_si256((__m256i*) &a[i * stride], _mm256_loadu_si256((const __m256i*) &tb[i * 8]));
+	}
+}
+
+__attribute__((target("sse2")))
+static void transpose4_sse2 (const unsigned int* src, const size_t ss, unsigned int* dst,
+			const size_t ds) {
+	const __m128i r0 = _mm_loadu_si128((const __m128i*) &src[0]);
+	const __m128i r1 = _mm_loadu_si128((const __m128i*) &src[ss]);
+	const __m128i r2 = _mm_loadu_si128((const __m128i*) &src[2 * ss]);
+	const __m128i r3 = _mm_loadu_si128((const __m128i*) &src[3 * ss]);
+	const __m128i t0 = _mm_unpacklo_epi32(r0,r1);
+	const __m128i t1 = _mm_unpacklo_epi32(r2,r3);
+	const __m128i t2 = _mm_unpackhi_epi32(r0,r1);
+	const __m128i t3 = _mm_unpackhi_epi32(r2,r3);
+	_mm_storeu_si128((__m128i*) &dst[0], _mm_unpacklo_epi64(t0,t1));
+	_mm_storeu_si128((__m128i*) &dst[ds], _mm_unpackhi_epi64(t0,t1));
+	_mm_storeu_si128((__m128i*) &dst[2 * ds], _mm_unpacklo_epi64(t2,t3));
+	_mm_storeu_si128((__m128i*) &dst[3 * ds], _mm_unpackhi_epi64(t2,t3));
+}
+
+__attribute__((target("sse2")))
+static void swap4_sse2 (unsigned int* a, unsigned int* b, const size_t stride) {
+	unsigned int ta[16], tb[16];
+	transpose4_sse2(a,stride,ta,4);
+	transpose4_sse2(b,stride,tb,4);
+	for (int i = 0; i < 4; ++i) {
+		_mm_storeu_si128((__m128i*) &b[i * stride], _mm_loadu_si128((const __m128i*) &ta[i * 4]));
+		_mm_storeu_si128((__m128i*) &a[i * stride], _mm_loadu_si128((const __m128i*) &tb[i * 4]));
+	}
+}
+
+#endif
+
+/* edge of the register tiles the base cases use on this cpu, 1 for scalar */
+static size_t transpose_tile (void) {
+#ifdef KERNELS_X86
+	if (kernel_isa() >= KERNEL_ISA_AVX2) {
+		return 8;
+	}
+	if (kernel_isa() >= KERNEL_ISA_SSE2) {
+		return 4;
+	}
+#endif
+	return 1;
+}
+
+/* transposes one t x t tile, t from transpose_tile */
+static inline void transpose_tile_at (const unsigned int* src, const size_t ss, unsigned int* dst,
+			const size_t ds, const size_t t) {
+#ifdef KERNELS_X86
+	if (t == 8) {
+		transpose8_avx2(src,ss,dst,ds);
+		return;
+	}
+	if (t == 4) {
+		transpose4_sse2(src,ss,dst,ds);
+		return;
+	}
+#endif
+	(void) t;
+	dst[0] = src[0];
+}
+
+/* exchanges the transposes of the t x t tiles at a and b, t from transpose_tile */
+static inline void swap_tile_at (unsigned int* a, unsigned int* b, const size_t stride,
+			const size_t t) {
+#ifdef KERNELS_X86
+	if (t == 8) {
+		swap8_avx2(a,b,stride);
+		return;
+	}
+	if (t == 4) {
+		swap4_sse2(a,b,stride);
+		return;
+	}
+#endif
+	(void) t;
+	(void) stride;
+	const unsigned int x = a[0];
+	a[0] = b[0];
+	b[0] = x;
+}
+
+static void transpose_base (const unsigned int* src, const size_t ss, unsigned int* dst,
+			const size_t ds, const size_t rows, const size_t cols) {
+	const size_t t = transpose_tile();
+	const size_t full_rows = rows / t * t;
+	const size_t full_cols = cols / t * t;
+	for (size_t i = 0; i < full_rows; i += t) {
+		for (size_t j = 0; j < full_cols; j += t) {
+			transpose_tile_at(&src[i * ss + j],ss,&dst[j * ds + i],ds,t);
+		}
+	}
+	/* ragged right and bottom edges */
+	for (size_t i = 0; i < rows; ++i) {
+		for (size_t j = (i < full_rows) ? full_cols : 0; j < cols; ++j) {
+			dst[j * ds + i] = src[i * ss + j];
+		}
+	}
+}
+
+/*
+ * PURPOSE: out-of-place transpose of a rows x cols block
+ * INPUTS:
+ *	src : first element of the source block
+ *  src_stride : elements between source rows
+ *  dst : first element of the cols x rows destination block, must not overlap src
+ *  dst_stride : elements between destination rows
+ *  rows, cols : size of the source block
+ * RETURN:
+ *  nothing
+ *
+ **/
+void kernel_transpose (const unsigned int* src, const size_t src_stride, unsigned int* dst,
+			const size_t dst_stride, const size_t rows, const size_t cols) {
+	if (rows <= TRANSPOSE_BASE && cols <= TRANSPOSE_BASE) {
+		transpose_base(src,src_stride,dst,dst_stride,rows,cols);
+	}
+	else if (rows >= cols) {
+		/* split on a multiple of 8 so the halves keep whole register tiles */
+		const size_t half = (rows / 2 + 7) / 8 * 8;
+		kernel_transpose(src,src_stride,dst,dst_stride,half,cols);
+		kernel_transpose(&src[half * src_stride],src_stride,&dst[half],dst_stride,rows - half,cols);
+	}
+	else {
+		const size_t half = (cols / 2 + 7) / 8 * 8;
+		kernel_transpose(src,src_stride,dst,dst_stride,rows,half);
+		kernel_transpose(&src[half],src_stride,&dst[half * dst_stride],dst_stride,rows,cols - half);
+	}
+}
+
+static void swap_base (unsigned int* a, unsigned int* b, const size_t stride, const size_t rows,
+			const size_t cols) {
+	const bool diagonal = (a == b);
+	const size_t t = transpose_tile();
+	const size_t full_rows = rows / t * t;
+	const size_t full_cols = cols / t * t;
+	for (size_t i = 0; i < full_rows; i += t) {
+		for (size_t j = diagonal ? i : 0; j < full_cols; j += t) {
+			swap_tile_at(&a[i * stride + j],&b[j * stride + i],stride,t);
+		}
+	}
+	/* ragged edges, on the diagonal only above it so no pair is swapped twice */
+	for (size_t i = 0; i < rows; ++i) {
+		size_t j = (i < full_rows) ? full_cols : 0;
+		if (diagonal && j <= i) {
+			j = i + 1;
+		}
+		for (; j < cols; ++j) {
+			const unsigned int x = a[i * stride + j];
+			a[i * stride + j] = b[j * stride + i];
+			b[j * stride + i] = x;
+		}
+	}
+}
+
+/*
+ * PURPOSE: in-place transpose exchange of two blocks of one matrix: a becomes
+ *	the transpose of b and b the transpose of a. With a == b and rows == cols
+ *	the square block at a is transposed in place
+ * INPUTS:
+ *	a : first element of a rows x cols block
+ *  b : first element of a cols x rows block, equal to a or not overlapping it
+ *  stride : elements between rows of both blocks
+ *  rows, cols : size of the block at a
+ * RETURN:
+ *  nothing
+ *
+ **/
+void kernel_transpose_swap (unsigned int* a, unsigned int* b, const size_t stride,
+			const size_t rows, const size_t cols) {
+	if (rows <= TRANSPOSE_BASE && cols <= TRANSPOSE_BASE) {
+		swap_base(a,b,stride,rows,cols);
+	}
+	else if (a == b) {
+		/* diagonal block: two smaller diagonal blocks and the pair around them */
+		const size_t half = (rows / 2 + 7) / 8 * 8;
+		kernel_transpose_swap(a,a,stride,half,half);
+		kernel_transpose_swap(&a[half * stride + half],&a[half * stride + half],stride,
+			rows - half,rows - half);
+		kernel_transpose_swap(&a[half],&a[half * stride],stride,half,rows - half);
+	}
+	else if (rows >= cols) {
+		const size_t half = (rows / 2 + 7) / 8 * 8;
+		kernel_transpose_swap(a,b,stride,half,cols);
+		kernel_transpose_swap(&a[half * stride],&b[half],stride,rows - half,cols);
+	}
+	else {
+		const size_t half = (cols / 2 + 7) / 8 * 8;
+		kernel_transpose_swap(a,b,stride,rows,half);
+		kernel_transpose_swap(&a[half],&b[half * stride],stride,rows,cols - half);
+	}
+}
@@ -0,0 +1,37 @@
+#ifndef _KERNELS_H_
+#define _KERNELS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* instruction set the kernels were dispatched to at runtime */
+typedef enum {
+	KERNEL_ISA_SCALAR,
+	KERNEL_ISA_SSE2,
+	KERNEL_ISA_SSE41,
+	KERNEL_ISA_AVX2
+}Kernel_Isa_t;
+
+Kernel_Isa_t kernel_isa (void);
+const char* kernel_isa_name (void);
+bool kernel_multiply (const unsigned int* a, const unsigned int* b, unsigned int* c,
+			const size_t m, const size_t n, const size_t k);
+void kernel_add (const unsigned int* a, const unsigned int* b, unsigned int* c, const size_t n);
+void kernel_shift (unsigned int* a, const size_t n, const char direction, const unsigned int shift);
+uint64_t kernel_sum (const unsigned int* a, const size_t n);
+uint64_t kernel_summary (const unsigned int* a, const size_t n, const uint64_t first,
+			unsigned int* min, unsigned int* max, uint64_t* hash);
+uint64_t kernel_moments (const unsigned int* a, const size_t n, unsigned int* min,
+			unsigned int* max, unsigned __int128* sumsq);
+void kernel_histogram (const unsigned int* a, const size_t n, const unsigned int lo,
+			const unsigned int hi, const uint64_t width, uint64_t* counts, uint64_t* below,
+			uint64_t* above);
+void kernel_random (unsigned int* a, const size_t n, const uint64_t first, const uint64_t seed,
+			const unsigned int lo, const unsigned int hi);
+void kernel_transpose (const unsigned int* src, const size_t src_stride, unsigned int* dst,
+			const size_t dst_stride, const size_t rows, const size_t cols);
+void kernel_transpose_swap (unsigned int* a, unsigned int* b, const size_t stride,
+			const size_t rows, const size_t cols);
+
+#endif
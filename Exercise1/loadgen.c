@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <pthread.h>
+
+#include "netclient.h"
+
+/*
+ * Load generator for matlab --serve. Every client thread opens its own
+ * connection and sends its requests back to back, cycling through the
+ * --command lines; the latency of every request is kept so the tail can be
+ * reported exactly.
+ **/
+
+#define LOADGEN_MAX_COMMANDS 64
+
+typedef struct {
+	const char* socket_path;
+	const char* const* commands;
+	size_t num_commands;
+	size_t requests;
+	size_t offset; /* command this client starts with, spreads the mix */
+	uint64_t* latencies;
+	size_t completed;
+	size_t failed;
+	bool connected;
+}Loadgen_Client_t;
+
+/*
+ * PURPOSE: current monotonic time
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  nanoseconds since an arbitrary start
+ *
+ **/
+static uint64_t now_ns (void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * PURPOSE: sends the requests of one client and times each of them
+ * INPUTS:
+ *	arg the Loadgen_Client_t of this thread
+ * RETURN:
+ *  NULL
+ *
+ **/
+static void* client_thread (void* arg) {
+	Loadgen_Client_t* lc = arg;
+	Net_Client_t client;
+	if (!client_connect(&client,lc->socket_path)) {
+		return NULL;
+	}
+	lc->connected = true;
+	for (size_t i = 0; i < lc->requests; ++i) {
+		const char* line = lc->commands[(lc->offset + i) % lc->num_commands];
+		bool ok = false;
+		const uint64_t start = now_ns();
+		if (!client_request(&client,line,&ok)) {
+			break;
+		}
+		lc->latencies[lc->completed++] = now_ns() - start;
+		lc->failed += !ok;
+	}
+	client_close(&client);
+	return NULL;
+}
+
+static int compare_u64 (const void* a, const void* b) {
+	const uint64_t x = *(const uint64_t*) a;
+	const uint64_t y = *(const uint64_t*) b;
+	return (x > y) - (x < y);
+}
+
+/* latency at quantile q of n sorted samples, in microseconds */
+static double quantile_us (const uint64_t* sorted, size_t n, double q) {
+	size_t i = (size_t) (q * (double) n);
+	if (i >= n) {
+		i = n - 1;
+	}
+	return (double) sorted[i] / 1000.0;
+}
+
+/*
+ * PURPOSE: runs --setup lines once, then --clients connections sending
+ *	--requests commands each, and reports throughput and latency quantiles
+ * INPUTS:
+ *	argc the number of argument
+ *  **argv argument pointer
+ * RETURN:
+ *  If every request got a reply then 0
+ *  else -1.
+ *
+ **/
+int main (int argc, char **argv) {
+	const char* socket_path = NULL;
+	unsigned int num_clients = 4;
+	size_t requests = 1000;
+	const char* commands[LOADGEN_MAX_COMMANDS];
+	size_t num_commands = 0;
+	const char* setup[LOADGEN_MAX_COMMANDS];
+	size_t num_setup = 0;
+	bool usage = false;
+	for (int i = 1; i < argc && !usage; ++i) {
+		if (strncmp(argv[i],"--clients",strlen("--clients") + 1) == 0 && i + 1 < argc
+			&& atoi(argv[i + 1]) > 0) {
+			num_clients = atoi(argv[++i]);
+		}
+		else if (strncmp(argv[i],"--requests",strlen("--requests") + 1) == 0 && i + 1 < argc
+			&& atoi(argv[i + 1]) > 0) {
+			requests = (size_t) atoi(argv[++i]);
+		}
+		else if (strncmp(argv[i],"--command",strlen("--command") + 1) == 0 && i + 1 < argc
+			&& num_commands < LOADGEN_MAX_COMMANDS) {
+			commands[num_commands++] = argv[++i];
+		}
+		else if (strncmp(argv[i],"--setup",strlen("--setup") + 1) == 0 && i + 1 < argc
+			&& num_setup < LOADGEN_MAX_COMMANDS) {
+			setup[num_setup++] = argv[++i];
+		}
+		else if (socket_path == NULL && argv[i][0] != '-') {
+			socket_path = argv[i];
+		}
+		else {
+			usage = true;
+		}
+	}
+	if (usage || socket_path == NULL || num_commands == 0) {
+		printf("usage: %s socket [--clients N] [--requests N] [--setup line]... --command line...\n", argv[0]);
+		return -1;
+	}
+
+	if (num_setup > 0) {
+		Net_Client_t client;
+		if (!client_connect(&client,socket_path)) {
+			return -1;
+		}
+		for (size_t i = 0; i < num_setup; ++i) {
+			bool ok = false;
+			if (!client_request(&client,setup[i],&ok)) {
+				client_close(&client);
+				return -1;
+			}
+			if (!ok) {
+				printf("setup failed: %s\n%s", setup[i], client.reply);
+				client_close(&client);
+				return -1;
+			}
+		}
+		client_close(&client);
+	}
+
+	Loadgen_Client_t* lcs = calloc(num_clients,sizeof(Loadgen_Client_t));
+	pthread_t* threads = calloc(num_clients,sizeof(pthread_t));
+	uint64_t* latencies = calloc((size_t) num_clients * requests,sizeof(uint64_t));
+	if (!lcs || !threads || !latencies) {
+		printf("out of memory\n");
+		free(lcs);
+		free(threads);
+		free(latencies);
+		return -1;
+	}
+	const uint64_t start = now_ns();
+	unsigned int started = 0;
+	for (; started < num_clients; ++started) {
+		Loadgen_Client_t* lc = &lcs[started];
+		lc->socket_path = socket_path;
+		lc->commands = commands;
+		lc->num_commands = num_commands;
+		lc->requests = requests;
+		lc->offset = started;
+		lc->latencies = &latencies[(size_t) started * requests];
+		if (pthread_create(&threads[started],NULL,client_thread,lc) != 0) {
+			printf("failed to start client %u\n", started);
+			break;
+		}
+	}
+	for (unsigned int i = 0; i < started; ++i) {
+		pthread_join(threads[i],NULL);
+	}
+	const uint64_t elapsed = now_ns() - start;
+
+	/* gather every sample at the front for one sort */
+	size_t completed = 0;
+	size_t failed = 0;
+	size_t connected = 0;
+	for (unsigned int i = 0; i < started; ++i) {
+		memmove(&latencies[completed],lcs[i].latencies,lcs[i].completed * sizeof(uint64_t));
+		completed += lcs[i].completed;
+		failed += lcs[i].failed;
+		connected += lcs[i].connected;
+	}
+	const size_t expected = (size_t) started * requests;
+	printf("clients %zu of %u, requests %zu of %zu, failed commands %zu\n",
+		connected, num_clients, completed, expected, failed);
+	if (completed > 0) {
+		qsort(latencies,completed,sizeof(uint64_t),compare_u64);
+		printf("%.0f commands/s over %.3f s\n",
+			(double) completed * 1e9 / (double) elapsed, (double) elapsed / 1e9);
+		printf("latency us: p50 %.1f p90 %.1f p99 %.1f p99.9 %.1f max %.1f\n",
+			quantile_us(latencies,completed,0.50), quantile_us(latencies,completed,0.90),
+			quantile_us(latencies,completed,0.99), quantile_us(latencies,completed,0.999),
+			(double) latencies[completed - 1] / 1000.0);
+	}
+	free(lcs);
+	free(threads);
+	free(latencies);
+	return completed == expected && started == num_clients ? 0 : -1;
+}
@@ -5,18 +5,43 @@
 #include <math.h>
 #include <stdbool.h>
 #include <time.h>
+#include <stdarg.h>
+#include <signal.h>
 
 #include<readline/readline.h>
 
 #include "command.h"
 #include "matrix.h"
+#include "textio.h"
+#include "registry.h"
+#include "kernels.h"
+#include "threadpool.h"
+#include "mempool.h"
+#include "stats.h"
+#include "stream.h"
+#include "expr.h"
+#include "asyncwrite.h"
+#include "server.h"
+#include "message.h"
 
-void run_commands (Commands_t* cmd, Matrix_t** mats, unsigned int num_mats);
-unsigned int find_matrix_given_name (Matrix_t** mats, unsigned int num_mats, 
-			const char* target);
+bool run_commands (Commands_t* cmd, Registry_t* mats);
+static bool execute_command (Commands_t* cmd, Registry_t* mats);
+static bool serve_command (char* line, FILE* out, void* arg);
+static void reply (const char* format, ...) __attribute__((format(printf,1,2)));
+static FILE* reply_out (void);
+static void stop_serving (int signum);
 
-// TODO complete the defintion of this function. 
-void destroy_remaining_heap_allocations(Matrix_t **mats, unsigned int num_mats);
+/* where the commands of this thread print, stdout unless a server client is being served */
+static __thread FILE* reply_stream = NULL;
+
+/* seed for the next random command given without one, --seed N fixes it */
+static uint64_t next_seed;
+/* block size of add_files, shift_file and sum_file, --stream-block MiB sets it */
+static size_t stream_block_bytes = STREAM_DEFAULT_BLOCK_BYTES;
+int run_script (FILE* script, const char* script_name, bool keep_going, Registry_t* mats);
+
+/* stdio buffer for script input, large enough that reads are rarely the cost */
+#define SCRIPT_BUFFER_BYTES (1 << 20)
 
 /* 
  * PURPOSE: main function for whole process 
@@ -29,322 +54,1034 @@ void destroy_remaining_heap_allocations(Matrix_t **mats, unsigned int num_mats);
  *
  **/
 int main (int argc, char **argv) {
-	srand(time(NULL));		
+	next_seed = (uint64_t) time(NULL);
 	char *line = NULL;
-	Commands_t* cmd;
+	Commands_t cmd;
 
-	Matrix_t *mats[10];
-	memset(&mats,0, sizeof(Matrix_t*) * 10); // IMPORTANT C FUNCTION TO LEARN
+	/* --threads N overrides MATLAB_THREADS, which overrides the cpu count */
+	unsigned int num_threads = 0;
+	/* -f <file> or - runs a script instead of the interactive prompt */
+	const char* script_name = NULL;
+	bool keep_going = false;
+	/* --stats-json <file> dumps the command and memory stats at exit */
+	const char* stats_json = NULL;
+	/* --serve <socket> shares the matrices with clients instead of a prompt */
+	const char* socket_path = NULL;
+	unsigned int num_workers = 0;
+	for (int i = 1; i < argc; ++i) {
+		if (strncmp(argv[i],"--threads",strlen("--threads") + 1) == 0 && i + 1 < argc
+			&& atoi(argv[i + 1]) > 0) {
+			num_threads = atoi(argv[++i]);
+		}
+		else if (strncmp(argv[i],"-f",strlen("-f") + 1) == 0 && i + 1 < argc) {
+			script_name = argv[++i];
+		}
+		else if (strncmp(argv[i],"-",strlen("-") + 1) == 0) {
+			script_name = "-";
+		}
+		else if (strncmp(argv[i],"--keep-going",strlen("--keep-going") + 1) == 0) {
+			keep_going = true;
+		}
+		else if (strncmp(argv[i],"--stats-json",strlen("--stats-json") + 1) == 0 && i + 1 < argc) {
+			stats_json = argv[++i];
+		}
+		else if (strncmp(argv[i],"--seed",strlen("--seed") + 1) == 0 && i + 1 < argc) {
+			next_seed = strtoull(argv[++i],NULL,0);
+		}
+		else if (strncmp(argv[i],"--stream-block",strlen("--stream-block") + 1) == 0 && i + 1 < argc
+			&& atoi(argv[i + 1]) > 0) {
+			stream_block_bytes = (size_t) atoi(argv[++i]) << 20;
+		}
+		else if (strncmp(argv[i],"--serve",strlen("--serve") + 1) == 0 && i + 1 < argc) {
+			socket_path = argv[++i];
+		}
+		else if (strncmp(argv[i],"--workers",strlen("--workers") + 1) == 0 && i + 1 < argc
+			&& atoi(argv[i + 1]) > 0) {
+			num_workers = atoi(argv[++i]);
+		}
+		else {
+			printf("usage: %s [--threads N] [-f script | -] [--keep-going] [--stats-json file] [--seed N] [--stream-block MiB] [--serve socket [--workers N]]\n", argv[0]);
+			return -1;
+		}
+	}
+	if (!threadpool_init(num_threads)) {
+		printf("failed to start worker threads, running single threaded\n");
+	}
+
+	Registry_t mats;
+	if (!registry_init(&mats,0)) {
+		printf("program failed to create the matrix registry\n");
+		return -1;
+	}
 
 	Matrix_t *temp = NULL;
-	create_matrix (&temp,"temp_mat", 5, 5); 
 	// ERROR CHECK
 	if (! create_matrix (&temp,"temp_mat", 5, 5)){
 		printf("program failed to create\n");
 		return -1;
 	}
-	add_matrix_to_array(mats,temp, 10); 
 	// ERROR CHECK
-	if (add_matrix_to_array(mats,temp, 10) < 0){
+	if (! registry_insert(&mats,temp)){
 		printf("fail to get matrix");
+		destroy_matrix(&temp);
 		return -1;
 	}
 	
-	int mat_idx = find_matrix_given_name(mats,10,"temp_mat");
+	temp = registry_find(&mats,"temp_mat");
 
-	if (mat_idx < 0) {
+	if (temp == NULL) {
 		perror("PROGRAM FAILED TO INIT\n");
 		return -1;
 	}
-	random_matrix(mats[mat_idx], 10, 15);
-	write_matrix("temp_mat", mats[mat_idx]); 
-	// TODO ERROR CHECK
-	if (! write_matrix("temp_mat", mats[mat_idx])){
+	random_matrix(temp, 10, 15, next_seed++);
+	/* written once in the background, a failure is printed by the next wait or flush */
+	if (! async_write_matrix("temp_mat", temp, ASYNC_WRITE_RAW, false)){
 		printf("failed to write matrix");
 		return -1;
 	}
 
+	if (socket_path != NULL) {
+		signal(SIGINT,stop_serving);
+		signal(SIGTERM,stop_serving);
+		const bool served = serve(socket_path,num_workers ? num_workers : threadpool_default_size(),
+			serve_command,&mats);
+		if (stats_json != NULL) {
+			stats_write_json(stats_json);
+		}
+		async_shutdown();
+		registry_destroy(&mats);
+		mempool_destroy();
+		threadpool_destroy();
+		return served ? 0 : -1;
+	}
+
+	if (script_name != NULL) {
+		FILE* script = stdin;
+		if (strncmp(script_name,"-",strlen("-") + 1) != 0) {
+			script = fopen(script_name,"r");
+			if (script == NULL) {
+				perror("FAILED TO OPEN SCRIPT\n");
+				async_shutdown();
+				registry_destroy(&mats);
+				mempool_destroy();
+				threadpool_destroy();
+				return -1;
+			}
+		}
+		int status = run_script(script,script_name,keep_going,&mats);
+		if (script != stdin) {
+			fclose(script);
+		}
+		if (stats_json != NULL && !stats_write_json(stats_json)) {
+			status = 1;
+		}
+		async_shutdown();
+		registry_destroy(&mats);
+		mempool_destroy();
+		threadpool_destroy();
+		return status;
+	}
+
 	line = readline("> ");
-	while (strncmp(line,"exit", strlen("exit")  + 1) != 0) {
+	while (line != NULL && strncmp(line,"exit", strlen("exit")  + 1) != 0) {
 		
 		if (!parse_user_input(line,&cmd)) {
 			printf("Failed at parsing command\n\n");
 		}
-		
-		if (cmd->num_cmds > 1) {	
-			run_commands(cmd,mats,10);
-		}
-		if (line) {
-			free(line);
+		else if (cmd.num_cmds > 0) {	
+			run_commands(&cmd,&mats);
 		}
-		destroy_commands(&cmd);
+		free(line);
 		line = readline("> ");
 	}
 	free(line);
-	destroy_remaining_heap_allocations(mats,10);
+	if (stats_json != NULL) {
+		stats_write_json(stats_json);
+	}
+	async_shutdown();
+	registry_destroy(&mats);
+	mempool_destroy();
+	threadpool_destroy();
 	return 0;	
 }
 
+/* 
+ * PURPOSE: run every command of a script without readline, stopping at the
+ *	first failure unless keep_going is set, then print a summary
+ * INPUTS: 
+ *	script open script, one command per line, # starts a comment
+ *  script_name name used in messages
+ *  keep_going continue past failed commands
+ *  mats registry of every live matrix
+ * RETURN:
+ *  0 when every command succeeded, 1 when any command failed
+ *
+ **/
+int run_script (FILE* script, const char* script_name, bool keep_going, Registry_t* mats) {
+	static char stream_buffer[SCRIPT_BUFFER_BYTES];
+	setvbuf(script,stream_buffer,_IOFBF,sizeof(stream_buffer));
+
+	char* line = NULL;
+	size_t line_cap = 0;
+	Commands_t cmd;
+	unsigned long line_number = 0;
+	unsigned long executed = 0;
+	unsigned long failed = 0;
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	while (getline(&line,&line_cap,script) >= 0) {
+		++line_number;
+		char* comment = strchr(line,'#');
+		if (comment != NULL) {
+			*comment = '\0';
+		}
+		if (!parse_user_input(line,&cmd)) {
+			printf("%s:%lu: failed at parsing command\n", script_name, line_number);
+			++failed;
+			if (!keep_going) {
+				break;
+			}
+			continue;
+		}
+		if (cmd.num_cmds == 0) {
+			continue;
+		}
+		if (strncmp(cmd.cmds[0],"exit",strlen("exit") + 1) == 0) {
+			break;
+		}
+		++executed;
+		if (!run_commands(&cmd,mats)) {
+			printf("%s:%lu: command %s failed\n", script_name, line_number, cmd.cmds[0]);
+			++failed;
+			if (!keep_going) {
+				break;
+			}
+		}
+	}
+	free(line);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	const double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("%s: %lu commands, %lu failed, %.3f s (%.0f commands/s)\n", script_name,
+		executed, failed, seconds, seconds > 0 ? executed / seconds : 0.0);
+	return failed ? 1 : 0;
+}
+
+/* 
+ * PURPOSE: stream the commands of the calling thread print to
+ * INPUTS: 
+ *	none
+ * RETURN:
+ *  the reply stream of the client being served, else stdout
+ *
+ **/
+static FILE* reply_out (void) {
+	return reply_stream ? reply_stream : stdout;
+}
+
+/* 
+ * PURPOSE: printf for command output, see reply_out
+ * INPUTS: 
+ *	format printf format and its arguments
+ * RETURN:
+ *  nothing
+ *
+ **/
+static void reply (const char* format, ...) {
+	va_list args;
+	va_start(args,format);
+	vfprintf(reply_out(),format,args);
+	va_end(args);
+}
+
+/* SIGINT and SIGTERM while serving */
+static void stop_serving (int signum) {
+	(void) signum;
+	server_stop();
+}
+
+/* 
+ * PURPOSE: lists the matrix names a command reads and writes, so a server
+ *	worker can lock them before running it
+ * INPUTS: 
+ *	cmd the parsed command
+ *  names receives the names
+ *  exclusive receives per name whether it is written, created or removed
+ *  storage room for names that are not plain tokens, such as eval operands
+ * RETURN:
+ *  number of names, or -1 when the command may touch any matrix
+ *
+ **/
+static int command_names (Commands_t* cmd, const char** names, bool* exclusive,
+			char storage[][MATRIX_NAME_LEN]) {
+	const char* op = cmd->cmds[0];
+	const unsigned int n = cmd->num_cmds;
+	int count = 0;
+#define READS(i) do { names[count] = cmd->cmds[i]; exclusive[count++] = false; } while (0)
+#define WRITES(i) do { names[count] = cmd->cmds[i]; exclusive[count++] = true; } while (0)
+	if ((strncmp(op,"display",strlen("display") + 1) == 0 || strncmp(op,"sum",strlen("sum") + 1) == 0
+		|| strncmp(op,"stats",strlen("stats") + 1) == 0 || strncmp(op,"export_csv",strlen("export_csv") + 1) == 0) && n >= 2) {
+		READS(1);
+	}
+	else if ((strncmp(op,"rowsum",strlen("rowsum") + 1) == 0 || strncmp(op,"colsum",strlen("colsum") + 1) == 0) && n == 3) {
+		READS(1);
+		WRITES(2);
+	}
+	else if ((strncmp(op,"add",strlen("add") + 1) == 0 || strncmp(op,"multiply",strlen("multiply") + 1) == 0) && n == 4) {
+		READS(1);
+		READS(2);
+		WRITES(3);
+	}
+	else if (strncmp(op,"equal",strlen("equal") + 1) == 0 && n == 3) {
+		READS(1);
+		READS(2);
+	}
+	/* a duplicate shares the buffer of its source, which changes the source header */
+	else if (strncmp(op,"duplicate",strlen("duplicate") + 1) == 0 && n == 3) {
+		WRITES(1);
+		WRITES(2);
+	}
+	else if (strncmp(op,"transpose",strlen("transpose") + 1) == 0 && (n == 2 || n == 3)) {
+		READS(1);
+		WRITES(n - 1);
+	}
+	else if ((strncmp(op,"shift",strlen("shift") + 1) == 0 || strncmp(op,"random",strlen("random") + 1) == 0 || strncmp(op,"create",strlen("create") + 1) == 0
+		|| strncmp(op,"delete",strlen("delete") + 1) == 0 || strncmp(op,"reshape",strlen("reshape") + 1) == 0
+		|| strncmp(op,"share",strlen("share") + 1) == 0) && n >= 2) {
+		WRITES(1);
+	}
+	else if ((strncmp(op,"attach",strlen("attach") + 1) == 0 || strncmp(op,"import_csv",strlen("import_csv") + 1) == 0) && n == 3) {
+		WRITES(2);
+	}
+	else if (strncmp(op,"read_region",strlen("read_region") + 1) == 0 && n == 7) {
+		WRITES(6);
+	}
+	/* a background write snapshots the matrix like a duplicate */
+	else if (strncmp(op,"write",strlen("write") + 1) == 0 && n >= 2) {
+		bool background = false;
+		for (unsigned int i = 1; i + 1 < n; ++i) {
+			background = background || strncmp(cmd->cmds[i],"--async",strlen("--async") + 1) == 0;
+		}
+		if (background) {
+			WRITES(n - 1);
+		}
+		else {
+			READS(n - 1);
+		}
+	}
+	else if (strncmp(op,"eval",strlen("eval") + 1) == 0) {
+		size_t found = 0;
+		for (unsigned int i = 1; i < n && found < EXPR_MAX_NODES; ++i) {
+			found += expr_matrix_names(cmd->cmds[i],&storage[found],EXPR_MAX_NODES - found);
+		}
+		for (size_t i = 0; i < found; ++i) {
+			names[count] = storage[i];
+			exclusive[count++] = (i == 0);
+		}
+	}
+	/* the name of a matrix read from a file is only known once it is read */
+	else if (strncmp(op,"read",strlen("read") + 1) == 0 || strncmp(op,"list",strlen("list") + 1) == 0) {
+		return -1;
+	}
+#undef READS
+#undef WRITES
+	return count;
+}
+
+/* 
+ * PURPOSE: runs one request of a server client: the names the command uses
+ *	are locked, shared for reads and exclusive for writes, so commands on
+ *	different matrices, or only reading the same ones, run concurrently
+ * INPUTS: 
+ *	line the request, one command line
+ *  out receives the command output
+ *  arg the registry
+ * RETURN:
+ *  true if the command ran, false if it was unknown or failed
+ *
+ **/
+static bool serve_command (char* line, FILE* out, void* arg) {
+	Registry_t* mats = arg;
+	Commands_t cmd;
+	/* messages of the matrix library belong to the reply as well */
+	message_set_stream(out);
+	if (!parse_user_input(line,&cmd)) {
+		fprintf(out,"Failed at parsing command\n");
+		message_set_stream(NULL);
+		return false;
+	}
+	if (cmd.num_cmds == 0) {
+		message_set_stream(NULL);
+		return true;
+	}
+
+	const char* names[EXPR_MAX_NODES];
+	bool exclusive[EXPR_MAX_NODES];
+	char storage[EXPR_MAX_NODES][MATRIX_NAME_LEN];
+	Registry_Locks_t held;
+	const int count = command_names(&cmd,names,exclusive,storage);
+	if (count < 0) {
+		/* read replaces whatever matrix the file names, list only looks */
+		registry_lock_all(mats,&held,strncmp(cmd.cmds[0],"read",strlen("read") + 1) == 0);
+	}
+	else {
+		registry_lock_names(mats,&held,names,exclusive,count);
+	}
+	reply_stream = out;
+	const bool ok = run_commands(&cmd,mats);
+	reply_stream = NULL;
+	message_set_stream(NULL);
+	registry_unlock_names(mats,&held);
+	return ok;
+}
+
+/* 
+ * PURPOSE: print one line describing a registered matrix, used by list
+ * INPUTS: 
+ *	m the matrix
+ *  arg unused
+ * RETURN:
+ *  nothing
+ *
+ **/
+static void list_matrix (Matrix_t* m, void* arg) {
+	(void) arg;
+	reply("%s (%zu,%zu)\n", m->name, m->rows, m->cols);
+}
+
+/* 
+ * PURPOSE: run one command and record how long it took under its name
+ * INPUTS: 
+ *	cmd : command;
+ *  mats : registry of every live matrix
+ * RETURN:
+ *  true if the command ran, false if it was unknown or failed
+ *
+ **/
+bool run_commands (Commands_t* cmd, Registry_t* mats) {
+	if (cmd == NULL || cmd->num_cmds == 0) {
+		reply("no command in run_commands");
+		return false;
+	}
+	const uint64_t start = stats_now_ns();
+	const bool ok = execute_command(cmd,mats);
+	stats_record_command(cmd->cmds[0],stats_now_ns() - start);
+	return ok;
+}
+
 /* 
  * PURPOSE: run different command will give different result; 
  * INPUTS: 
  *	cmd : command;
- *  mats : matrix  need to be executed;
- *  num_mats : which matrix will be executed
+ *  mats : registry of every live matrix
  * RETURN:
- *  print something what the user want
+ *  print something what the user want,
+ *  true if the command ran, false if it was unknown or failed
  *
  **/
-void run_commands (Commands_t* cmd, Matrix_t** mats, unsigned int num_mats) {
+static bool execute_command (Commands_t* cmd, Registry_t* mats) {
 	// ERROR CHECK INCOMING PARAMETERS
 	if (cmd == NULL){
-		printf("no command in run_commands");
-		return;
+		reply("no command in run_commands");
+		return false;
 	}
-	if (*mats == NULL){
-		printf("no matrix need to be executed");
-		return;
-	}
-	if (num_mats>4294967295){
-		printf("too large number for matrix when running command");
-		return;
+	if (mats == NULL){
+		reply("no matrix need to be executed");
+		return false;
 	}
 
 
 	/*Parsing and calling of commands*/
 	if (strncmp(cmd->cmds[0],"display",strlen("display") + 1) == 0
-		&& cmd->num_cmds == 2) {
+		&& (cmd->num_cmds == 2 || cmd->num_cmds == 6)) {
 			/*find the requested matrix*/
-			int idx = find_matrix_given_name(mats,num_mats,cmd->cmds[1]);
-			if (idx >= 0) {
-				display_matrix (mats[idx]);
+			Matrix_t* m = registry_find(mats,cmd->cmds[1]);
+			if (m == NULL) {
+				reply("Matrix (%s) doesn't exist\n", cmd->cmds[1]);
+				return false;
 			}
-			else {
-				printf("Matrix (%s) doesn't exist\n", cmd->cmds[1]);
-				return;
+			if (cmd->num_cmds == 2) {
+				display_matrix (reply_out(),m);
+			}
+			/* display <m> <r0> <c0> <rows> <cols> shows only that window */
+			else if (! display_matrix_window (reply_out(),m,strtoull(cmd->cmds[2],NULL,10),
+				strtoull(cmd->cmds[3],NULL,10),strtoull(cmd->cmds[4],NULL,10),
+				strtoull(cmd->cmds[5],NULL,10))) {
+				reply("Display Failed\n");
+				return false;
 			}
 	}
 	else if (strncmp(cmd->cmds[0],"add",strlen("add") + 1) == 0
 		&& cmd->num_cmds == 4) {
-			int mat1_idx = find_matrix_given_name(mats,num_mats,cmd->cmds[1]);
-			int mat2_idx = find_matrix_given_name(mats,num_mats,cmd->cmds[2]);
-			if (mat1_idx >= 0 && mat2_idx >= 0) {
+			Matrix_t* a = registry_find(mats,cmd->cmds[1]);
+			Matrix_t* b = registry_find(mats,cmd->cmds[2]);
+			if (a != NULL && b != NULL) {
 				Matrix_t* c = NULL;
-				if( !create_matrix (&c,cmd->cmds[3], mats[mat1_idx]->rows, 
-						mats[mat1_idx]->cols)) {
-					printf("Failure to create the result Matrix (%s)\n", cmd->cmds[3]);
-					return;
+				if( !create_matrix (&c,cmd->cmds[3], a->rows, a->cols)) {
+					reply("Failure to create the result Matrix (%s)\n", cmd->cmds[3]);
+					return false;
+				}
+
+				if (! add_matrices(a,b,c) ) {
+					reply("Failure to add %s with %s into %s\n", a->name, b->name,c->name);
+					destroy_matrix(&c);
+					return false;	
 				}
-			
-				add_matrix_to_array(mats,c, num_mats); 
 				// ERROR CHECK
-				if (add_matrix_to_array(mats,c, num_mats) < 0){
-					printf("fail to get matrix when running add");
-					return;
+				if (! registry_insert(mats,c)){
+					reply("fail to get matrix when running add");
+					destroy_matrix(&c);
+					return false;
 				}
+			}
+			else {
+				reply("Add Failed\n");
+				return false;
+			}
+	}
+	else if (strncmp(cmd->cmds[0],"multiply",strlen("multiply") + 1) == 0
+		&& cmd->num_cmds == 4) {
+			Matrix_t* a = registry_find(mats,cmd->cmds[1]);
+			Matrix_t* b = registry_find(mats,cmd->cmds[2]);
+			if (a == NULL || b == NULL) {
+				reply("Multiply Failed\n");
+				return false;
+			}
+			Matrix_t* c = NULL;
+			if( !create_matrix (&c,cmd->cmds[3], a->rows, b->cols)) {
+				reply("Failure to create the result Matrix (%s)\n", cmd->cmds[3]);
+				return false;
+			}
 
-				if (! add_matrices(mats[mat1_idx], mats[mat2_idx],c) ) {
-					printf("Failure to add %s with %s into %s\n", mats[mat1_idx]->name, mats[mat2_idx]->name,c->name);
-					return;	
-				}
+			struct timespec start, end;
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			if (! multiply_matrices(a,b,c) ) {
+				reply("Failure to multiply %s with %s into %s\n", a->name, b->name, c->name);
+				destroy_matrix(&c);
+				return false;
+			}
+			clock_gettime(CLOCK_MONOTONIC, &end);
+
+			/* one multiply and one add per inner product step */
+			const double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+			const double ops = 2.0 * a->rows * b->cols * a->cols;
+			reply("Matrix (%s) = %s * %s in %.6f s (%.2f Gops/s, %s)\n", c->name,
+				a->name, b->name, seconds, seconds > 0 ? ops / seconds / 1e9 : 0.0,
+				kernel_isa_name());
+			if (! registry_insert(mats,c)){
+				reply("fail to get matrix when running multiply");
+				destroy_matrix(&c);
+				return false;
 			}
 	}
+	else if (strncmp(cmd->cmds[0],"transpose",strlen("transpose") + 1) == 0
+		&& (cmd->num_cmds == 2 || cmd->num_cmds == 3)
+		&& strlen(cmd->cmds[cmd->num_cmds - 1]) + 1 <= MATRIX_NAME_LEN) {
+		Matrix_t* src = registry_find(mats,cmd->cmds[1]);
+		const char* dst_name = cmd->cmds[cmd->num_cmds - 1];
+		if (src == NULL) {
+			reply("Transpose Failed\n");
+			return false;
+		}
+		/* a square matrix transposed onto itself needs no second buffer */
+		if (src->rows == src->cols && strncmp(src->name,dst_name,MATRIX_NAME_LEN) == 0) {
+			if (! transpose_matrix(src,src)) {
+				reply("fail to transpose matrix in place");
+				return false;
+			}
+		}
+		else {
+			Matrix_t* dst = NULL;
+			if (! create_matrix(&dst,dst_name,src->cols,src->rows)) {
+				reply("Failure to create the result Matrix (%s)\n", dst_name);
+				return false;
+			}
+			if (! transpose_matrix(src,dst)) {
+				reply("fail to transpose matrix");
+				destroy_matrix(&dst);
+				return false;
+			}
+			// ERROR CHECK
+			if (! registry_insert(mats,dst)){
+				reply("fail to add matrix when running transpose");
+				destroy_matrix(&dst);
+				return false;
+			}
+		}
+		reply("Matrix (%s) transposed into (%s)\n", cmd->cmds[1], dst_name);
+	}
+	else if (strncmp(cmd->cmds[0],"reshape",strlen("reshape") + 1) == 0
+		&& cmd->num_cmds == 4) {
+		Matrix_t* m = registry_find(mats,cmd->cmds[1]);
+		const size_t rows = strtoull(cmd->cmds[2],NULL,10);
+		const size_t cols = strtoull(cmd->cmds[3],NULL,10);
+		if (m == NULL || ! reshape_matrix(m,rows,cols)) {
+			reply("Reshape Failed\n");
+			return false;
+		}
+		reply("Matrix (%s) reshaped to (%zu,%zu)\n", m->name, m->rows, m->cols);
+	}
+	else if (strncmp(cmd->cmds[0],"export_csv",strlen("export_csv") + 1) == 0
+		&& cmd->num_cmds == 3) {
+		Matrix_t* m = registry_find(mats,cmd->cmds[1]);
+		if (m == NULL || ! write_matrix_csv(cmd->cmds[2],m)) {
+			reply("Export Failed\n");
+			return false;
+		}
+		reply("Matrix (%s) exported to %s\n", m->name, cmd->cmds[2]);
+	}
+	else if (strncmp(cmd->cmds[0],"import_csv",strlen("import_csv") + 1) == 0
+		&& cmd->num_cmds == 3 && strlen(cmd->cmds[2]) + 1 <= MATRIX_NAME_LEN) {
+		Matrix_t* new_matrix = NULL;
+		if (! read_matrix_csv(cmd->cmds[1],cmd->cmds[2],&new_matrix)) {
+			reply("Import Failed\n");
+			return false;
+		}
+		// ERROR CHECK
+		if (! registry_insert(mats,new_matrix)){
+			reply("fail to add matrix when importing");
+			destroy_matrix(&new_matrix);
+			return false;
+			}
+		reply("Matrix (%s,%zu,%zu) imported from %s\n", new_matrix->name, new_matrix->rows,
+			new_matrix->cols, cmd->cmds[1]);
+	}
+	else if (strncmp(cmd->cmds[0],"share",strlen("share") + 1) == 0
+		&& cmd->num_cmds == 3) {
+		Matrix_t* m = registry_find(mats,cmd->cmds[1]);
+		if (m == NULL || ! share_matrix_shm(m,cmd->cmds[2])) {
+			reply("Share Failed\n");
+			return false;
+		}
+		reply("Matrix (%s) is shared as %s\n", m->name, m->shm->shm_name);
+	}
+	else if (strncmp(cmd->cmds[0],"attach",strlen("attach") + 1) == 0
+		&& cmd->num_cmds == 3) {
+		Matrix_t* new_matrix = NULL;
+		if (! attach_matrix_shm(cmd->cmds[1],cmd->cmds[2],&new_matrix)) {
+			reply("Attach Failed\n");
+			return false;
+		}
+		// ERROR CHECK
+		if (! registry_insert(mats,new_matrix)){
+			reply("fail to add matrix when attaching");
+			destroy_matrix(&new_matrix);
+			return false;
+			}
+		reply("Matrix (%s,%zu,%zu) is attached to %s\n", new_matrix->name, new_matrix->rows,
+			new_matrix->cols, new_matrix->shm->shm_name);
+	}
 	else if (strncmp(cmd->cmds[0],"duplicate",strlen("duplicate") + 1) == 0
-		&& cmd->num_cmds == 2 && strlen(cmd->cmds[1]) + 1 <= MATRIX_NAME_LEN) {
-		int mat1_idx = find_matrix_given_name(mats,num_mats,cmd->cmds[1]);
-		if (mat1_idx >= 0 ) {
+		&& cmd->num_cmds == 3 && strlen(cmd->cmds[2]) + 1 <= MATRIX_NAME_LEN) {
+		Matrix_t* src = registry_find(mats,cmd->cmds[1]);
+		if (src != NULL ) {
 				Matrix_t* dup_mat = NULL;
-				if( !create_matrix (&dup_mat,cmd->cmds[2], mats[mat1_idx]->rows, 
-						mats[mat1_idx]->cols)) {
-					return;
-				}
-				duplicate_matrix (mats[mat1_idx], dup_mat); 
 				// ERROR CHECK
-				if (! duplicate_matrix (mats[mat1_idx], dup_mat)){
-					printf("fail to duplicate matrix");
-					return;
+				if (! clone_matrix (&dup_mat,cmd->cmds[2],src)){
+					reply("fail to duplicate matrix");
+					return false;
 				}
-				add_matrix_to_array(mats,dup_mat,num_mats); 
+				reply("Duplication of %s into %s finished\n", src->name, cmd->cmds[2]);
 				// ERROR CHECK 
-				if (add_matrix_to_array(mats,dup_mat,num_mats) < 0){
-					printf("fail to add matrix when duplicates");
-					return;
+				if (! registry_insert(mats,dup_mat)){
+					reply("fail to add matrix when duplicates");
+					destroy_matrix(&dup_mat);
+					return false;
 				}
-				printf ("Duplication of %s into %s finished\n", mats[mat1_idx]->name, cmd->cmds[2]);
 		}
 		else {
-			printf("Duplication Failed\n");
-			return;
+			reply("Duplication Failed\n");
+			return false;
 		}
 	}
 	else if (strncmp(cmd->cmds[0],"equal",strlen("equal") + 1) == 0
-		&& cmd->num_cmds == 2) {
-			int mat1_idx = find_matrix_given_name(mats,num_mats,cmd->cmds[1]);
-			int mat2_idx = find_matrix_given_name(mats,num_mats,cmd->cmds[2]);
-			if (mat1_idx >= 0 && mat2_idx >= 0) {
-				if ( equal_matrices(mats[mat1_idx],mats[mat2_idx]) ) {
-					printf("SAME DATA IN BOTH\n");
+		&& cmd->num_cmds == 3) {
+			Matrix_t* a = registry_find(mats,cmd->cmds[1]);
+			Matrix_t* b = registry_find(mats,cmd->cmds[2]);
+			if (a != NULL && b != NULL) {
+				if ( equal_matrices(a,b) ) {
+					reply("SAME DATA IN BOTH\n");
 				}
 				else {
-					printf("DIFFERENT DATA IN BOTH\n");
+					reply("DIFFERENT DATA IN BOTH\n");
 				}
 			}
 			else {
-				printf("Equal Failed\n");
-				return;
+				reply("Equal Failed\n");
+				return false;
+			}
+	}
+	else if (strncmp(cmd->cmds[0],"sum",strlen("sum") + 1) == 0
+		&& cmd->num_cmds == 2) {
+			Matrix_t* m = registry_find(mats,cmd->cmds[1]);
+			uint64_t sum = 0;
+			if (m != NULL && sum_matrix(m,&sum)) {
+				reply("Sum of Matrix (%s) = %llu\n", m->name, (unsigned long long) sum);
+			}
+			else {
+				reply("Sum Failed\n");
+				return false;
 			}
 	}
 	else if (strncmp(cmd->cmds[0],"shift",strlen("shift") + 1) == 0
 		&& cmd->num_cmds == 4) {
-		int mat1_idx = find_matrix_given_name(mats,num_mats,cmd->cmds[1]);
+		Matrix_t* m = registry_find(mats,cmd->cmds[1]);
 		const int shift_value = atoi(cmd->cmds[3]);
-		if (mat1_idx >= 0 ) {
-			bitwise_shift_matrix(mats[mat1_idx],cmd->cmds[2][0], shift_value); 
+		if (m != NULL ) {
 			//ERROR CHECK
-			if (bitwise_shift_matrix(mats[mat1_idx],cmd->cmds[2][0], shift_value)){
-				printf("fail to bitwise shift when running shift");
-				return;
+			if (! bitwise_shift_matrix(m,cmd->cmds[2][0], shift_value)){
+				reply("fail to bitwise shift when running shift");
+				return false;
 				}
-			printf("Matrix (%s) has been shifted by %d\n", mats[mat1_idx]->name, shift_value);
+			reply("Matrix (%s) has been shifted by %d\n", m->name, shift_value);
 				
 		}	
 		else {
-			printf("Matrix shift failed\n");
-			return;
+			reply("Matrix shift failed\n");
+			return false;
 		}
 
 	}
+	else if (strncmp(cmd->cmds[0],"eval",strlen("eval") + 1) == 0
+		&& cmd->num_cmds >= 2) {
+		/* the tokens are consecutive in the line, rejoin them into one string */
+		for (unsigned int i = 1; i + 1 < cmd->num_cmds; ++i) {
+			cmd->cmds[i][strlen(cmd->cmds[i])] = ' ';
+		}
+		if (!eval_expression(mats,cmd->cmds[1])) {
+			reply("Eval failed\n");
+			return false;
+		}
+		reply("Expression (%s) evaluated in one pass\n", cmd->cmds[1]);
+	}
 	else if (strncmp(cmd->cmds[0],"read",strlen("read") + 1) == 0
-		&& cmd->num_cmds == 2) {
+		&& (cmd->num_cmds == 2 || (cmd->num_cmds == 3
+		&& strncmp(cmd->cmds[1],"--mmap",strlen("--mmap") + 1) == 0))) {
+		/* read --mmap <file> maps the file instead of copying it in */
+		const bool mapped = cmd->num_cmds == 3;
+		const char* filename = cmd->cmds[cmd->num_cmds - 1];
 		Matrix_t* new_matrix = NULL;
-		if(! read_matrix(cmd->cmds[1],&new_matrix)) {
-			printf("Read Failed\n");
-			return;
+		if(! (mapped ? read_matrix_mmap(filename,&new_matrix) : read_matrix(filename,&new_matrix))) {
+			reply("Read Failed\n");
+			return false;
 		}	
 		
-		add_matrix_to_array(mats,new_matrix, num_mats); 
 		// ERROR CHECK
-		if (add_matrix_to_array(mats,new_matrix, num_mats) < 0){
-			printf("fail to add matrix when duplicates");
-			return;
+		if (! registry_insert(mats,new_matrix)){
+			reply("fail to add matrix when reading");
+			destroy_matrix(&new_matrix);
+			return false;
 			}
-		printf("Matrix (%s) is read from the filesystem\n", cmd->cmds[1]);	
+		reply("Matrix (%s) is %s from the filesystem\n", filename, mapped ? "mapped" : "read");	
 	}
-	else if (strncmp(cmd->cmds[0],"write",strlen("write") + 1) == 0
+	else if (strncmp(cmd->cmds[0],"add_files",strlen("add_files") + 1) == 0
+		&& cmd->num_cmds == 4) {
+		/* add_files <a> <b> <out> streams both files through memory block by block */
+		if (! add_files(cmd->cmds[1],cmd->cmds[2],cmd->cmds[3],stream_block_bytes)) {
+			reply("add_files failed\n");
+			return false;
+		}
+		reply("%s + %s is wrote out to %s\n", cmd->cmds[1], cmd->cmds[2], cmd->cmds[3]);
+	}
+	else if (strncmp(cmd->cmds[0],"shift_file",strlen("shift_file") + 1) == 0
+		&& cmd->num_cmds == 5) {
+		/* shift_file <in> <out> <direction> <n> */
+		const int shift_value = atoi(cmd->cmds[4]);
+		if (shift_value < 0 || ! shift_file(cmd->cmds[1],cmd->cmds[2],cmd->cmds[3][0],
+			shift_value,stream_block_bytes)) {
+			reply("shift_file failed\n");
+			return false;
+		}
+		reply("%s shifted by %d is wrote out to %s\n", cmd->cmds[1], shift_value, cmd->cmds[2]);
+	}
+	else if (strncmp(cmd->cmds[0],"sum_file",strlen("sum_file") + 1) == 0
 		&& cmd->num_cmds == 2) {
-		int mat1_idx = find_matrix_given_name(mats,num_mats,cmd->cmds[1]);
-		if(! write_matrix(mats[mat1_idx]->name,mats[mat1_idx])) {
-			printf("Write Failed\n");
-			return;
+		uint64_t sum = 0;
+		if (! sum_file(cmd->cmds[1],&sum,stream_block_bytes)) {
+			reply("sum_file failed\n");
+			return false;
+		}
+		reply("Sum of Matrix file (%s) = %llu\n", cmd->cmds[1], (unsigned long long) sum);
+	}
+	else if (strncmp(cmd->cmds[0],"read_region",strlen("read_region") + 1) == 0
+		&& cmd->num_cmds == 7 && strlen(cmd->cmds[6]) + 1 <= MATRIX_NAME_LEN) {
+		/* read_region <file> <r0> <c0> <rows> <cols> <name> loads only that window */
+		size_t region[4];
+		for (unsigned int i = 0; i < 4; ++i) {
+			char* end = NULL;
+			region[i] = strtoull(cmd->cmds[i + 2],&end,10);
+			if (*end != '\0' || cmd->cmds[i + 2][0] == '-') {
+				reply("read_region needs <file> <r0> <c0> <rows> <cols> <name>\n");
+				return false;
+			}
+		}
+		Matrix_t* new_matrix = NULL;
+		if (! read_matrix_region(cmd->cmds[1],region[0],region[1],region[2],region[3],
+			cmd->cmds[6],&new_matrix)) {
+			reply("Read Failed\n");
+			return false;
+		}
+		if (! registry_insert(mats,new_matrix)){
+			reply("fail to add matrix when reading");
+			destroy_matrix(&new_matrix);
+			return false;
+		}
+		reply("Matrix (%s) is read from region (%zu,%zu) %zux%zu of %s\n", new_matrix->name,
+			region[0], region[1], region[2], region[3], cmd->cmds[1]);
+	}
+	else if (strncmp(cmd->cmds[0],"write",strlen("write") + 1) == 0
+		&& cmd->num_cmds >= 2 && cmd->num_cmds <= 6) {
+		/* write --sync <matrix> forces the data to disk before reporting success,
+		 * write --compress <matrix> stores it in the compressed block format,
+		 * write --tiled <matrix> stores it as tiles for read_region,
+		 * write --async <matrix> returns at once and writes in the background */
+		bool sync = false;
+		bool compress = false;
+		bool tiled = false;
+		bool background = false;
+		for (unsigned int i = 1; i + 1 < cmd->num_cmds; ++i) {
+			if (strncmp(cmd->cmds[i],"--sync",strlen("--sync") + 1) == 0) {
+				sync = true;
+			}
+			else if (strncmp(cmd->cmds[i],"--async",strlen("--async") + 1) == 0) {
+				background = true;
+			}
+			else if (strncmp(cmd->cmds[i],"--compress",strlen("--compress") + 1) == 0) {
+				compress = true;
+			}
+			else if (strncmp(cmd->cmds[i],"--tiled",strlen("--tiled") + 1) == 0) {
+				tiled = true;
+			}
+			else {
+				reply("unknown write option %s\n", cmd->cmds[i]);
+				return false;
+			}
+		}
+		if (compress && tiled) {
+			reply("write can not both --compress and --tiled\n");
+			return false;
+		}
+		Matrix_t* m = registry_find(mats,cmd->cmds[cmd->num_cmds - 1]);
+		if (m == NULL) {
+			reply("Matrix (%s) doesn't exist\n", cmd->cmds[cmd->num_cmds - 1]);
+			return false;
+		}
+		if (background) {
+			const Async_Write_Format_t format = compress ? ASYNC_WRITE_COMPRESSED
+				: (tiled ? ASYNC_WRITE_TILED : ASYNC_WRITE_RAW);
+			if (! async_write_matrix(m->name,m,format,sync)) {
+				reply("Write Failed\n");
+				return false;
+			}
+			reply("Matrix (%s) is being written in the background\n", m->name);
+			return true;
+		}
+		bool written;
+		if (compress) {
+			written = write_matrix_compressed(m->name,m,sync);
+		}
+		else if (tiled) {
+			written = write_matrix_tiled(m->name,m,sync);
+		}
+		else {
+			written = write_matrix_stream(m->name,m,sync);
+		}
+		if(! written) {
+			reply("Write Failed\n");
+			return false;
 		}
 		else {
-			printf("Matrix (%s) is wrote out to the filesystem\n", mats[mat1_idx]->name);
+			reply("Matrix (%s) is wrote out to the filesystem\n", m->name);
+		}
+	}
+	else if (strncmp(cmd->cmds[0], "flush", strlen("flush") + 1) == 0
+		&& cmd->num_cmds == 1) {
+		const size_t pending = async_pending();
+		if (! async_flush()) {
+			reply("Flush Failed, a background write did not complete\n");
+			return false;
 		}
+		reply("%zu background writes flushed\n", pending);
+	}
+	else if (strncmp(cmd->cmds[0], "wait", strlen("wait") + 1) == 0
+		&& cmd->num_cmds == 2) {
+		if (! async_wait_matrix(cmd->cmds[1])) {
+			reply("Background write of Matrix (%s) failed\n", cmd->cmds[1]);
+			return false;
+		}
+		reply("Matrix (%s) has no pending writes\n", cmd->cmds[1]);
 	}
 	else if (strncmp(cmd->cmds[0], "create", strlen("create") + 1) == 0
-		&& strlen(cmd->cmds[1]) + 1 <= MATRIX_NAME_LEN && cmd->num_cmds == 4) {
+		&& cmd->num_cmds == 4 && strlen(cmd->cmds[1]) + 1 <= MATRIX_NAME_LEN) {
 		Matrix_t* new_mat = NULL;
-		const unsigned int rows = atoi(cmd->cmds[2]);
-		const unsigned int cols = atoi(cmd->cmds[3]);
+		const size_t rows = strtoull(cmd->cmds[2],NULL,10);
+		const size_t cols = strtoull(cmd->cmds[3],NULL,10);
 
-		create_matrix(&new_mat,cmd->cmds[1],rows, cols); 
 		// ERROR CHECK 
 		if (! create_matrix (&new_mat,cmd->cmds[1],rows, cols)){
-			printf("program failed to create when running create\n");
-			return;
+			reply("program failed to create when running create\n");
+			return false;
 		}
-		add_matrix_to_array(mats,new_mat,num_mats); 
 		//  ERROR CHECK 
-		if (add_matrix_to_array(mats,new_mat,num_mats) < 0){
-			printf("fail to add matrix when running create");
-			return;
+		if (! registry_insert(mats,new_mat)){
+			reply("fail to add matrix when running create");
+			destroy_matrix(&new_mat);
+			return false;
 			}
-		printf("Created Matrix (%s,%u,%u)\n", new_mat->name, new_mat->rows, new_mat->cols);
+		reply("Created Matrix (%s,%zu,%zu)\n", new_mat->name, new_mat->rows, new_mat->cols);
 	}
 	else if (strncmp(cmd->cmds[0], "random", strlen("random") + 1) == 0
-		&& cmd->num_cmds == 4) {
-		int mat1_idx = find_matrix_given_name(mats,num_mats,cmd->cmds[1]);
-		const unsigned int start_range = atoi(cmd->cmds[2]);
-		const unsigned int end_range = atoi(cmd->cmds[3]);
-		random_matrix(mats[mat1_idx],start_range, end_range); 
+		&& (cmd->num_cmds == 4 || cmd->num_cmds == 5)) {
+		Matrix_t* m = registry_find(mats,cmd->cmds[1]);
+		char* end = NULL;
+		const unsigned long start_range = strtoul(cmd->cmds[2],&end,0);
+		bool valid = *end == '\0' && start_range <= UINT_MAX;
+		const unsigned long end_range = strtoul(cmd->cmds[3],&end,0);
+		valid = valid && *end == '\0' && end_range <= UINT_MAX;
+		/* without a seed the session sequence is used and printed so the run can be repeated */
+		uint64_t seed;
+		if (cmd->num_cmds == 5) {
+			seed = strtoull(cmd->cmds[4],&end,0);
+			valid = valid && *end == '\0';
+		}
+		else {
+			/* server clients draw seeds concurrently */
+			seed = __atomic_fetch_add(&next_seed,1,__ATOMIC_RELAXED);
+		}
 		//ERROR CHECK
-		if (! random_matrix(mats[mat1_idx],start_range, end_range)){
-			printf("no random matrix when running random");
-			return;
+		if (! valid) {
+			reply("random needs <matrix> <lo> <hi> [seed] with 0 <= lo <= hi <= %u\n", UINT_MAX);
+			return false;
+		}
+		if (m == NULL || ! random_matrix(m,start_range, end_range, seed)){
+			reply("no random matrix when running random");
+			return false;
 		}
 
-		printf("Matrix (%s) is randomized between %u %u\n", mats[mat1_idx]->name, start_range, end_range);
+		reply("Matrix (%s) is randomized between %lu %lu (seed %llu)\n", m->name, start_range,
+			end_range, (unsigned long long) seed);
 	}
-	else {
-		printf("Not a command in this application\n");
-	}
-
-}
-
-/* 
- * PURPOSE: try to find the matrix given the name of matrix 
- * INPUTS: 
- *	mats the list of matrix
- *  num_mats the number of matrix stored in mats
- *  target the name of matrix
- * RETURN:
- *  If no errors occurred during instantiation then value of position
- *  else -1 for an error in the process.
- *
- **/
-unsigned int find_matrix_given_name (Matrix_t** mats, unsigned int num_mats, const char* target) {
-	// ERROR CHECK INCOMING PARAMETERS
-	if (*mats == NULL){
-		printf("no matrix input");
-		return -1;
+	else if (strncmp(cmd->cmds[0], "delete", strlen("delete") + 1) == 0
+		&& cmd->num_cmds == 2) {
+		if (! registry_remove(mats,cmd->cmds[1])) {
+			reply("Matrix (%s) doesn't exist\n", cmd->cmds[1]);
+			return false;
+		}
+		reply("Matrix (%s) deleted\n", cmd->cmds[1]);
 	}
-	if (num_mats > 4294967295){
-		printf("too large length");
-		return -1;
+	else if (strncmp(cmd->cmds[0], "list", strlen("list") + 1) == 0
+		&& cmd->num_cmds == 1) {
+		registry_foreach(mats,list_matrix,NULL);
+		reply("%zu matrices\n", registry_count(mats));
 	}
-	if (strlen(target) > 50){
-		printf("the length of name is too long");
-		return -1;
+	else if (strncmp(cmd->cmds[0], "stats", strlen("stats") + 1) == 0
+		&& cmd->num_cmds == 1) {
+		stats_print(reply_out());
 	}
-
-	for (int i = 0; i < num_mats; ++i) {
-		if (strncmp(mats[i]->name,target,strlen(mats[i]->name)) == 0) {
-			return i;
+	else if (strncmp(cmd->cmds[0], "stats", strlen("stats") + 1) == 0
+		&& (cmd->num_cmds == 2 || cmd->num_cmds == 3 || cmd->num_cmds == 5)) {
+		Matrix_t* m = registry_find(mats,cmd->cmds[1]);
+		if (m == NULL) {
+			reply("Matrix (%s) doesn't exist\n", cmd->cmds[1]);
+			return false;
+		}
+		Matrix_Stats_t stats = { .bins = 0 };
+		if (cmd->num_cmds >= 3) {
+			char* end = NULL;
+			const unsigned long bins = strtoul(cmd->cmds[2],&end,0);
+			bool valid = *end == '\0' && bins >= 1 && bins <= MATRIX_STATS_MAX_BINS;
+			if (cmd->num_cmds == 5) {
+				const unsigned long lo = strtoul(cmd->cmds[3],&end,0);
+				valid = valid && *end == '\0' && lo <= UINT_MAX;
+				const unsigned long hi = strtoul(cmd->cmds[4],&end,0);
+				valid = valid && *end == '\0' && hi <= UINT_MAX && lo <= hi;
+				stats.lo = lo;
+				stats.hi = hi;
+			}
+			else {
+				/* the range of the data, free when the summary is cached */
+				Matrix_Summary_t summary;
+				valid = valid && summarize_matrix(m,&summary);
+				stats.lo = m->rows * m->cols > 0 ? summary.min : 0;
+				stats.hi = m->rows * m->cols > 0 ? summary.max : 0;
+			}
+			if (! valid) {
+				reply("stats needs <matrix> [bins [lo hi]] with 1 <= bins <= %d and lo <= hi\n",
+					MATRIX_STATS_MAX_BINS);
+				return false;
+			}
+			stats.bins = bins;
+			stats.histogram = calloc(bins,sizeof(uint64_t));
+			if (stats.histogram == NULL) {
+				reply("no memory for the histogram\n");
+				return false;
+			}
 		}
+		if (! describe_matrix(m,&stats)) {
+			free(stats.histogram);
+			reply("Stats Failed\n");
+			return false;
+		}
+		reply("Matrix (%s): min %u max %u sum %llu mean %.6f variance %.6f\n", m->name,
+			stats.min, stats.max, (unsigned long long) stats.sum, stats.mean, stats.variance);
+		for (unsigned int b = 0; b < stats.bins; ++b) {
+			const uint64_t first = stats.lo + b * stats.bin_width;
+			const uint64_t last = first + stats.bin_width - 1 < stats.hi ? first + stats.bin_width - 1 : stats.hi;
+			reply("[%llu, %llu] %llu\n", (unsigned long long) first, (unsigned long long) last,
+				(unsigned long long) stats.histogram[b]);
+		}
+		if (stats.bins > 0 && (stats.below > 0 || stats.above > 0)) {
+			reply("below %u: %llu, above %u: %llu\n", stats.lo, (unsigned long long) stats.below,
+				stats.hi, (unsigned long long) stats.above);
+		}
+		free(stats.histogram);
 	}
-	return -1;
-}
-
-/* 
- * PURPOSE: realease all memory 
- * INPUTS: 
- *	mats the list of matrix
- *  num_mats the number of matrix stored in mats
- * RETURN:
- *  print some information
- *
- **/
-void destroy_remaining_heap_allocations(Matrix_t **mats, unsigned int num_mats) {
-	
-	// ERROR CHECK INCOMING PARAMETERS
-	if ((*mats) == NULL){
-		printf ("no matrix input when realeasing memory");
-		return;
+	else if ((strncmp(cmd->cmds[0],"rowsum",strlen("rowsum") + 1) == 0
+		|| strncmp(cmd->cmds[0],"colsum",strlen("colsum") + 1) == 0)
+		&& cmd->num_cmds == 3 && strlen(cmd->cmds[2]) + 1 <= MATRIX_NAME_LEN) {
+		const bool rows = strncmp(cmd->cmds[0],"rowsum",strlen("rowsum") + 1) == 0;
+		Matrix_t* m = registry_find(mats,cmd->cmds[1]);
+		if (m == NULL) {
+			reply("Matrix (%s) doesn't exist\n", cmd->cmds[1]);
+			return false;
+		}
+		Matrix_t* result = NULL;
+		if (! create_matrix(&result,cmd->cmds[2],rows ? m->rows : 1,rows ? 1 : m->cols)) {
+			reply("Failure to create the result Matrix (%s)\n", cmd->cmds[2]);
+			return false;
+		}
+		if (! (rows ? rowsum_matrix(m,result) : colsum_matrix(m,result))) {
+			reply("fail to sum the %s of the matrix", rows ? "rows" : "columns");
+			destroy_matrix(&result);
+			return false;
+		}
+		// ERROR CHECK
+		if (! registry_insert(mats,result)){
+			reply("fail to add matrix when running %s", cmd->cmds[0]);
+			destroy_matrix(&result);
+			return false;
+		}
+		reply("%s sums of Matrix (%s) stored in (%s,%zu,%zu)\n", rows ? "Row" : "Column",
+			cmd->cmds[1], result->name, result->rows, result->cols);
 	}
-	if (num_mats > 4294967295){
-		printf("too large for matrix length");
-		return;
+	else if (strncmp(cmd->cmds[0], "pool", strlen("pool") + 1) == 0
+		&& cmd->num_cmds == 2 && strncmp(cmd->cmds[1], "stats", strlen("stats") + 1) == 0) {
+		Mempool_Stats_t stats;
+		mempool_get_stats(&stats);
+		const uint64_t data_requests = stats.data_hits + stats.data_misses;
+		const uint64_t header_requests = stats.header_hits + stats.header_misses;
+		reply("data buffers: %llu hits, %llu misses (%.1f%% hit rate)\n",
+			(unsigned long long) stats.data_hits, (unsigned long long) stats.data_misses,
+			data_requests ? 100.0 * stats.data_hits / data_requests : 0.0);
+		reply("retained: %zu buffers, %zu bytes\n", stats.buffers_retained, stats.bytes_retained);
+		reply("headers: %llu from free list, %zu slabs, %zu free (%.1f%% hit rate)\n",
+			(unsigned long long) stats.header_hits, stats.header_slabs, stats.headers_free,
+			header_requests ? 100.0 * stats.header_hits / header_requests : 0.0);
 	}
-
-	// COMPLETE MISSING MEMORY CLEARING HERE
-	//*mats = calloc(num_mats, sizeof(Matrix_t));
-	//*mats = malloc(num_mats*sizeof(Matrix_t));
-	//*mats= realloc((*mats), num_mats*sizeof(Matrix_t));
-	for (int i = 0; i < num_mats; ++i) {
-		destroy_matrix(mats[num_mats]);
-		return;
+	else {
+		reply("Not a command in this application\n");
+		return false;
 	}
-	//free((*mats));
-	//*mats=NULL;
-	
+	return true;
 }
@@ -2,67 +2,354 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
 
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <errno.h>
+#include <pthread.h>
 
 
 #include "matrix.h"
+#include "kernels.h"
+#include "threadpool.h"
+#include "mempool.h"
+#include "stats.h"
+#include "compress.h"
+#include "textio.h"
+#include "message.h"
 
 
-#define MAX_CMD_COUNT 50
+/* largest single writev issued by write_matrix_stream */
+#define WRITE_CHUNK_BYTES (64u << 20)
+/* largest single read issued by read_matrix, Linux caps one read near 2 GiB */
+#define READ_CHUNK_BYTES (64u << 20)
+/* blocks compressed per batch by write_matrix_compressed before they are written */
+#define COMPRESS_BATCH_BLOCKS 256
+/* tile edge written by write_matrix_tiled, 256 x 256 elements is 256 KiB */
+#define WRITE_TILE_DIM 256
+/* tile rows handed to one writev, one vector per row of a tile */
+#define TILE_IOV_MAX 1024
+/* elements formatted per step of display_matrix_window */
+#define DISPLAY_CHUNK 1024
 
 /*protected functions*/
 void load_matrix (Matrix_t* m, unsigned int* data);
+static void release_data (Matrix_t* m);
+static void release_segment (Matrix_Shm_Header_t* header, size_t len);
+static uint64_t data_generation (Matrix_t* m);
+
+/* arguments shared by the parallel_for tasks below, each task sees [begin,end) */
+typedef struct {
+	unsigned int* a;
+	unsigned int* b;
+	unsigned int* c;
+	char direction;
+	unsigned int shift;
+	unsigned int start_range;
+	unsigned int end_range;
+	uint64_t seed;
+	uint64_t sum;
+	uint64_t hash;
+	unsigned int min;
+	unsigned int max;
+	bool differ;
+}Element_Task_t;
+
+/* arguments of the block codec tasks, every task handles the blocks that
+ * start inside its [begin,end) element range */
+typedef struct {
+	unsigned int* data;
+	size_t n;
+	const unsigned char* blocks;
+	const unsigned char* offsets;
+	unsigned char* out;
+	size_t out_stride;
+	size_t* lengths;
+	bool failed;
+}Block_Task_t;
+
+/* arguments of the transpose tasks, src is rows x cols and dst cols x rows */
+typedef struct {
+	const unsigned int* src;
+	unsigned int* dst;
+	size_t rows;
+	size_t cols;
+	size_t tiles;
+}Transpose_Task_t;
+
+/* arguments of describe_matrix, each task merges its partial results under lock */
+typedef struct {
+	const unsigned int* a;
+	Matrix_Stats_t* stats;
+	unsigned __int128 sumsq;
+	pthread_mutex_t lock;
+	bool failed;
+}Stats_Task_t;
+
+/* arguments of the row and column sums, each task sees the rows that start
+ * inside its [begin,end) element range */
+typedef struct {
+	const unsigned int* src;
+	unsigned int* dst;
+	size_t cols;
+	pthread_mutex_t lock;
+	bool failed;
+}Reduce_Task_t;
+
+/* elements describe_matrix handles per step, small enough that the histogram
+ * pass finds the block in L1 right after the moments pass */
+#define STATS_BLOCK 4096
+
+/* guards the summary caches, which readers sharing a matrix may fill at once */
+static pthread_mutex_t summary_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* tile edge of the in-place transpose, one pair of tiles is one unit of work */
+#define TRANSPOSE_TILE 64
+
+static void add_task (size_t begin, size_t end, void* arg) {
+	Element_Task_t* t = arg;
+	kernel_add(&t->a[begin],&t->b[begin],&t->c[begin],end - begin);
+}
+
+static void shift_task (size_t begin, size_t end, void* arg) {
+	Element_Task_t* t = arg;
+	kernel_shift(&t->a[begin],end - begin,t->direction,t->shift);
+}
+
+static void summary_task (size_t begin, size_t end, void* arg) {
+	Element_Task_t* t = arg;
+	unsigned int min, max;
+	uint64_t hash;
+	__atomic_fetch_add(&t->sum,kernel_summary(&t->a[begin],end - begin,begin,&min,&max,&hash),
+		__ATOMIC_RELAXED);
+	__atomic_fetch_add(&t->hash,hash,__ATOMIC_RELAXED);
+	unsigned int seen = __atomic_load_n(&t->min,__ATOMIC_RELAXED);
+	while (min < seen && !__atomic_compare_exchange_n(&t->min,&seen,min,true,
+		__ATOMIC_RELAXED,__ATOMIC_RELAXED)) {
+	}
+	seen = __atomic_load_n(&t->max,__ATOMIC_RELAXED);
+	while (max > seen && !__atomic_compare_exchange_n(&t->max,&seen,max,true,
+		__ATOMIC_RELAXED,__ATOMIC_RELAXED)) {
+	}
+}
+
+static void stats_task (size_t begin, size_t end, void* arg) {
+	Stats_Task_t* t = arg;
+	Matrix_Stats_t* stats = t->stats;
+	uint64_t* counts = NULL;
+	if (stats->bins > 0) {
+		counts = calloc(stats->bins,sizeof(uint64_t));
+		if (!counts) {
+			__atomic_store_n(&t->failed,true,__ATOMIC_RELAXED);
+			return;
+		}
+	}
+	unsigned int min = UINT_MAX;
+	unsigned int max = 0;
+	uint64_t sum = 0;
+	uint64_t below = 0;
+	uint64_t above = 0;
+	unsigned __int128 sumsq = 0;
+	for (size_t i = begin; i < end; i += STATS_BLOCK) {
+		const size_t n = end - i < STATS_BLOCK ? end - i : STATS_BLOCK;
+		unsigned int lo, hi;
+		unsigned __int128 squares;
+		sum += kernel_moments(&t->a[i],n,&lo,&hi,&squares);
+		sumsq += squares;
+		min = lo < min ? lo : min;
+		max = hi > max ? hi : max;
+		if (counts) {
+			kernel_histogram(&t->a[i],n,stats->lo,stats->hi,stats->bin_width,counts,&below,&above);
+		}
+	}
+	pthread_mutex_lock(&t->lock);
+	stats->sum += sum;
+	t->sumsq += sumsq;
+	stats->min = min < stats->min ? min : stats->min;
+	stats->max = max > stats->max ? max : stats->max;
+	stats->below += below;
+	stats->above += above;
+	for (unsigned int b = 0; counts && b < stats->bins; ++b) {
+		stats->histogram[b] += counts[b];
+	}
+	pthread_mutex_unlock(&t->lock);
+	free(counts);
+}
+
+/* sums the rows that start inside [begin,end) */
+static void rowsum_task (size_t begin, size_t end, void* arg) {
+	Reduce_Task_t* t = arg;
+	const size_t first = (begin + t->cols - 1) / t->cols;
+	const size_t last = (end + t->cols - 1) / t->cols;
+	for (size_t r = first; r < last; ++r) {
+		t->dst[r] = (unsigned int) kernel_sum(&t->src[r * t->cols],t->cols);
+	}
+}
+
+/* adds the rows that start inside [begin,end) into a private row, streaming
+ * them in memory order, then adds that row into the result */
+static void colsum_task (size_t begin, size_t end, void* arg) {
+	Reduce_Task_t* t = arg;
+	const size_t first = (begin + t->cols - 1) / t->cols;
+	const size_t last = (end + t->cols - 1) / t->cols;
+	if (first >= last) {
+		return;
+	}
+	unsigned int* acc = malloc(t->cols * sizeof(unsigned int));
+	if (!acc) {
+		__atomic_store_n(&t->failed,true,__ATOMIC_RELAXED);
+		return;
+	}
+	memcpy(acc,&t->src[first * t->cols],t->cols * sizeof(unsigned int));
+	for (size_t r = first + 1; r < last; ++r) {
+		kernel_add(&t->src[r * t->cols],acc,acc,t->cols);
+	}
+	pthread_mutex_lock(&t->lock);
+	kernel_add(acc,t->dst,t->dst,t->cols);
+	pthread_mutex_unlock(&t->lock);
+	free(acc);
+}
+
+/* transposes the source rows that start inside [begin,end) */
+static void transpose_task (size_t begin, size_t end, void* arg) {
+	Transpose_Task_t* t = arg;
+	const size_t first = (begin + t->cols - 1) / t->cols;
+	const size_t last = (end + t->cols - 1) / t->cols;
+	if (first < last) {
+		kernel_transpose(&t->src[first * t->cols],t->cols,&t->dst[first],t->rows,
+			last - first,t->cols);
+	}
+}
+
+/* swaps the tile pairs (i,j), j >= i, numbered row by row over the upper
+ * triangle, whose TRANSPOSE_TILE^2 element slot starts inside [begin,end) */
+static void transpose_square_task (size_t begin, size_t end, void* arg) {
+	Transpose_Task_t* t = arg;
+	const size_t slot = TRANSPOSE_TILE * TRANSPOSE_TILE;
+	size_t pair = (begin + slot - 1) / slot;
+	if (pair * slot >= end) {
+		return;
+	}
+	size_t i = 0;
+	size_t row_start = 0;
+	while (row_start + (t->tiles - i) <= pair) {
+		row_start += t->tiles - i;
+		++i;
+	}
+	size_t j = i + (pair - row_start);
+	unsigned int* a = t->dst;
+	const size_t n = t->rows;
+	for (; pair * slot < end; ++pair) {
+		const size_t r0 = i * TRANSPOSE_TILE;
+		const size_t c0 = j * TRANSPOSE_TILE;
+		const size_t rows = (n - r0 < TRANSPOSE_TILE) ? n - r0 : TRANSPOSE_TILE;
+		const size_t cols = (n - c0 < TRANSPOSE_TILE) ? n - c0 : TRANSPOSE_TILE;
+		kernel_transpose_swap(&a[r0 * n + c0],&a[c0 * n + r0],n,rows,cols);
+		if (++j == t->tiles) {
+			++i;
+			j = i;
+		}
+	}
+}
+
+static void copy_task (size_t begin, size_t end, void* arg) {
+	Element_Task_t* t = arg;
+	memcpy(&t->c[begin],&t->a[begin],(end - begin) * sizeof(unsigned int));
+}
+
+static void compare_task (size_t begin, size_t end, void* arg) {
+	Element_Task_t* t = arg;
+	if (__atomic_load_n(&t->differ,__ATOMIC_RELAXED)) {
+		return;
+	}
+	if (memcmp(&t->a[begin],&t->b[begin],(end - begin) * sizeof(unsigned int)) != 0) {
+		__atomic_store_n(&t->differ,true,__ATOMIC_RELAXED);
+	}
+}
+
+static void encode_task (size_t begin, size_t end, void* arg) {
+	Block_Task_t* t = arg;
+	for (size_t b = (begin + COMPRESS_BLOCK_ELEMENTS - 1) / COMPRESS_BLOCK_ELEMENTS;
+		b * COMPRESS_BLOCK_ELEMENTS < end; ++b) {
+		const size_t first = b * COMPRESS_BLOCK_ELEMENTS;
+		const size_t count = (t->n - first < COMPRESS_BLOCK_ELEMENTS) ? t->n - first : COMPRESS_BLOCK_ELEMENTS;
+		t->lengths[b] = compress_block(&t->data[first],count,&t->out[b * t->out_stride]);
+	}
+}
+
+static void decode_task (size_t begin, size_t end, void* arg) {
+	Block_Task_t* t = arg;
+	for (size_t b = (begin + COMPRESS_BLOCK_ELEMENTS - 1) / COMPRESS_BLOCK_ELEMENTS;
+		b * COMPRESS_BLOCK_ELEMENTS < end; ++b) {
+		const size_t first = b * COMPRESS_BLOCK_ELEMENTS;
+		const size_t count = (t->n - first < COMPRESS_BLOCK_ELEMENTS) ? t->n - first : COMPRESS_BLOCK_ELEMENTS;
+		uint64_t range[2];
+		memcpy(range,&t->offsets[b * sizeof(uint64_t)],sizeof(range));
+		if (!decompress_block(&t->blocks[range[0]],range[1] - range[0],&t->data[first],count)) {
+			__atomic_store_n(&t->failed,true,__ATOMIC_RELAXED);
+		}
+	}
+}
+
+/* counter-based, so a chunk only needs its starting index to continue the fill */
+static void random_task (size_t begin, size_t end, void* arg) {
+	Element_Task_t* t = arg;
+	kernel_random(&t->a[begin],end - begin,begin,t->seed,t->start_range,t->end_range);
+}
 
 /* 
  * PURPOSE: instantiates a new matrix with the passed name, rows, cols 
  * INPUTS: 
  *	name the name of the matrix limited to 50 characters 
  *  rows the number of rows the matrix
- *  cols the number of cols the matrix
+ *  cols the number of cols the matrix, rows * cols bytes of data must fit size_t
  * RETURN:
  *  If no errors occurred during instantiation then true
  *  else false for an error in the process.
  *
  **/
 
-bool create_matrix (Matrix_t** new_matrix, const char* name, const unsigned int rows,
-						const unsigned int cols) {
+bool create_matrix (Matrix_t** new_matrix, const char* name, const size_t rows,
+						const size_t cols) {
 
 	// ERROR CHECK INCOMING PARAMETERS
 	// *new_matrix no limit, can be null or valid
 	if (strlen(name) > 50){
-		printf("the name of matrix is too long");
-		return false;
-	}
-	if (rows>4294967295){
-		printf("row is too long");
+		message_printf("the name of matrix is too long");
 		return false;
 	}
-	if (cols> 4294967295){
-		printf("col is too long");
+	if (cols != 0 && rows > SIZE_MAX / sizeof(unsigned int) / cols){
+		message_printf("matrix is too large");
 		return false;
 	}
 
-	*new_matrix = calloc(1,sizeof(Matrix_t));
+	*new_matrix = mempool_header_alloc();
 	if (!(*new_matrix)) {
 		return false;
 	}
-	(*new_matrix)->data = calloc(rows * cols,sizeof(unsigned int));
+	(*new_matrix)->data = mempool_data_alloc(rows * cols,true);
 	if (!(*new_matrix)->data) {
+		mempool_header_free(*new_matrix);
+		*new_matrix = NULL;
 		return false;
 	}
 	(*new_matrix)->rows = rows;
 	(*new_matrix)->cols = cols;
 	unsigned int len = strlen(name) + 1; 
 	if (len > MATRIX_NAME_LEN) {
+		mempool_data_free((*new_matrix)->data,rows * cols);
+		mempool_header_free(*new_matrix);
+		*new_matrix = NULL;
 		return false;
 	}
-	strncpy((*new_matrix)->name,name,len);
+	memcpy((*new_matrix)->name,name,len);
+	stats_record_alloc(rows * cols * sizeof(unsigned int));
 	return true;
 
 }
@@ -79,16 +366,255 @@ void destroy_matrix (Matrix_t** m) {
 
 	// ERROR CHECK INCOMING PARAMETERS
 	if ((*m) == NULL){
-		printf("no matrix to be realeased");
+		message_printf("no matrix to be realeased");
 		return;
 	}
-	free((*m)->data);
-	free(*m);
+	release_data(*m);
+	mempool_header_free(*m);
 	*m = NULL;
 }
 
+/* 
+ * PURPOSE: drops the reference of m to its data, the buffer (or file mapping)
+ *	is only freed by the last matrix sharing it
+ * INPUTS: 
+ *	m : matrix whose data is released, data is NULL afterwards
+ * RETURN:
+ *  nothing
+ **/
+static void release_data (Matrix_t* m) {
+	if (m->shared) {
+		if (__atomic_sub_fetch(m->shared,1,__ATOMIC_ACQ_REL) != 0) {
+			m->data = NULL;
+			m->mapping = NULL;
+			m->shm = NULL;
+			m->shared = NULL;
+			return;
+		}
+		free(m->shared);
+		m->shared = NULL;
+	}
+	stats_record_free(m->rows * m->cols * sizeof(unsigned int));
+	if (m->shm) {
+		release_segment(m->shm,m->mapping_len);
+	}
+	else if (m->mapping) {
+		munmap(m->mapping,m->mapping_len);
+	}
+	else {
+		mempool_data_free(m->data,m->rows * m->cols);
+	}
+	m->data = NULL;
+	m->mapping = NULL;
+	m->shm = NULL;
+}
+
+/* 
+ * PURPOSE: makes dest share the data of src until either is written; a
+ *	shared memory matrix is written in place by every process attached to
+ *	it, so it is never shared and dest gets a private copy at once
+ * INPUTS: 
+ *	src : matrix whose data is shared, gets a reference count on first use
+ *  dest : matrix without data and with the dimensions of src
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false when the reference count or copy could not be allocated.
+ **/
+static bool share_data (Matrix_t* src, Matrix_t* dest) {
+	if (src->shm) {
+		unsigned int* copy = mempool_data_alloc(src->rows * src->cols,false);
+		if (!copy) {
+			message_printf("no memory to copy the shared matrix");
+			return false;
+		}
+		stats_record_alloc(src->rows * src->cols * sizeof(unsigned int));
+		dest->generation = data_generation(src);
+		Element_Task_t task = { .a = src->data, .c = copy };
+		parallel_for(src->rows * src->cols,sizeof(unsigned int),copy_task,&task);
+		dest->data = copy;
+		dest->mapping = NULL;
+		dest->shm = NULL;
+		dest->shared = NULL;
+		pthread_mutex_lock(&summary_lock);
+		dest->summary = src->summary;
+		pthread_mutex_unlock(&summary_lock);
+		return true;
+	}
+	if (src->shared == NULL) {
+		src->shared = malloc(sizeof(size_t));
+		if (!src->shared) {
+			return false;
+		}
+		*src->shared = 1;
+	}
+	__atomic_add_fetch(src->shared,1,__ATOMIC_RELAXED);
+	dest->data = src->data;
+	dest->mapping = src->mapping;
+	dest->mapping_len = src->mapping_len;
+	dest->shm = src->shm;
+	dest->shared = src->shared;
+	/* same data, so the cached summary carries over */
+	dest->generation = src->generation;
+	pthread_mutex_lock(&summary_lock);
+	dest->summary = src->summary;
+	pthread_mutex_unlock(&summary_lock);
+	return true;
+}
+
+/* 
+ * PURPOSE: gives m a private copy of its data before it is modified, every
+ *	function writing a matrix calls this first
+ * INPUTS: 
+ *	m : matrix about to be written
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false when the copy could not be allocated, m is unchanged.
+ **/
+bool unshare_matrix (Matrix_t* m) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (m == NULL){
+		message_printf("no matrix to unshare");
+		return false;
+	}
+	if (m->shared == NULL) {
+		return true;
+	}
+	/* the other holders are gone, the buffer is ours again */
+	if (__atomic_load_n(m->shared,__ATOMIC_ACQUIRE) == 1) {
+		free(m->shared);
+		m->shared = NULL;
+		return true;
+	}
+	unsigned int* copy = mempool_data_alloc(m->rows * m->cols,false);
+	if (!copy) {
+		message_printf("no memory to copy the shared matrix");
+		return false;
+	}
+	stats_record_alloc(m->rows * m->cols * sizeof(unsigned int));
+	Element_Task_t task = { .a = m->data, .c = copy };
+	parallel_for(m->rows * m->cols,sizeof(unsigned int),copy_task,&task);
+	/* continue from the segment generation so the cached summary stays comparable */
+	m->generation = data_generation(m);
+	release_data(m);
+	m->data = copy;
+	return true;
+}
+
+/* 
+ * PURPOSE: creates a copy-on-write duplicate of src, O(1) in time and memory
+ *	unless src is in shared memory, which is copied right away
+ * INPUTS: 
+ *	new_matrix : receives the duplicate
+ *  name : name of the duplicate
+ *  src : matrix to duplicate
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ **/
+bool clone_matrix (Matrix_t** new_matrix, const char* name, Matrix_t* src) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (new_matrix == NULL || name == NULL){
+		message_printf("no place for the duplicate");
+		return false;
+	}
+	if (src == NULL){
+		message_printf("no old matrix");
+		return false;
+	}
+	if (strlen(name) + 1 > MATRIX_NAME_LEN) {
+		message_printf("the name of matrix is too long");
+		return false;
+	}
+
+	*new_matrix = mempool_header_alloc();
+	if (!(*new_matrix)) {
+		return false;
+	}
+	memcpy((*new_matrix)->name,name,strlen(name) + 1);
+	(*new_matrix)->rows = src->rows;
+	(*new_matrix)->cols = src->cols;
+	if (!share_data(src,*new_matrix)) {
+		mempool_header_free(*new_matrix);
+		*new_matrix = NULL;
+		return false;
+	}
+	return true;
+}
+
+
+/* generation the cached summary of m is checked against; other processes
+ * write shared memory matrices too, so theirs is kept in the segment */
+static uint64_t data_generation (Matrix_t* m) {
+	if (m->shm) {
+		return __atomic_load_n(&m->shm->generation,__ATOMIC_ACQUIRE);
+	}
+	return m->generation;
+}
+
+/* 
+ * PURPOSE: records that the data of m changed, which drops its cached summary;
+ *	every function writing a matrix calls this after the write
+ * INPUTS: 
+ *	m : the modified matrix
+ * RETURN:
+ *  nothing
+ **/
+void touch_matrix (Matrix_t* m) {
+	if (m != NULL) {
+		m->generation++;
+		if (m->shm) {
+			__atomic_add_fetch(&m->shm->generation,1,__ATOMIC_RELEASE);
+		}
+	}
+}
+
+/* copies the summary of m when it is current, false when it has to be computed */
+static bool cached_summary (Matrix_t* m, Matrix_Summary_t* summary) {
+	pthread_mutex_lock(&summary_lock);
+	*summary = m->summary;
+	pthread_mutex_unlock(&summary_lock);
+	return summary->valid && summary->generation == data_generation(m);
+}
+
+/* 
+ * PURPOSE: sum, min, max and content hash of a matrix, computed in one pass
+ *	on first use and then served from the cache until the matrix is written
+ * INPUTS: 
+ *	m : matrix to summarize, its cache is filled
+ *  summary : receives the values
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ **/
+bool summarize_matrix (Matrix_t* m, Matrix_Summary_t* summary) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (m == NULL){
+		message_printf("no matrix to summarize");
+		return false;
+	}
+	if (summary == NULL){
+		message_printf("no place to store the summary");
+		return false;
+	}
+
+	if (cached_summary(m,summary)) {
+		return true;
+	}
+	/* read first, a write by another process during the pass leaves the result stale */
+	const uint64_t generation = data_generation(m);
+	Element_Task_t task = { .a = m->data, .min = UINT_MAX, .max = 0 };
+	parallel_for(m->rows * m->cols,sizeof(unsigned int),summary_task,&task);
+	*summary = (Matrix_Summary_t) { .valid = true, .generation = generation,
+		.sum = task.sum, .hash = task.hash, .min = task.min, .max = task.max };
+	pthread_mutex_lock(&summary_lock);
+	m->summary = *summary;
+	pthread_mutex_unlock(&summary_lock);
+	return true;
+}
 
-	
 /* 
  * PURPOSE: decide if two matrix is equal; 
  * INPUTS: 
@@ -103,27 +629,40 @@ bool equal_matrices (Matrix_t* a, Matrix_t* b) {
 
 	// ERROR CHECK INCOMING PARAMETERS
 	if (a == NULL){
-		printf("no A matrix");
+		message_printf("no A matrix");
 		return false;
 	}
 	if (b == NULL){
-		printf("no B matrix");
+		message_printf("no B matrix");
 		return false;
 	}
 	
 	if (!a || !b || !a->data || !b->data) {
 		return false;	
 	}
-
-	int result = memcmp(a->data,b->data, sizeof(unsigned int) * a->rows * a->cols);
-	if (result == 0) {
+	if (a->rows != b->rows || a->cols != b->cols) {
+		return false;
+	}
+	/* a matrix and its unmodified duplicates share one buffer */
+	if (a->data == b->data) {
 		return true;
 	}
-	return false;
+	/* already summarized matrices differ when their summaries do */
+	Matrix_Summary_t sa, sb;
+	if (cached_summary(a,&sa) && cached_summary(b,&sb)
+		&& (sa.hash != sb.hash || sa.sum != sb.sum)) {
+		return false;
+	}
+
+	Element_Task_t task = { .a = a->data, .b = b->data };
+	parallel_for(a->rows * a->cols,sizeof(unsigned int),compare_task,&task);
+	return !task.differ;
 }
 
 /* 
- * PURPOSE: copy old matrix to new matrix; 
+ * PURPOSE: copy old matrix to new matrix, the data is shared copy-on-write
+ *	so this is O(1) and the buffer is only copied when either side is written;
+ *	a shared memory source is copied at once
  * INPUTS: 
  *	src : old matrix; 
  *  dest : new matrix
@@ -137,11 +676,11 @@ bool duplicate_matrix (Matrix_t* src, Matrix_t* dest) {
 
 	//ERROR CHECK INCOMING PARAMETERS
 	if (src == NULL){
-		printf("no old matrix");
+		message_printf("no old matrix");
 		return false;
 	}
 	if (dest == NULL){
-		printf("no new matrix");
+		message_printf("no new matrix");
 		return false;
 	}
 
@@ -151,9 +690,16 @@ bool duplicate_matrix (Matrix_t* src, Matrix_t* dest) {
 	/*
 	 * copy over data
 	 */
-	unsigned int bytesToCopy = sizeof(unsigned int) * src->rows * src->cols;
-	memcpy(src->data,dest->data, bytesToCopy);	
-	return equal_matrices (src,dest);
+	if (src->rows != dest->rows || src->cols != dest->cols) {
+		message_printf("new matrix has different dimensions");
+		return false;
+	}
+	if (src == dest || src->data == dest->data) {
+		return true;
+	}
+	/* dest drops its own buffer and shares src until one of them is written */
+	release_data(dest);
+	return share_data(src,dest);
 }
 
 /* 
@@ -171,41 +717,29 @@ bool bitwise_shift_matrix (Matrix_t* a, char direction, unsigned int shift) {
 	
 	//ERROR CHECK INCOMING PARAMETERS
 	if (a == NULL){
-		printf("no matrix in bitwise");
+		message_printf("no matrix in bitwise");
 		return false;
 	}
 
 	if (shift > 4294967295){
-		printf("too large shift");
+		message_printf("too large shift");
 		return false;
 	}
 	if (direction == ' '){
-		printf("empty character");
+		message_printf("empty character");
 		return false;
 	}
 	if (!a) {
 		return false;
 	}
 
-	if (direction == 'l') {
-		unsigned int i = 0;
-		for (; i < a->rows; ++i) {
-			unsigned int j = 0;
-			for (; j < a->cols; ++j) {
-				a->data[i * a->cols + j] = a->data[i * a->cols + j] << shift;
-			}
-		}
-
-	}
-	else {
-		unsigned int i = 0;
-		for (; i < a->rows; ++i) {
-			unsigned int j = 0;
-			for (; j < a->cols; ++j) {
-				a->data[i * a->cols + j] = a->data[i * a->cols + j] >> shift;
-			}
-		}
+	if (!unshare_matrix(a)) {
+		return false;
 	}
+
+	Element_Task_t task = { .a = a->data, .direction = direction, .shift = shift };
+	parallel_for(a->rows * a->cols,sizeof(unsigned int),shift_task,&task);
+	touch_matrix(a);
 	
 	return true;
 }
@@ -225,326 +759,1719 @@ bool add_matrices (Matrix_t* a, Matrix_t* b, Matrix_t* c) {
 
 	// ERROR CHECK INCOMING PARAMETERS
 	if (a == NULL){
-		printf("A matrix is missing");
+		message_printf("A matrix is missing");
 		return false;
 	}
 	if (b == NULL){
-		printf("B matrix is missing");
+		message_printf("B matrix is missing");
 		return false;
 	}
 	if (c == NULL){
-		printf("new matrix is missing");
+		message_printf("new matrix is missing");
 		return false;
 	}
 
-	if (a->rows != b->rows && a->cols != b->cols) {
+	if (a->rows != b->rows || a->cols != b->cols) {
+		return false;
+	}
+	if (c->rows != a->rows || c->cols != a->cols) {
 		return false;
 	}
 
-	for (int i = 0; i < a->rows; ++i) {
-		for (int j = 0; j < b->cols; ++j) {
-			c->data[i * a->cols +j] = a->data[i * a->cols + j] + b->data[i * a->cols + j];
-		}
+	if (!unshare_matrix(c)) {
+		return false;
 	}
+
+	Element_Task_t task = { .a = a->data, .b = b->data, .c = c->data };
+	parallel_for(a->rows * a->cols,sizeof(unsigned int),add_task,&task);
+	touch_matrix(c);
 	return true;
 }
 
 /* 
- * PURPOSE: display matrix  
+ * PURPOSE: sum every element of matrix 
  * INPUTS: 
- *	m : matrix need to be displayed
+ *	m : matrix need to be summed;
+ *  sum : where the 64 bit total is stored;
  * RETURN:
  *  If no errors occurred then true
  *  else false for an error in the process.
  *
  **/
-void display_matrix (Matrix_t* m) {
-	
+bool sum_matrix (Matrix_t* m, uint64_t* sum) {
+
 	// ERROR CHECK INCOMING PARAMETERS
 	if (m == NULL){
-		printf("no matrix input to display");
-		return;
+		message_printf("no matrix to sum");
+		return false;
 	}
-	printf("\nMatrix Contents (%s):\n", m->name);
-	printf("DIM = (%u,%u)\n", m->rows, m->cols);
-	for (int i = 0; i < m->rows; ++i) {
-		for (int j = 0; j < m->cols; ++j) {
-			printf("%u ", m->data[i * m->cols + j]);
-		}
-		printf("\n");
+	if (sum == NULL){
+		message_printf("no place to store the sum");
+		return false;
 	}
-	printf("\n");
 
+	Matrix_Summary_t summary;
+	if (!summarize_matrix(m,&summary)) {
+		return false;
+	}
+	*sum = summary.sum;
+	return true;
 }
 
 /* 
- * PURPOSE: read matrix from input file name; 
+ * PURPOSE: min, max, sum, mean and population variance of a matrix, plus an
+ *	optional histogram, in one threaded pass over its data
  * INPUTS: 
- *	matrix_input_filename : input file name need to be read;
- *  m : matrix need to be read;
+ *	m : matrix to describe;
+ *  stats : receives the values, bins, lo, hi and histogram are set by the
+ *	caller when a histogram of [lo,hi] is wanted;
  * RETURN:
  *  If no errors occurred then true
  *  else false for an error in the process.
  *
  **/
-bool read_matrix (const char* matrix_input_filename, Matrix_t** m) {
-	
+bool describe_matrix (Matrix_t* m, Matrix_Stats_t* stats) {
+
 	// ERROR CHECK INCOMING PARAMETERS
-	if (matrix_input_filename == NULL){
-		printf("no matrix input file");
+	if (m == NULL){
+		message_printf("no matrix to describe");
+		return false;
+	}
+	if (stats == NULL){
+		message_printf("no place to store the statistics");
 		return false;
 	}
-	if (*m == NULL){
-		printf("no matrix will input");
+	if (stats->bins > 0 && (stats->histogram == NULL || stats->bins > MATRIX_STATS_MAX_BINS
+		|| stats->lo > stats->hi)) {
+		message_printf("a histogram needs 1 to %d bins over a range lo <= hi\n", MATRIX_STATS_MAX_BINS);
 		return false;
 	}
 
+	stats->min = UINT_MAX;
+	stats->max = 0;
+	stats->sum = 0;
+	stats->below = 0;
+	stats->above = 0;
+	stats->bin_width = 0;
+	if (stats->bins > 0) {
+		/* equal bins of whole elements, the last one may be narrower */
+		const uint64_t range = (uint64_t) stats->hi - stats->lo + 1;
+		stats->bin_width = (range + stats->bins - 1) / stats->bins;
+		stats->bins = (range + stats->bin_width - 1) / stats->bin_width;
+		memset(stats->histogram,0,stats->bins * sizeof(uint64_t));
+	}
 
-	int fd = open(matrix_input_filename,O_RDONLY);
-	if (fd < 0) {
-		printf("FAILED TO OPEN FOR READING\n");
-		if (errno == EACCES ) {
-			perror("DO NOT HAVE ACCESS TO FILE\n");
-		}
-		else if (errno == EADDRINUSE ){
-			perror("FILE ALREADY IN USE\n");
-		}
-		else if (errno == EBADF) {
-			perror("BAD FILE DESCRIPTOR\n");	
-		}
-		else if (errno == EEXIST) {
-			perror("FILE EXIST\n");
-		}
+	const size_t n = m->rows * m->cols;
+	Stats_Task_t task = { .a = m->data, .stats = stats };
+	pthread_mutex_init(&task.lock,NULL);
+	parallel_for(n,sizeof(unsigned int),stats_task,&task);
+	pthread_mutex_destroy(&task.lock);
+	if (task.failed) {
+		message_printf("no memory for the histogram");
 		return false;
 	}
+	if (n == 0) {
+		stats->min = 0;
+		stats->mean = 0;
+		stats->variance = 0;
+		return true;
+	}
+	/* exact in integers: with q = sum / n and r = sum % n,
+	 * sum (x - mean)^2 = sum (x - q)^2 - r^2 / n, and
+	 * sum (x - q)^2 = sumsq - 2 q sum + n q^2 fits 128 bits */
+	const uint64_t q = stats->sum / n;
+	const uint64_t r = stats->sum % n;
+	const unsigned __int128 deviation = task.sumsq - 2 * (unsigned __int128) q * stats->sum
+		+ (unsigned __int128) n * q * q;
+	stats->mean = (double) ((long double) stats->sum / n);
+	stats->variance = (double) (((long double) deviation - (long double) r * r / n) / n);
+	return true;
+}
 
-	/*read the wrote dimensions and name length*/
-	unsigned int name_len = 0;
-	unsigned int rows = 0;
-	unsigned int cols = 0;
-	
-	if (read(fd,&name_len,sizeof(unsigned int)) != sizeof(unsigned int)) {
-		printf("FAILED TO READING FILE\n");
-		if (errno == EACCES ) {
-			perror("DO NOT HAVE ACCESS TO FILE\n");
-		}
-		else if (errno == EADDRINUSE ){
-			perror("FILE ALREADY IN USE\n");
-		}
-		else if (errno == EBADF) {
-			perror("BAD FILE DESCRIPTOR\n");	
-		}
-		else if (errno == EEXIST) {
-			perror("FILE EXIST\n");
-		}
+/* 
+ * PURPOSE: sums every row of a matrix into a column, wrapping like add
+ * INPUTS: 
+ *	m : rows x cols matrix;
+ *  result : rows x 1 matrix, must not be m;
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+bool rowsum_matrix (Matrix_t* m, Matrix_t* result) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (m == NULL || result == NULL){
+		message_printf("no matrix or no result matrix");
 		return false;
 	}
-	char name_buffer[50];
-	if (read (fd,name_buffer,sizeof(char) * name_len) != sizeof(char) * name_len) {
-		printf("FAILED TO READ MATRIX NAME\n");
-		if (errno == EACCES ) {
-			perror("DO NOT HAVE ACCESS TO FILE\n");
-		}
-		else if (errno == EADDRINUSE ){
-			perror("FILE ALREADY IN USE\n");
-		}
-		else if (errno == EBADF) {
-			perror("BAD FILE DESCRIPTOR\n");	
-		}
-		else if (errno == EEXIST) {
-			perror("FILE EXIST\n");
-		}
-
-		return false;	
+	if (result->rows != m->rows || result->cols != 1 || result == m) {
+		message_printf("row sums need a separate %zu x 1 matrix\n", m->rows);
+		return false;
 	}
 
-	if (read (fd,&rows, sizeof(unsigned int)) != sizeof(unsigned int)) {
-		printf("FAILED TO READ MATRIX ROW SIZE\n");
-		if (errno == EACCES ) {
-			perror("DO NOT HAVE ACCESS TO FILE\n");
-		}
-		else if (errno == EADDRINUSE ){
-			perror("FILE ALREADY IN USE\n");
-		}
-		else if (errno == EBADF) {
-			perror("BAD FILE DESCRIPTOR\n");	
+	if (!unshare_matrix(result)) {
+		return false;
+	}
+	if (m->cols == 0) {
+		memset(result->data,0,m->rows * sizeof(unsigned int));
+	}
+	else {
+		Reduce_Task_t task = { .src = m->data, .dst = result->data, .cols = m->cols };
+		parallel_for(m->rows * m->cols,sizeof(unsigned int),rowsum_task,&task);
+	}
+	touch_matrix(result);
+	return true;
+}
+
+/* 
+ * PURPOSE: sums every column of a matrix into a row, wrapping like add; the
+ *	rows are streamed in memory order instead of striding down columns
+ * INPUTS: 
+ *	m : rows x cols matrix;
+ *  result : 1 x cols matrix, must not be m;
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+bool colsum_matrix (Matrix_t* m, Matrix_t* result) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (m == NULL || result == NULL){
+		message_printf("no matrix or no result matrix");
+		return false;
+	}
+	if (result->rows != 1 || result->cols != m->cols || result == m) {
+		message_printf("column sums need a separate 1 x %zu matrix\n", m->cols);
+		return false;
+	}
+
+	if (!unshare_matrix(result)) {
+		return false;
+	}
+	memset(result->data,0,m->cols * sizeof(unsigned int));
+	if (m->cols > 0) {
+		Reduce_Task_t task = { .src = m->data, .dst = result->data, .cols = m->cols };
+		pthread_mutex_init(&task.lock,NULL);
+		parallel_for(m->rows * m->cols,sizeof(unsigned int),colsum_task,&task);
+		pthread_mutex_destroy(&task.lock);
+		if (task.failed) {
+			message_printf("no memory for the column sums");
+			touch_matrix(result);
+			return false;
 		}
-		else if (errno == EEXIST) {
-			perror("FILE EXIST\n");
+	}
+	touch_matrix(result);
+	return true;
+}
+
+/* 
+ * PURPOSE: multiply two matrix into one new matrix (c = a * b)
+ * INPUTS: 
+ *	a : A matrix with rows x k;
+ *  b : B matrix with k x cols;
+ *  c : new matrix with rows x cols, must not be a or b;
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+bool multiply_matrices (Matrix_t* a, Matrix_t* b, Matrix_t* c) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (a == NULL){
+		message_printf("A matrix is missing");
+		return false;
+	}
+	if (b == NULL){
+		message_printf("B matrix is missing");
+		return false;
+	}
+	if (c == NULL){
+		message_printf("new matrix is missing");
+		return false;
+	}
+	if (c == a || c == b){
+		message_printf("new matrix can not be one of the inputs");
+		return false;
+	}
+	if (a->cols != b->rows) {
+		message_printf("inner dimensions do not match");
+		return false;
+	}
+	if (c->rows != a->rows || c->cols != b->cols) {
+		message_printf("new matrix has the wrong dimensions");
+		return false;
+	}
+
+	if (!unshare_matrix(c)) {
+		return false;
+	}
+	const bool ok = kernel_multiply(a->data,b->data,c->data,a->rows,b->cols,a->cols);
+	touch_matrix(c);
+	return ok;
+}
+
+/* 
+ * PURPOSE: transposes src into dst, cache-oblivious and threaded; a square
+ *	matrix passed as both src and dst is transposed in place
+ * INPUTS: 
+ *	src : rows x cols matrix;
+ *  dst : cols x rows matrix, src itself only when src is square;
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+bool transpose_matrix (Matrix_t* src, Matrix_t* dst) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (src == NULL){
+		message_printf("no matrix to transpose");
+		return false;
+	}
+	if (dst == NULL){
+		message_printf("no matrix for the transpose");
+		return false;
+	}
+	if (dst->rows != src->cols || dst->cols != src->rows) {
+		message_printf("transpose matrix has the wrong dimensions");
+		return false;
+	}
+
+	/* a copy-on-write duplicate of src gets its own buffer here like any
+	 * written matrix, so only src == dst transposes over its own data */
+	if (!unshare_matrix(dst)) {
+		return false;
+	}
+	if (src == dst) {
+		const size_t tiles = (src->rows + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE;
+		Transpose_Task_t task = { .dst = dst->data, .rows = src->rows, .cols = src->cols,
+			.tiles = tiles };
+		parallel_for(tiles * (tiles + 1) / 2 * TRANSPOSE_TILE * TRANSPOSE_TILE,
+			sizeof(unsigned int),transpose_square_task,&task);
+	}
+	else {
+		Transpose_Task_t task = { .src = src->data, .dst = dst->data, .rows = src->rows,
+			.cols = src->cols };
+		parallel_for(src->rows * src->cols,sizeof(unsigned int),transpose_task,&task);
+	}
+	touch_matrix(dst);
+	return true;
+}
+
+/* 
+ * PURPOSE: gives m new dimensions over the same row-major data, no element
+ *	is moved or copied
+ * INPUTS: 
+ *	m : matrix to reshape;
+ *  rows, cols : new dimensions, rows * cols must not change;
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+bool reshape_matrix (Matrix_t* m, size_t rows, size_t cols) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (m == NULL){
+		message_printf("no matrix to reshape");
+		return false;
+	}
+	if ((cols != 0 && rows > SIZE_MAX / cols) || rows * cols != m->rows * m->cols) {
+		message_printf("reshape must keep the %zu elements of the matrix\n", m->rows * m->cols);
+		return false;
+	}
+	m->rows = rows;
+	m->cols = cols;
+	/* processes attaching later see the new shape */
+	if (m->shm) {
+		__atomic_store_n(&m->shm->rows,rows,__ATOMIC_RELAXED);
+		__atomic_store_n(&m->shm->cols,cols,__ATOMIC_RELAXED);
+	}
+	return true;
+}
+
+/* 
+ * PURPOSE: display matrix  
+ * INPUTS: 
+ *	out : stream the matrix is printed to
+ *	m : matrix need to be displayed
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+void display_matrix (FILE* out, Matrix_t* m) {
+	
+	// ERROR CHECK INCOMING PARAMETERS
+	if (m == NULL){
+		message_printf("no matrix input to display");
+		return;
+	}
+	display_matrix_window(out,m,0,0,m->rows,m->cols);
+}
+
+/* 
+ * PURPOSE: display the rows x cols window of a matrix at (r0,c0), clipped to
+ *	the matrix; the text is formatted into a buffer and written in large pieces
+ * INPUTS: 
+ *	out : stream the window is printed to
+ *	m : matrix need to be displayed
+ *  r0, c0 : top left element of the window
+ *  rows, cols : size of the window
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false when the window starts outside the matrix.
+ *
+ **/
+bool display_matrix_window (FILE* out, Matrix_t* m, size_t r0, size_t c0, size_t rows, size_t cols) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (m == NULL){
+		message_printf("no matrix input to display");
+		return false;
+	}
+	if ((r0 >= m->rows && r0 > 0) || (c0 >= m->cols && c0 > 0)) {
+		message_printf("window at (%zu,%zu) is outside Matrix (%s)\n", r0, c0, m->name);
+		return false;
+	}
+	rows = rows < m->rows - r0 ? rows : m->rows - r0;
+	cols = cols < m->cols - c0 ? cols : m->cols - c0;
+
+	fprintf(out,"\nMatrix Contents (%s):\n", m->name);
+	fprintf(out,"DIM = (%zu,%zu)\n", m->rows, m->cols);
+	if (rows != m->rows || cols != m->cols) {
+		fprintf(out,"WINDOW = (%zu,%zu) SIZE = (%zu,%zu)\n", r0, c0, rows, cols);
+	}
+	char text[DISPLAY_CHUNK * TEXT_U32_MAX_CHARS + 1];
+	size_t len = 0;
+	for (size_t i = r0; i < r0 + rows; ++i) {
+		const unsigned int* row = &m->data[i * m->cols + c0];
+		for (size_t j = 0; j < cols; j += DISPLAY_CHUNK) {
+			const size_t n = cols - j < DISPLAY_CHUNK ? cols - j : DISPLAY_CHUNK;
+			if (len + n * TEXT_U32_MAX_CHARS + 1 > sizeof(text)) {
+				fwrite(text,1,len,out);
+				len = 0;
+			}
+			len += text_format_u32s(&row[j],n,' ',&text[len]);
+		}
+		if (len + 1 > sizeof(text)) {
+			fwrite(text,1,len,out);
+			len = 0;
+		}
+		text[len++] = '\n';
+	}
+	fwrite(text,1,len,out);
+	fprintf(out,"\n");
+	return true;
+}
+
+/* 
+ * PURPOSE: prints the reason of a failed open or read, as every file
+ *	function here reports it
+ * INPUTS: 
+ *	what : message printed first;
+ * RETURN:
+ *  nothing
+ *
+ **/
+static void report_io_error (const char* what) {
+	message_printf("%s", what);
+	if (errno == EACCES ) {
+		message_perror("DO NOT HAVE ACCESS TO FILE\n");
+	}
+	else if (errno == EADDRINUSE ){
+		message_perror("FILE ALREADY IN USE\n");
+	}
+	else if (errno == EBADF) {
+		message_perror("BAD FILE DESCRIPTOR\n");	
+	}
+	else if (errno == EEXIST) {
+		message_perror("FILE EXIST\n");
+	}
+}
+
+/* 
+ * PURPOSE: read up to len bytes in READ_CHUNK_BYTES pieces, retrying short
+ *	reads and EINTR until len bytes arrived or the file ended
+ * INPUTS: 
+ *	fd : file to read from;
+ *  buf : destination;
+ *  len : bytes wanted;
+ *  got : bytes actually read, less than len only at end of file;
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false with errno set by read.
+ *
+ **/
+static bool read_fully (int fd, void* buf, size_t len, size_t* got) {
+	unsigned char* dst = buf;
+	*got = 0;
+	while (*got < len) {
+		const size_t want = (len - *got < READ_CHUNK_BYTES) ? len - *got : READ_CHUNK_BYTES;
+		const ssize_t n = read(fd,&dst[*got],want);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		if (n == 0) {
+			break;
+		}
+		*got += n;
+	}
+	return true;
+}
+
+/* 
+ * PURPOSE: decode the header at the start of a matrix file, either the
+ *	versioned Matrix_File_Header_t or the original u32 layout
+ * INPUTS: 
+ *	buf : first bytes of the file;
+ *  len : number of bytes in buf;
+ *  name : receives the matrix name;
+ *  rows, cols : receive the dimensions;
+ *  data_offset : receives the file offset of the first element or block;
+ *  flags : receives the MATRIX_FILE_* flags, 0 for the original layout;
+ * RETURN:
+ *  If the header is valid then true
+ *  else false after printing why.
+ *
+ **/
+static bool parse_matrix_header (const unsigned char* buf, size_t len, char name[MATRIX_NAME_LEN],
+			size_t* rows, size_t* cols, size_t* data_offset, uint32_t* flags) {
+	uint64_t file_rows = 0;
+	uint64_t file_cols = 0;
+	*flags = 0;
+	if (len >= sizeof(Matrix_File_Header_t) && memcmp(buf,MATRIX_FILE_MAGIC,4) == 0) {
+		Matrix_File_Header_t header;
+		memcpy(&header,buf,sizeof(header));
+		if (header.version != MATRIX_FILE_VERSION
+			|| (header.flags & ~(MATRIX_FILE_COMPRESSED | MATRIX_FILE_TILED))
+			|| header.flags == (MATRIX_FILE_COMPRESSED | MATRIX_FILE_TILED)) {
+			message_printf("UNSUPPORTED MATRIX FILE VERSION %u\n", header.version);
+			return false;
+		}
+		if (header.header_len < sizeof(header)
+			|| strnlen(header.name,sizeof(header.name)) >= MATRIX_NAME_LEN) {
+			message_printf("FAILED TO READ MATRIX HEADER\n");
+			return false;
+		}
+		memcpy(name,header.name,MATRIX_NAME_LEN);
+		file_rows = header.rows;
+		file_cols = header.cols;
+		*data_offset = header.header_len;
+		*flags = header.flags;
+	}
+	else {
+		uint32_t name_len = 0;
+		uint32_t rows32 = 0;
+		uint32_t cols32 = 0;
+		if (len < sizeof(uint32_t) * 3) {
+			message_printf("FILE TOO SMALL TO BE A MATRIX\n");
+			return false;
+		}
+		memcpy(&name_len,buf,sizeof(uint32_t));
+		size_t offset = sizeof(uint32_t);
+		if (name_len == 0 || name_len > len - sizeof(uint32_t) * 3
+			|| strnlen((const char*) &buf[offset],name_len) >= MATRIX_NAME_LEN) {
+			message_printf("FAILED TO READ MATRIX NAME\n");
+			return false;
+		}
+		memset(name,0,MATRIX_NAME_LEN);
+		memcpy(name,&buf[offset],strnlen((const char*) &buf[offset],name_len));
+		offset += name_len;
+		memcpy(&rows32,&buf[offset],sizeof(uint32_t));
+		offset += sizeof(uint32_t);
+		memcpy(&cols32,&buf[offset],sizeof(uint32_t));
+		offset += sizeof(uint32_t);
+		file_rows = rows32;
+		file_cols = cols32;
+		*data_offset = offset;
+	}
+	if (file_rows > SIZE_MAX || file_cols > SIZE_MAX
+		|| (file_cols != 0 && file_rows > SIZE_MAX / sizeof(unsigned int) / file_cols)) {
+		message_printf("MATRIX IN FILE IS TOO LARGE\n");
+		return false;
+	}
+	*rows = file_rows;
+	*cols = file_cols;
+	return true;
+}
+
+/* 
+ * PURPOSE: read exactly len bytes at offset without moving the file offset,
+ *	in READ_CHUNK_BYTES pieces, retrying short reads and EINTR
+ * INPUTS: 
+ *	fd : file to read from;
+ *  buf : destination;
+ *  len : bytes wanted;
+ *  offset : file offset of the first byte;
+ * RETURN:
+ *  If all len bytes were read then true
+ *  else false, errno is EIO when the file ended early.
+ *
+ **/
+static bool pread_fully (int fd, void* buf, size_t len, uint64_t offset) {
+	unsigned char* dst = buf;
+	size_t got = 0;
+	while (got < len) {
+		const size_t want = (len - got < READ_CHUNK_BYTES) ? len - got : READ_CHUNK_BYTES;
+		const ssize_t n = pread(fd,&dst[got],want,offset + got);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		if (n == 0) {
+			errno = EIO;
+			return false;
+		}
+		got += n;
+	}
+	return true;
+}
+
+/* 
+ * PURPOSE: copy a region of a raw row-major file into out, a whole band of
+ *	rows is one read, otherwise one read per row of the region
+ * INPUTS: 
+ *	fd : open matrix file;
+ *  data_offset : file offset of element (0,0);
+ *  file_cols : columns of the matrix in the file;
+ *  r0, c0, rows, cols : the region, already checked against the dimensions;
+ *  out : rows x cols destination;
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+static bool read_region_raw (int fd, uint64_t data_offset, size_t file_cols, size_t r0, size_t c0,
+			size_t rows, size_t cols, unsigned int* out) {
+	if (cols == file_cols) {
+		return pread_fully(fd,out,rows * cols * sizeof(unsigned int),
+			data_offset + (uint64_t) r0 * file_cols * sizeof(unsigned int));
+	}
+	for (size_t i = 0; i < rows; ++i) {
+		const uint64_t offset = data_offset + ((uint64_t) (r0 + i) * file_cols + c0) * sizeof(unsigned int);
+		if (!pread_fully(fd,&out[i * cols],cols * sizeof(unsigned int),offset)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* 
+ * PURPOSE: copy a region of a tiled file into out, only the tiles that
+ *	overlap it are touched and from each only the rows inside the region
+ * INPUTS: 
+ *	fd : open matrix file;
+ *  file_len : its size, every tile offset is checked against it;
+ *  data_offset : header_len from the header;
+ *  file_rows, file_cols : dimensions of the matrix in the file;
+ *  r0, c0, rows, cols : the region, already checked against the dimensions;
+ *  out : rows x cols destination;
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+static bool read_region_tiled (int fd, uint64_t file_len, uint64_t data_offset, size_t file_rows,
+			size_t file_cols, size_t r0, size_t c0, size_t rows, size_t cols, unsigned int* out) {
+	Matrix_Tile_Table_t table;
+	const uint64_t table_offset = sizeof(Matrix_File_Header_t);
+	if (!pread_fully(fd,&table,sizeof(table),table_offset) || table.tile_rows == 0 || table.tile_cols == 0) {
+		message_printf("FAILED TO READ TILE TABLE\n");
+		return false;
+	}
+	/* a tile never exceeds the matrix; files of matrices smaller than one
+	 * WRITE_TILE_DIM tile were once written with the full tile size, which
+	 * still holds them in one tile */
+	if ((table.tile_rows > file_rows && table.tile_rows > WRITE_TILE_DIM)
+		|| (table.tile_cols > file_cols && table.tile_cols > WRITE_TILE_DIM)) {
+		message_printf("TILES LARGER THAN THE %zux%zu MATRIX\n", file_rows, file_cols);
+		return false;
+	}
+	const size_t tile_height = table.tile_rows < file_rows ? table.tile_rows : file_rows;
+	const size_t tile_width = table.tile_cols < file_cols ? table.tile_cols : file_cols;
+	if (tile_width != 0 && tile_height > SIZE_MAX / sizeof(unsigned int) / tile_width) {
+		message_printf("FAILED TO READ TILE TABLE\n");
+		return false;
+	}
+	const size_t tiles_down = (file_rows + table.tile_rows - 1) / table.tile_rows;
+	const size_t tiles_across = (file_cols + table.tile_cols - 1) / table.tile_cols;
+	if (table.num_tiles != (uint64_t) tiles_down * tiles_across
+		|| data_offset != table_offset + sizeof(table) + table.num_tiles * sizeof(uint64_t)
+		|| data_offset > file_len) {
+		message_printf("FAILED TO READ TILE TABLE\n");
+		return false;
+	}
+	if (rows == 0 || cols == 0) {
+		return true;
+	}
+
+	const size_t first_tc = c0 / table.tile_cols;
+	const size_t last_tc = (c0 + cols - 1) / table.tile_cols;
+	uint64_t* offsets = malloc((last_tc - first_tc + 1) * sizeof(uint64_t));
+	unsigned int* tile = malloc(tile_height * tile_width * sizeof(unsigned int));
+	bool ok = offsets && tile;
+	for (size_t tr = r0 / table.tile_rows; ok && tr <= (r0 + rows - 1) / table.tile_rows; ++tr) {
+		/* one read of the index entries this band of tiles needs */
+		ok = pread_fully(fd,offsets,(last_tc - first_tc + 1) * sizeof(uint64_t),
+			table_offset + sizeof(table) + ((uint64_t) tr * tiles_across + first_tc) * sizeof(uint64_t));
+		const size_t tile_top = tr * table.tile_rows;
+		const size_t height = (file_rows - tile_top < table.tile_rows) ? file_rows - tile_top : table.tile_rows;
+		const size_t first_row = (r0 > tile_top ? r0 : tile_top) - tile_top;
+		const size_t end_row = ((r0 + rows < tile_top + height) ? r0 + rows : tile_top + height) - tile_top;
+		for (size_t tc = first_tc; ok && tc <= last_tc; ++tc) {
+			const size_t tile_left = tc * table.tile_cols;
+			const size_t width = (file_cols - tile_left < table.tile_cols) ? file_cols - tile_left : table.tile_cols;
+			const size_t first_col = (c0 > tile_left ? c0 : tile_left) - tile_left;
+			const size_t end_col = ((c0 + cols < tile_left + width) ? c0 + cols : tile_left + width) - tile_left;
+			const uint64_t offset = offsets[tc - first_tc];
+			const uint64_t tile_bytes = (uint64_t) height * width * sizeof(unsigned int);
+			if (offset > file_len - data_offset || file_len - data_offset - offset < tile_bytes) {
+				message_printf("TILE OUTSIDE OF FILE\n");
+				ok = false;
+				break;
+			}
+			/* the rows of this tile inside the region, at the full tile width */
+			ok = pread_fully(fd,tile,(end_row - first_row) * width * sizeof(unsigned int),
+				data_offset + offset + (uint64_t) first_row * width * sizeof(unsigned int));
+			for (size_t i = first_row; ok && i < end_row; ++i) {
+				memcpy(&out[(tile_top + i - r0) * cols + tile_left + first_col - c0],
+					&tile[(i - first_row) * width + first_col],
+					(end_col - first_col) * sizeof(unsigned int));
+			}
+		}
+	}
+	free(offsets);
+	free(tile);
+	return ok;
+}
+
+/* 
+ * PURPOSE: region read of an already opened and parsed matrix file
+ * INPUTS: 
+ *	fd : open matrix file, left open;
+ *  file_len : its size;
+ *  data_offset, flags : from the header;
+ *  file_rows, file_cols : dimensions of the matrix in the file;
+ *  r0, c0, rows, cols : the region;
+ *  name : name of the new matrix;
+ *  m : where the new matrix is stored;
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+static bool read_region_fd (int fd, uint64_t file_len, uint64_t data_offset, uint32_t flags,
+			size_t file_rows, size_t file_cols, size_t r0, size_t c0, size_t rows, size_t cols,
+			const char* name, Matrix_t** m) {
+	if (r0 > file_rows || rows > file_rows - r0 || c0 > file_cols || cols > file_cols - c0) {
+		message_printf("REGION OUTSIDE OF THE %zux%zu MATRIX\n", file_rows, file_cols);
+		return false;
+	}
+	if (flags & MATRIX_FILE_COMPRESSED) {
+		message_printf("REGION READS NEED A RAW OR TILED FILE\n");
+		return false;
+	}
+	if (!(flags & MATRIX_FILE_TILED) && (data_offset > file_len
+		|| file_len - data_offset < (uint64_t) file_rows * file_cols * sizeof(unsigned int))) {
+		message_printf("FAILED TO READ MATRIX DATA\n");
+		return false;
+	}
+	if (!create_matrix(m,name,rows,cols)) {
+		return false;
+	}
+	const bool ok = (flags & MATRIX_FILE_TILED)
+		? read_region_tiled(fd,file_len,data_offset,file_rows,file_cols,r0,c0,rows,cols,(*m)->data)
+		: read_region_raw(fd,data_offset,file_cols,r0,c0,rows,cols,(*m)->data);
+	if (!ok) {
+		report_io_error("FAILED TO READ MATRIX REGION\n");
+		destroy_matrix(m);
+		return false;
+	}
+	return true;
+}
+
+/* 
+ * PURPOSE: decode a compressed matrix file held in memory, blocks are decoded
+ *	in parallel straight into the new matrix
+ * INPUTS: 
+ *	base : the whole file;
+ *  file_len : its length;
+ *  data_offset : header_len from the header, where the blocks start;
+ *  name, rows, cols : from the header;
+ *  m : where the new matrix is stored;
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for a truncated or corrupt file.
+ *
+ **/
+static bool decode_compressed (const unsigned char* base, size_t file_len, size_t data_offset,
+			const char* name, size_t rows, size_t cols, Matrix_t** m) {
+	const size_t n = rows * cols;
+	const size_t num_blocks = (n + COMPRESS_BLOCK_ELEMENTS - 1) / COMPRESS_BLOCK_ELEMENTS;
+	const size_t table_offset = sizeof(Matrix_File_Header_t);
+	Matrix_Block_Table_t table;
+	if (file_len < table_offset + sizeof(table)) {
+		message_printf("FAILED TO READ BLOCK TABLE\n");
+		return false;
+	}
+	memcpy(&table,&base[table_offset],sizeof(table));
+	const size_t offsets_len = (num_blocks + 1) * sizeof(uint64_t);
+	if (table.num_blocks != num_blocks || table.block_elements != COMPRESS_BLOCK_ELEMENTS
+		|| data_offset != table_offset + sizeof(table) + offsets_len || data_offset > file_len) {
+		message_printf("FAILED TO READ BLOCK TABLE\n");
+		return false;
+	}
+	/* offsets must be ordered and inside the file so no block can read past it */
+	const unsigned char* offsets = &base[table_offset + sizeof(table)];
+	uint64_t previous = 0;
+	for (size_t b = 0; b <= num_blocks; ++b) {
+		uint64_t offset;
+		memcpy(&offset,&offsets[b * sizeof(uint64_t)],sizeof(offset));
+		if (offset < previous || offset > file_len - data_offset) {
+			message_printf("FAILED TO READ BLOCK TABLE\n");
+			return false;
 		}
+		previous = offset;
+	}
+
+	if (!create_matrix(m,name,rows,cols)) {
+		return false;
+	}
+	Block_Task_t task = { .data = (*m)->data, .n = n, .blocks = &base[data_offset],
+		.offsets = offsets };
+	parallel_for(n,sizeof(unsigned int),decode_task,&task);
+	if (task.failed) {
+		message_printf("FAILED TO DECOMPRESS MATRIX DATA\n");
+		destroy_matrix(m);
+		return false;
+	}
+	return true;
+}
+
+/* 
+ * PURPOSE: fill in a version 2 file header, header_len covers just the header
+ * INPUTS: 
+ *	header : header to fill;
+ *  name : matrix name, cut to MATRIX_NAME_LEN - 1 characters;
+ *  rows, cols : dimensions;
+ *  flags : MATRIX_FILE_* flags;
+ * RETURN:
+ *  nothing
+ *
+ **/
+void init_matrix_file_header (Matrix_File_Header_t* header, const char* name, size_t rows,
+			size_t cols, uint32_t flags) {
+	memset(header,0,sizeof(*header));
+	memcpy(header->magic,MATRIX_FILE_MAGIC,4); // IMPORTANT C FUNCTION TO KNOW
+	header->version = MATRIX_FILE_VERSION;
+	header->header_len = sizeof(*header);
+	header->flags = flags;
+	header->rows = rows;
+	header->cols = cols;
+	memcpy(header->name,name,strnlen(name,MATRIX_NAME_LEN - 1));
+}
+
+/* 
+ * PURPOSE: read and decode the header at the start of an open matrix file
+ * INPUTS: 
+ *	fd : file opened for reading, read from offset 0;
+ *  name : receives the matrix name;
+ *  rows, cols : receive the dimensions;
+ *  data_offset : receives the file offset of the data;
+ *  flags : receives the MATRIX_FILE_* flags;
+ * RETURN:
+ *  If the header is valid then true
+ *  else false after printing why.
+ *
+ **/
+bool read_matrix_file_header (int fd, char name[MATRIX_NAME_LEN], size_t* rows, size_t* cols,
+			size_t* data_offset, uint32_t* flags) {
+	unsigned char header[sizeof(Matrix_File_Header_t)];
+	ssize_t got;
+	do {
+		got = pread(fd,header,sizeof(header),0);
+	} while (got < 0 && errno == EINTR);
+	if (got < 0) {
+		report_io_error("FAILED TO READING FILE\n");
+		return false;
+	}
+	return parse_matrix_header(header,got,name,rows,cols,data_offset,flags);
+}
+
+/* 
+ * PURPOSE: read matrix from input file name; 
+ * INPUTS: 
+ *	matrix_input_filename : input file name need to be read;
+ *  m : matrix need to be read;
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+bool read_matrix (const char* matrix_input_filename, Matrix_t** m) {
+	
+	// ERROR CHECK INCOMING PARAMETERS
+	if (matrix_input_filename == NULL){
+		message_printf("no matrix input file");
+		return false;
+	}
+	if (m == NULL){
+		message_printf("no matrix will input");
+		return false;
+	}
+
+
+	int fd = open(matrix_input_filename,O_RDONLY);
+	if (fd < 0) {
+		report_io_error("FAILED TO OPEN FOR READING\n");
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd,&st) < 0) {
+		message_perror("FAILED TO STAT FILE\n");
+		close(fd);
+		return false;
+	}
+
+	/*read the wrote dimensions and name, both layouts fit in one header's worth*/
+	unsigned char header[sizeof(Matrix_File_Header_t)];
+	size_t got = 0;
+	if (!read_fully(fd,header,sizeof(header),&got)) {
+		report_io_error("FAILED TO READING FILE\n");
+		close(fd);
+		return false;
+	}
+	char name[MATRIX_NAME_LEN];
+	size_t rows = 0;
+	size_t cols = 0;
+	size_t data_offset = 0;
+	uint32_t flags = 0;
+	if (!parse_matrix_header(header,got,name,&rows,&cols,&data_offset,&flags)) {
+		close(fd);
+		return false;
+	}
+	if (flags & MATRIX_FILE_TILED) {
+		const bool ok = read_region_fd(fd,st.st_size,data_offset,flags,rows,cols,0,0,rows,cols,name,m);
+		if (close(fd) && ok) {
+			destroy_matrix(m);
+			return false;
+		}
+		return ok;
+	}
+	if (flags & MATRIX_FILE_COMPRESSED) {
+		/* decode from a read only mapping, the blocks are only touched once */
+		const size_t file_len = st.st_size;
+		unsigned char* base = mmap(NULL,file_len,PROT_READ,MAP_PRIVATE,fd,0);
+		close(fd);
+		if (base == MAP_FAILED) {
+			message_perror("FAILED TO MAP FILE\n");
+			return false;
+		}
+		madvise(base,file_len,MADV_SEQUENTIAL);
+		const bool ok = decode_compressed(base,file_len,data_offset,name,rows,cols,m);
+		munmap(base,file_len);
+		return ok;
+	}
+
+	/* check the size before allocating so a corrupt header can not ask for terabytes */
+	const size_t numberOfDataBytes = rows * cols * sizeof(unsigned int);
+	if ((size_t) st.st_size < data_offset || (size_t) st.st_size - data_offset < numberOfDataBytes) {
+		message_printf("FAILED TO READ MATRIX DATA\n");
+		close(fd);
+		return false;
+	}
+	if (lseek(fd,data_offset,SEEK_SET) < 0) {
+		report_io_error("FAILED TO SEEK TO MATRIX DATA\n");
+		close(fd);
+		return false;
+	}
+
+	if (!create_matrix(m,name,rows,cols)) {
+		close(fd);
+		return false;
+	}
+	if (!read_fully(fd,(*m)->data,numberOfDataBytes,&got) || got != numberOfDataBytes) {
+		report_io_error("FAILED TO READ MATRIX DATA\n");
+		destroy_matrix(m);
+		close(fd);
+		return false;	
+	}
+
+	if (close(fd)) {
+		destroy_matrix(m);
+		return false;
+
+	}
+	return true;
+}
+
+/* 
+ * PURPOSE: map a matrix file into memory instead of reading it, data points
+ *	straight into a MAP_PRIVATE mapping so pages are faulted in lazily and
+ *	writes stay private to this process
+ * INPUTS: 
+ *	matrix_input_filename : input file name need to be mapped;
+ *  m : where the new matrix is stored;
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+bool read_matrix_mmap (const char* matrix_input_filename, Matrix_t** m) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (matrix_input_filename == NULL){
+		message_printf("no matrix input file");
+		return false;
+	}
+	if (m == NULL){
+		message_printf("no matrix will input");
+		return false;
+	}
+
+	int fd = open(matrix_input_filename,O_RDONLY);
+	if (fd < 0) {
+		message_printf("FAILED TO OPEN FOR READING\n");
+		message_perror("OPEN");
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd,&st) < 0) {
+		message_perror("FAILED TO STAT FILE\n");
+		close(fd);
+		return false;
+	}
+	const size_t file_len = st.st_size;
+	if (file_len < sizeof(unsigned int) * 3) {
+		message_printf("FILE TOO SMALL TO BE A MATRIX\n");
+		close(fd);
+		return false;
+	}
+
+	unsigned char* base = mmap(NULL,file_len,PROT_READ | PROT_WRITE,MAP_PRIVATE,fd,0);
+	/* the mapping keeps its own reference to the file */
+	close(fd);
+	if (base == MAP_FAILED) {
+		message_perror("FAILED TO MAP FILE\n");
+		return false;
+	}
 
+	char name[MATRIX_NAME_LEN];
+	size_t rows = 0;
+	size_t cols = 0;
+	size_t offset = 0;
+	uint32_t flags = 0;
+	if (!parse_matrix_header(base,file_len,name,&rows,&cols,&offset,&flags)) {
+		munmap(base,file_len);
 		return false;
 	}
+	if (flags & MATRIX_FILE_TILED) {
+		/* tiles are not row-major, read them into a heap matrix */
+		munmap(base,file_len);
+		return read_matrix(matrix_input_filename,m);
+	}
+	if (flags & MATRIX_FILE_COMPRESSED) {
+		/* compressed data can not be used in place, decode it into a heap matrix */
+		const bool ok = decode_compressed(base,file_len,offset,name,rows,cols,m);
+		munmap(base,file_len);
+		return ok;
+	}
 
-	if (read(fd,&cols,sizeof(unsigned int)) != sizeof(unsigned int)) {
-		printf("FAILED TO READ MATRIX COLUMN SIZE\n");
-		if (errno == EACCES ) {
-			perror("DO NOT HAVE ACCESS TO FILE\n");
-		}
-		else if (errno == EADDRINUSE ){
-			perror("FILE ALREADY IN USE\n");
-		}
-		else if (errno == EBADF) {
-			perror("BAD FILE DESCRIPTOR\n");	
-		}
-		else if (errno == EEXIST) {
-			perror("FILE EXIST\n");
-		}
+	const size_t numberOfDataBytes = rows * cols * sizeof(unsigned int);
+	if (file_len < offset || file_len - offset < numberOfDataBytes) {
+		message_printf("FAILED TO READ MATRIX DATA\n");
+		munmap(base,file_len);
+		return false;
+	}
+	if (offset % sizeof(unsigned int) != 0) {
+		/* written before the name field was padded, can not be used in place */
+		message_printf("MATRIX DATA NOT ALIGNED, USE read WITHOUT --mmap\n");
+		munmap(base,file_len);
+		return false;
+	}
 
+	*m = mempool_header_alloc();
+	if (!(*m)) {
+		munmap(base,file_len);
 		return false;
 	}
+	memcpy((*m)->name,name,MATRIX_NAME_LEN);
+	(*m)->rows = rows;
+	(*m)->cols = cols;
+	(*m)->data = (unsigned int*) &base[offset];
+	(*m)->mapping = base;
+	(*m)->mapping_len = file_len;
+	stats_record_alloc(numberOfDataBytes);
+	return true;
+}
 
-	unsigned int numberOfDataBytes = rows * cols * sizeof(unsigned int);
-	unsigned int *data = calloc(rows * cols, sizeof(unsigned int));
-	if (read(fd,data,numberOfDataBytes) != numberOfDataBytes) {
-		printf("FAILED TO READ MATRIX DATA\n");
-		if (errno == EACCES ) {
-			perror("DO NOT HAVE ACCESS TO FILE\n");
-		}
-		else if (errno == EADDRINUSE ){
-			perror("FILE ALREADY IN USE\n");
-		}
-		else if (errno == EBADF) {
-			perror("BAD FILE DESCRIPTOR\n");	
-		}
-		else if (errno == EEXIST) {
-			perror("FILE EXIST\n");
-		}
+/* turns a segment name into the "/name" form shm_open wants */
+static bool shm_path (const char* shm_name, char path[MATRIX_SHM_NAME_LEN]) {
+	const char* base = shm_name[0] == '/' ? &shm_name[1] : shm_name;
+	if (base[0] == '\0' || strchr(base,'/') != NULL || strlen(base) + 2 > MATRIX_SHM_NAME_LEN) {
+		message_printf("shared memory name %s must be a single name shorter than %d characters\n",
+			shm_name, MATRIX_SHM_NAME_LEN - 1);
+		return false;
+	}
+	path[0] = '/';
+	strcpy(&path[1],base);
+	return true;
+}
 
-		return false;	
+/* 
+ * PURPOSE: drops the reference of this process to a shared memory segment,
+ *	the last process to detach removes its name
+ * INPUTS: 
+ *	header : start of the mapped segment;
+ *  len : length of the mapping;
+ * RETURN:
+ *  nothing
+ **/
+static void release_segment (Matrix_Shm_Header_t* header, size_t len) {
+	if (__atomic_sub_fetch(&header->refs,1,__ATOMIC_ACQ_REL) == 0) {
+		shm_unlink(header->shm_name);
+	}
+	munmap(header,len);
+}
+
+/* 
+ * PURPOSE: moves the data of m into a new POSIX shared memory segment, which
+ *	other processes can map with attach_matrix_shm; m keeps working on the
+ *	segment, so its writes are seen by every process attached to it
+ * INPUTS: 
+ *	m : matrix to share;
+ *  shm_name : name of the segment, must not exist yet;
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process, m is unchanged.
+ *
+ **/
+bool share_matrix_shm (Matrix_t* m, const char* shm_name) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (m == NULL){
+		message_printf("no matrix to share");
+		return false;
+	}
+	if (shm_name == NULL){
+		message_printf("no shared memory name");
+		return false;
 	}
+	if (m->shm) {
+		message_printf("Matrix (%s) is already shared as %s\n", m->name, m->shm->shm_name);
+		return false;
+	}
+	char path[MATRIX_SHM_NAME_LEN];
+	if (!shm_path(shm_name,path)) {
+		return false;
+	}
+	const size_t numberOfDataBytes = m->rows * m->cols * sizeof(unsigned int);
+	if (numberOfDataBytes > SIZE_MAX - MATRIX_SHM_HEADER_LEN) {
+		message_printf("matrix is too large");
+		return false;
+	}
+	const size_t len = MATRIX_SHM_HEADER_LEN + numberOfDataBytes;
 
-	if (!create_matrix(m,name_buffer,rows,cols)) {
+	const int fd = shm_open(path,O_RDWR | O_CREAT | O_EXCL,0600);
+	if (fd < 0) {
+		message_perror("SHM_OPEN");
+		return false;
+	}
+	if (ftruncate(fd,len) < 0) {
+		message_perror("FAILED TO SIZE SHARED MEMORY\n");
+		close(fd);
+		shm_unlink(path);
+		return false;
+	}
+	unsigned char* base = mmap(NULL,len,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		message_perror("FAILED TO MAP SHARED MEMORY\n");
+		shm_unlink(path);
 		return false;
 	}
 
-	load_matrix(*m,data);
+	Matrix_Shm_Header_t* header = (Matrix_Shm_Header_t*) base;
+	memcpy(header->magic,MATRIX_SHM_MAGIC,sizeof(header->magic));
+	header->version = MATRIX_SHM_VERSION;
+	header->header_len = MATRIX_SHM_HEADER_LEN;
+	header->rows = m->rows;
+	header->cols = m->cols;
+	header->refs = 1;
+	/* the generation carries on, so a cached summary stays valid */
+	header->generation = m->generation;
+	strncpy(header->name,m->name,sizeof(header->name) - 1);
+	memcpy(header->shm_name,path,sizeof(path));
+	unsigned int* data = (unsigned int*) &base[MATRIX_SHM_HEADER_LEN];
+	Element_Task_t task = { .a = m->data, .c = data };
+	parallel_for(m->rows * m->cols,sizeof(unsigned int),copy_task,&task);
 
-	free(data);
+	/* copy-on-write duplicates of m keep the old buffer */
+	release_data(m);
+	stats_record_alloc(numberOfDataBytes);
+	m->data = data;
+	m->mapping = base;
+	m->mapping_len = len;
+	m->shm = header;
+	return true;
+}
 
-	if (close(fd)) {
+/* 
+ * PURPOSE: maps a shared memory matrix made by share_matrix_shm as a new
+ *	matrix without copying it; writes on either side are seen by both
+ * INPUTS: 
+ *	shm_name : name of the segment;
+ *  name : name of the new matrix;
+ *  m : where the new matrix is stored;
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+bool attach_matrix_shm (const char* shm_name, const char* name, Matrix_t** m) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (shm_name == NULL || name == NULL){
+		message_printf("no shared memory name or matrix name");
+		return false;
+	}
+	if (m == NULL){
+		message_printf("no matrix will input");
+		return false;
+	}
+	if (strlen(name) + 1 > MATRIX_NAME_LEN) {
+		message_printf("the name of matrix is too long");
+		return false;
+	}
+	char path[MATRIX_SHM_NAME_LEN];
+	if (!shm_path(shm_name,path)) {
+		return false;
+	}
+
+	const int fd = shm_open(path,O_RDWR,0);
+	if (fd < 0) {
+		message_perror("SHM_OPEN");
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd,&st) < 0) {
+		message_perror("FAILED TO STAT SHARED MEMORY\n");
+		close(fd);
+		return false;
+	}
+	const size_t len = st.st_size;
+	if (len < MATRIX_SHM_HEADER_LEN) {
+		message_printf("%s IS NOT A SHARED MATRIX\n", path);
+		close(fd);
+		return false;
+	}
+	unsigned char* base = mmap(NULL,len,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		message_perror("FAILED TO MAP SHARED MEMORY\n");
 		return false;
+	}
+
+	Matrix_Shm_Header_t* header = (Matrix_Shm_Header_t*) base;
+	/* rows and cols change when the owner reshapes, read them once */
+	const size_t rows = __atomic_load_n(&header->rows,__ATOMIC_RELAXED);
+	const size_t cols = __atomic_load_n(&header->cols,__ATOMIC_RELAXED);
+	const size_t header_len = header->header_len;
+	if (memcmp(header->magic,MATRIX_SHM_MAGIC,sizeof(header->magic)) != 0
+		|| header->version != MATRIX_SHM_VERSION
+		|| header_len < sizeof(Matrix_Shm_Header_t) || header_len % sizeof(unsigned int) != 0
+		|| header_len > len
+		|| (cols != 0 && rows > (len - header_len) / sizeof(unsigned int) / cols)) {
+		message_printf("%s IS NOT A SHARED MATRIX\n", path);
+		munmap(base,len);
+		return false;
+	}
+	/* a count of zero means the last user is detaching and unlinks the name */
+	uint64_t refs = __atomic_load_n(&header->refs,__ATOMIC_ACQUIRE);
+	do {
+		if (refs == 0) {
+			message_printf("shared matrix %s is being removed\n", path);
+			munmap(base,len);
+			return false;
+		}
+	} while (!__atomic_compare_exchange_n(&header->refs,&refs,refs + 1,false,
+			__ATOMIC_ACQ_REL,__ATOMIC_ACQUIRE));
 
+	*m = mempool_header_alloc();
+	if (!(*m)) {
+		release_segment(header,len);
+		return false;
 	}
+	memcpy((*m)->name,name,strlen(name) + 1);
+	(*m)->rows = rows;
+	(*m)->cols = cols;
+	(*m)->data = (unsigned int*) &base[header_len];
+	(*m)->mapping = base;
+	(*m)->mapping_len = len;
+	(*m)->shm = header;
+	(*m)->generation = data_generation(*m);
+	stats_record_alloc(rows * cols * sizeof(unsigned int));
 	return true;
 }
 
 /* 
- * PURPOSE: output matrix  
+ * PURPOSE: read the rows x cols window at (r0,c0) of a matrix file without
+ *	loading the rest, tiled files touch only the overlapping tiles
+ * INPUTS: 
+ *	matrix_input_filename : raw or tiled matrix file;
+ *  r0, c0 : top left element of the window;
+ *  rows, cols : size of the window;
+ *  name : name of the new matrix;
+ *  m : where the new matrix is stored;
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+bool read_matrix_region (const char* matrix_input_filename, size_t r0, size_t c0, size_t rows,
+			size_t cols, const char* name, Matrix_t** m) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (matrix_input_filename == NULL){
+		message_printf("no matrix input file");
+		return false;
+	}
+	if (name == NULL || m == NULL){
+		message_printf("no matrix will input");
+		return false;
+	}
+
+	int fd = open(matrix_input_filename,O_RDONLY);
+	if (fd < 0) {
+		report_io_error("FAILED TO OPEN FOR READING\n");
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd,&st) < 0) {
+		message_perror("FAILED TO STAT FILE\n");
+		close(fd);
+		return false;
+	}
+	unsigned char header[sizeof(Matrix_File_Header_t)];
+	size_t got = 0;
+	if (!read_fully(fd,header,sizeof(header),&got)) {
+		report_io_error("FAILED TO READING FILE\n");
+		close(fd);
+		return false;
+	}
+	char file_name[MATRIX_NAME_LEN];
+	size_t file_rows = 0;
+	size_t file_cols = 0;
+	size_t data_offset = 0;
+	uint32_t flags = 0;
+	if (!parse_matrix_header(header,got,file_name,&file_rows,&file_cols,&data_offset,&flags)) {
+		close(fd);
+		return false;
+	}
+	const bool ok = read_region_fd(fd,st.st_size,data_offset,flags,file_rows,file_cols,
+		r0,c0,rows,cols,name,m);
+	close(fd);
+	return ok;
+}
+
+/* 
+ * PURPOSE: write every byte described by iov, retrying short writes and EINTR
+ * INPUTS: 
+ *	fd: file to write to;
+ *  iov: vectors to write, advanced in place;
+ *  iovcnt: number of vectors;
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false with errno set by writev.
+ *
+ **/
+static bool write_iov_fully (int fd, struct iovec* iov, int iovcnt) {
+	while (iovcnt > 0) {
+		const ssize_t result = writev(fd,iov,iovcnt);
+		if (result < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		/* drop the vectors that went out completely, then advance into a partial one;
+		 * a short write may end exactly on a vector boundary, so only a writev
+		 * that moved nothing at all counts as stuck */
+		size_t written = (size_t) result;
+		while (iovcnt > 0 && written >= iov->iov_len) {
+			written -= iov->iov_len;
+			++iov;
+			--iovcnt;
+		}
+		if (iovcnt > 0) {
+			if (result == 0) {
+				errno = EIO;
+				return false;
+			}
+			iov->iov_base = (unsigned char*) iov->iov_base + written;
+			iov->iov_len -= written;
+		}
+	}
+	return true;
+}
+
+/* 
+ * PURPOSE: output matrix without staging it, the header and the data are
+ *	streamed straight from m->data in WRITE_CHUNK_BYTES pieces
  * INPUTS: 
  *	matrix_output_filename: outpur filename; 
  *  m: matrix need to be written;
+ *  sync: fdatasync the file before closing it;
  * RETURN:
- *  If no errors occurred during instantiation then true
+ *  If no errors occurred then true
  *  else false for an error in the process.
  *
  **/
-bool write_matrix (const char* matrix_output_filename, Matrix_t* m) {
+bool write_matrix_stream (const char* matrix_output_filename, Matrix_t* m, bool sync) {
 	
 	// ERROR CHECK INCOMING PARAMETERS
 	if (matrix_output_filename == NULL){
-		printf("the output file");
+		message_printf("the output file");
 		return false;
 	}
 	if (m == NULL){
-		printf("the matrix to be written");
+		message_printf("the matrix to be written");
 		return false;
 	}
 
-	int fd = open (matrix_output_filename, O_CREAT | O_RDWR | O_TRUNC, 0644);
+	int fd = open (matrix_output_filename, O_CREAT | O_WRONLY | O_TRUNC, 0644);
 	/* ERROR HANDLING USING errorno*/
 	if (fd < 0) {
-		printf("FAILED TO CREATE/OPEN FILE FOR WRITING\n");
+		message_printf("FAILED TO CREATE/OPEN FILE FOR WRITING\n");
 		if (errno == EACCES ) {
-			perror("DO NOT HAVE ACCESS TO FILE\n");
+			message_perror("DO NOT HAVE ACCESS TO FILE\n");
 		}
 		else if (errno == EADDRINUSE ){
-			perror("FILE ALREADY IN USE\n");
+			message_perror("FILE ALREADY IN USE\n");
 		}
 		else if (errno == EBADF) {
-			perror("BAD FILE DESCRIPTOR\n");	
+			message_perror("BAD FILE DESCRIPTOR\n");	
 		}
 		else if (errno == EEXIST) {
-			perror("FILE EXISTS\n");
+			message_perror("FILE EXISTS\n");
 		}
 		return false;
 	}
-	/* Calculate the needed buffer for our matrix */
-	unsigned int name_len = strlen(m->name) + 1;
-	unsigned int numberOfBytes = sizeof(unsigned int) + (sizeof(unsigned int)  * 2) + name_len + sizeof(unsigned int) * m->rows * m->cols + 1;
-	/* Allocate the output_buffer in bytes
-	 * IMPORTANT TO UNDERSTAND THIS WAY OF MOVING MEMORY
-	 */
-	unsigned char* output_buffer = calloc(numberOfBytes,sizeof(unsigned char));
-	unsigned int offset = 0;
-	memcpy(&output_buffer[offset], &name_len, sizeof(unsigned int)); // IMPORTANT C FUNCTION TO KNOW
-	offset += sizeof(unsigned int);	
-	memcpy(&output_buffer[offset], m->name,name_len);
-	offset += name_len;
-	memcpy(&output_buffer[offset],&m->rows,sizeof(unsigned int));
-	offset += sizeof(unsigned int);
-	memcpy(&output_buffer[offset],&m->cols,sizeof(unsigned int));
-	offset += sizeof(unsigned int);
-	memcpy (&output_buffer[offset],m->data,m->rows * m->cols * sizeof(unsigned int));
-	offset += (m->rows * m->cols * sizeof(unsigned int));
-	output_buffer[numberOfBytes - 1] = EOF;
-
-	if (write(fd,output_buffer,numberOfBytes) != numberOfBytes) {
-		printf("FAILED TO WRITE MATRIX TO FILE\n");
-		if (errno == EACCES ) {
-			perror("DO NOT HAVE ACCESS TO FILE\n");
+
+	/* fixed 64 byte header, the data after it stays aligned for read --mmap */
+	Matrix_File_Header_t header;
+	init_matrix_file_header(&header,m->name,m->rows,m->cols,0);
+	const size_t header_len = sizeof(header);
+	unsigned char trailer = EOF;
+
+	const unsigned char* data = (const unsigned char*) m->data;
+	const size_t numberOfDataBytes = m->rows * m->cols * sizeof(unsigned int);
+	size_t offset = 0;
+	bool first = true;
+	do {
+		struct iovec iov[3];
+		int iovcnt = 0;
+		if (first) {
+			iov[iovcnt].iov_base = &header;
+			iov[iovcnt++].iov_len = header_len;
 		}
-		else if (errno == EADDRINUSE ){
-			perror("FILE ALREADY IN USE\n");
+		const size_t len = (numberOfDataBytes - offset < WRITE_CHUNK_BYTES) ? numberOfDataBytes - offset : WRITE_CHUNK_BYTES;
+		if (len > 0) {
+			iov[iovcnt].iov_base = (void*) &data[offset];
+			iov[iovcnt++].iov_len = len;
 		}
-		else if (errno == EBADF) {
-			perror("BAD FILE DESCRIPTOR\n");	
+		offset += len;
+		if (offset == numberOfDataBytes) {
+			iov[iovcnt].iov_base = &trailer;
+			iov[iovcnt++].iov_len = sizeof(trailer);
 		}
-		else if (errno == EEXIST) {
-			perror("FILE EXIST\n");
+		if (!write_iov_fully(fd,iov,iovcnt)) {
+			message_printf("FAILED TO WRITE MATRIX TO FILE\n");
+			message_perror("WRITE");
+			close(fd);
+			return false;
 		}
+		first = false;
+	} while (offset < numberOfDataBytes);
+
+	if (sync && fdatasync(fd)) {
+		message_perror("FAILED TO SYNC MATRIX FILE\n");
+		close(fd);
+		return false;
+	}
+	if (close(fd)) {
+		return false;
+	}
+
+	return true;
+}
+
+/* 
+ * PURPOSE: output matrix in the compressed block format, blocks are encoded
+ *	in parallel batches and the block table is written last
+ * INPUTS: 
+ *	matrix_output_filename: outpur filename; 
+ *  m: matrix need to be written;
+ *  sync: fdatasync the file before closing it;
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+bool write_matrix_compressed (const char* matrix_output_filename, Matrix_t* m, bool sync) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (matrix_output_filename == NULL){
+		message_printf("the output file");
+		return false;
+	}
+	if (m == NULL){
+		message_printf("the matrix to be written");
+		return false;
+	}
+
+	const size_t n = m->rows * m->cols;
+	const size_t num_blocks = (n + COMPRESS_BLOCK_ELEMENTS - 1) / COMPRESS_BLOCK_ELEMENTS;
+	const size_t stride = compress_bound(COMPRESS_BLOCK_ELEMENTS);
+	const size_t batch = num_blocks < COMPRESS_BATCH_BLOCKS ? num_blocks : COMPRESS_BATCH_BLOCKS;
+	uint64_t* offsets = calloc(num_blocks + 1,sizeof(uint64_t));
+	size_t* lengths = calloc(batch + 1,sizeof(size_t));
+	unsigned char* out = malloc(batch * stride + 1);
+	if (!offsets || !lengths || !out) {
+		message_printf("FAILED TO ALLOCATE COMPRESSION BUFFERS\n");
+		free(offsets);
+		free(lengths);
+		free(out);
+		return false;
+	}
+
+	Matrix_File_Header_t header;
+	init_matrix_file_header(&header,m->name,m->rows,m->cols,MATRIX_FILE_COMPRESSED);
+	Matrix_Block_Table_t table = { .num_blocks = num_blocks,
+		.block_elements = COMPRESS_BLOCK_ELEMENTS };
+	const size_t offsets_len = (num_blocks + 1) * sizeof(uint64_t);
+	header.header_len = sizeof(header) + sizeof(table) + offsets_len;
+
+	int fd = open (matrix_output_filename, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+	if (fd < 0) {
+		report_io_error("FAILED TO CREATE/OPEN FILE FOR WRITING\n");
+		free(offsets);
+		free(lengths);
+		free(out);
+		return false;
+	}
+
+	/* blocks go after the space reserved for the header and table */
+	bool ok = lseek(fd,header.header_len,SEEK_SET) >= 0;
+	uint64_t written = 0;
+	for (size_t first = 0; ok && first < num_blocks; first += batch) {
+		const size_t count = (num_blocks - first < batch) ? num_blocks - first : batch;
+		const size_t begin = first * COMPRESS_BLOCK_ELEMENTS;
+		const size_t end = (n - begin < count * COMPRESS_BLOCK_ELEMENTS) ? n : begin + count * COMPRESS_BLOCK_ELEMENTS;
+		Block_Task_t task = { .data = &m->data[begin], .n = end - begin, .out = out,
+			.out_stride = stride, .lengths = lengths };
+		parallel_for(end - begin,sizeof(unsigned int),encode_task,&task);
+
+		struct iovec iov[COMPRESS_BATCH_BLOCKS];
+		for (size_t b = 0; b < count; ++b) {
+			iov[b].iov_base = &out[b * stride];
+			iov[b].iov_len = lengths[b];
+			offsets[first + b] = written;
+			written += lengths[b];
+		}
+		ok = write_iov_fully(fd,iov,count);
+	}
+	offsets[num_blocks] = written;
+
+	unsigned char trailer = EOF;
+	struct iovec tail = { .iov_base = &trailer, .iov_len = sizeof(trailer) };
+	struct iovec head[3] = {
+		{ .iov_base = &header, .iov_len = sizeof(header) },
+		{ .iov_base = &table, .iov_len = sizeof(table) },
+		{ .iov_base = offsets, .iov_len = offsets_len },
+	};
+	ok = ok && write_iov_fully(fd,&tail,1) && lseek(fd,0,SEEK_SET) == 0
+		&& write_iov_fully(fd,head,3);
+	free(offsets);
+	free(lengths);
+	free(out);
+	if (!ok) {
+		message_printf("FAILED TO WRITE MATRIX TO FILE\n");
+		message_perror("WRITE");
+		close(fd);
+		return false;
+	}
+	if (sync && fdatasync(fd)) {
+		message_perror("FAILED TO SYNC MATRIX FILE\n");
+		close(fd);
 		return false;
 	}
-	
 	if (close(fd)) {
 		return false;
 	}
-	free(output_buffer);
+	return true;
+}
+
+/* 
+ * PURPOSE: output matrix as WRITE_TILE_DIM square tiles with a tile index so
+ *	read_matrix_region can fetch a window without reading the rest, the
+ *	tile rows are gathered straight from m->data by writev
+ * INPUTS: 
+ *	matrix_output_filename: outpur filename; 
+ *  m: matrix need to be written;
+ *  sync: fdatasync the file before closing it;
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+bool write_matrix_tiled (const char* matrix_output_filename, Matrix_t* m, bool sync) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (matrix_output_filename == NULL){
+		message_printf("the output file");
+		return false;
+	}
+	if (m == NULL){
+		message_printf("the matrix to be written");
+		return false;
+	}
+
+	const size_t tiles_down = (m->rows + WRITE_TILE_DIM - 1) / WRITE_TILE_DIM;
+	const size_t tiles_across = (m->cols + WRITE_TILE_DIM - 1) / WRITE_TILE_DIM;
+	const size_t num_tiles = tiles_down * tiles_across;
+	uint64_t* offsets = malloc((num_tiles ? num_tiles : 1) * sizeof(uint64_t));
+	if (!offsets) {
+		message_printf("FAILED TO ALLOCATE TILE INDEX\n");
+		return false;
+	}
+	/* tiles are stored uncompressed, so every offset is known up front */
+	uint64_t offset = 0;
+	for (size_t tr = 0; tr < tiles_down; ++tr) {
+		const size_t height = (m->rows - tr * WRITE_TILE_DIM < WRITE_TILE_DIM) ? m->rows - tr * WRITE_TILE_DIM : WRITE_TILE_DIM;
+		for (size_t tc = 0; tc < tiles_across; ++tc) {
+			const size_t width = (m->cols - tc * WRITE_TILE_DIM < WRITE_TILE_DIM) ? m->cols - tc * WRITE_TILE_DIM : WRITE_TILE_DIM;
+			offsets[tr * tiles_across + tc] = offset;
+			offset += (uint64_t) height * width * sizeof(unsigned int);
+		}
+	}
+
+	Matrix_File_Header_t header;
+	init_matrix_file_header(&header,m->name,m->rows,m->cols,MATRIX_FILE_TILED);
+	/* a matrix smaller than one tile is recorded as one tile of its own size */
+	Matrix_Tile_Table_t table = {
+		.tile_rows = (m->rows > 0 && m->rows < WRITE_TILE_DIM) ? m->rows : WRITE_TILE_DIM,
+		.tile_cols = (m->cols > 0 && m->cols < WRITE_TILE_DIM) ? m->cols : WRITE_TILE_DIM,
+		.num_tiles = num_tiles };
+	header.header_len = sizeof(header) + sizeof(table) + num_tiles * sizeof(uint64_t);
+
+	int fd = open (matrix_output_filename, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+	if (fd < 0) {
+		report_io_error("FAILED TO CREATE/OPEN FILE FOR WRITING\n");
+		free(offsets);
+		return false;
+	}
+	struct iovec head[3] = {
+		{ .iov_base = &header, .iov_len = sizeof(header) },
+		{ .iov_base = &table, .iov_len = sizeof(table) },
+		{ .iov_base = offsets, .iov_len = num_tiles * sizeof(uint64_t) },
+	};
+	bool ok = write_iov_fully(fd,head,3);
 
+	/* one vector per tile row, flushed whenever TILE_IOV_MAX are queued */
+	struct iovec iov[TILE_IOV_MAX];
+	int iovcnt = 0;
+	for (size_t tr = 0; ok && tr < tiles_down; ++tr) {
+		const size_t top = tr * WRITE_TILE_DIM;
+		const size_t height = (m->rows - top < WRITE_TILE_DIM) ? m->rows - top : WRITE_TILE_DIM;
+		for (size_t tc = 0; ok && tc < tiles_across; ++tc) {
+			const size_t left = tc * WRITE_TILE_DIM;
+			const size_t width = (m->cols - left < WRITE_TILE_DIM) ? m->cols - left : WRITE_TILE_DIM;
+			for (size_t i = 0; ok && i < height; ++i) {
+				iov[iovcnt].iov_base = &m->data[(top + i) * m->cols + left];
+				iov[iovcnt++].iov_len = width * sizeof(unsigned int);
+				if (iovcnt == TILE_IOV_MAX) {
+					ok = write_iov_fully(fd,iov,iovcnt);
+					iovcnt = 0;
+				}
+			}
+		}
+	}
+	unsigned char trailer = EOF;
+	iov[iovcnt].iov_base = &trailer;
+	iov[iovcnt++].iov_len = sizeof(trailer);
+	ok = ok && write_iov_fully(fd,iov,iovcnt);
+	free(offsets);
+	if (!ok) {
+		message_printf("FAILED TO WRITE MATRIX TO FILE\n");
+		message_perror("WRITE");
+		close(fd);
+		return false;
+	}
+	if (sync && fdatasync(fd)) {
+		message_perror("FAILED TO SYNC MATRIX FILE\n");
+		close(fd);
+		return false;
+	}
+	if (close(fd)) {
+		return false;
+	}
 	return true;
 }
 
+/* 
+ * PURPOSE: output matrix  
+ * INPUTS: 
+ *	matrix_output_filename: outpur filename; 
+ *  m: matrix need to be written;
+ * RETURN:
+ *  If no errors occurred during instantiation then true
+ *  else false for an error in the process.
+ *
+ **/
+bool write_matrix (const char* matrix_output_filename, Matrix_t* m) {
+	return write_matrix_stream(matrix_output_filename,m,false);
+}
+
 /* 
  * PURPOSE: generate random matrix based on start_range and end_range; 
  * INPUTS: 
  *	m: matrix; 
  *  start_range: minimum of value in matrix;
- *  end_range: maximum of value in matrix
+ *  end_range: maximum of value in matrix, inclusive, up to UINT_MAX
+ *  seed: the same seed always gives the same matrix, whatever the thread count
  * RETURN:
  *  If no errors occurred during instantiation then true
  *  else false for an error in the process.
  *
  **/
-bool random_matrix(Matrix_t* m, unsigned int start_range, unsigned int end_range) {
+bool random_matrix(Matrix_t* m, unsigned int start_range, unsigned int end_range, uint64_t seed) {
 	
 	// ERROR CHECK INCOMING PARAMETERS
 	if (m == NULL){
-		printf("no input matrix in random part");
+		message_printf("no input matrix in random part");
 		return false;
 	}
-	if (start_range > 4294967295){
-		printf("too large for start range");
+	if (start_range > end_range){
+		message_printf("start range is larger than end range");
 		return false;
 	}
-	if (end_range > 4294967295){
-		printf("too large for end range");
+	if (!unshare_matrix(m)) {
 		return false;
 	}
-	for (unsigned int i = 0; i < m->rows; ++i) {
-		for (unsigned int j = 0; j < m->cols; ++j) {
-			m->data[i * m->cols + j] = rand() % (end_range + 1 - start_range)+ start_range;
-		}
-	}
+	Element_Task_t task = { .a = m->data, .start_range = start_range,
+		.end_range = end_range, .seed = seed };
+	parallel_for(m->rows * m->cols,sizeof(unsigned int),random_task,&task);
+	touch_matrix(m);
 	return true;
 }
 
@@ -563,45 +2490,17 @@ void load_matrix (Matrix_t* m, unsigned int* data) {
 	
 	// ERROR CHECK INCOMING PARAMETERS
 	if (m ==NULL){
-		printf("no matrix");
+		message_printf("no matrix");
 		return;
 	}
 	if (data == NULL){
-		printf("no dataset");
+		message_printf("no dataset");
 		return;
 	}
-	memcpy(m->data,data,m->rows * m->cols * sizeof(unsigned int));
-}
-
-/* 
- * PURPOSE: give the information of new_matrix to mats 
- * INPUTS: 
- *	mats: matrix; 
- *  new_matrix: matrix information
- *  num_mats: the number of matrix
- * RETURN:
- *  If no errors occurred during instantiation then value of position
- *  else -1 for an error in the process.
- *
- **/
-unsigned int add_matrix_to_array (Matrix_t** mats, Matrix_t* new_matrix, unsigned int num_mats) {
-	
-	// ERROR CHECK INCOMING PARAMETERS
-	// no limit on mats
-	if (new_matrix == NULL){
-		printf("no matrix information has been built");
-		return -1;
-	}
-	if (num_mats > 4294967295){
-		printf("too long number to parameter");
-		return -1;
-	}
-	static long int current_position = 0;
-	const long int pos = current_position % num_mats;
-	if ( mats[pos] ) {
-		destroy_matrix(&mats[pos]);
-	} 
-	mats[pos] = new_matrix;
-	current_position++;
-	return pos;
+	if (!unshare_matrix(m)) {
+		return;
+	}
+	Element_Task_t task = { .a = data, .c = m->data };
+	parallel_for(m->rows * m->cols,sizeof(unsigned int),copy_task,&task);
+	touch_matrix(m);
 }
@@ -1,27 +1,151 @@
 #ifndef _MATRIX_H_
 #define _MATRIX_H_
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
         
 #define MATRIX_NAME_LEN 25
 
+/* "MATX" as the first four bytes of a matrix file, files without it use the
+ * original u32 name_len/name/u32 rows/u32 cols layout */
+#define MATRIX_FILE_MAGIC "MATX"
+#define MATRIX_FILE_VERSION 2
+
+/* flags: the data is stored as COMPRESS_BLOCK_ELEMENTS element blocks, see
+ * Matrix_Block_Table_t, instead of raw rows * cols u32 elements */
+#define MATRIX_FILE_COMPRESSED 0x1u
+
+/* flags: the data is stored as tiles, see Matrix_Tile_Table_t */
+#define MATRIX_FILE_TILED 0x2u
+
+/* on-disk header, little endian, data follows at header_len */
+typedef struct {
+	char magic[4];
+	uint32_t version;
+	uint32_t header_len;
+	uint32_t flags;
+	uint64_t rows;
+	uint64_t cols;
+	char name[32];
+}Matrix_File_Header_t;
+
+/* follows the header of a compressed file, then num_blocks + 1 u64 block
+ * offsets relative to header_len, the last one being the end of the data */
+typedef struct {
+	uint64_t num_blocks;
+	uint32_t block_elements;
+	uint32_t reserved;
+}Matrix_Block_Table_t;
+
+/* follows the header of a tiled file, then num_tiles u64 tile offsets
+ * relative to header_len in row-major tile order. Every tile holds its
+ * min(tile_rows, rows left) x min(tile_cols, cols left) elements row-major */
+typedef struct {
+	uint32_t tile_rows;
+	uint32_t tile_cols;
+	uint64_t num_tiles;
+}Matrix_Tile_Table_t;
+
+/* shared memory segments made by share_matrix_shm start with this header,
+ * the rows * cols u32 elements follow at header_len */
+#define MATRIX_SHM_MAGIC "MSHM"
+#define MATRIX_SHM_VERSION 1
+#define MATRIX_SHM_HEADER_LEN 256
+#define MATRIX_SHM_NAME_LEN 64
+
+typedef struct {
+	char magic[4];
+	uint32_t version;
+	uint32_t header_len;
+	uint32_t reserved;
+	uint64_t rows;
+	uint64_t cols;
+	uint64_t refs; /* processes mapping the segment, atomic; the last one to detach unlinks it */
+	uint64_t generation; /* bumped atomically after every write to the data */
+	char name[32]; /* name of the matrix that was shared */
+	char shm_name[MATRIX_SHM_NAME_LEN]; /* as passed to shm_open */
+}Matrix_Shm_Header_t;
+
+/* reductions of the data of a matrix, cached for one generation of it */
+typedef struct {
+	bool valid;
+	uint64_t generation; /* generation of the data the values were computed from */
+	uint64_t sum;
+	uint64_t hash; /* equal data gives equal hashes, different hashes mean different data */
+	unsigned int min;
+	unsigned int max;
+}Matrix_Summary_t;
+
+/* largest histogram describe_matrix fills */
+#define MATRIX_STATS_MAX_BINS 4096
+
+/* statistics of the data of a matrix, see describe_matrix */
+typedef struct {
+	unsigned int min;
+	unsigned int max;
+	uint64_t sum;
+	double mean;
+	double variance; /* population variance */
+	/* optional histogram: set bins (0 for none), lo, hi and histogram before the
+	 * call; bins is lowered when the range holds fewer than bins equal bins */
+	unsigned int bins;
+	unsigned int lo;
+	unsigned int hi;
+	uint64_t bin_width; /* bin i holds lo + i * bin_width up to the next bin */
+	uint64_t* histogram; /* bins counters */
+	uint64_t below; /* elements under lo */
+	uint64_t above; /* elements over hi */
+}Matrix_Stats_t;
+
 typedef struct {
 	char name[MATRIX_NAME_LEN];
-	unsigned int rows;
-	unsigned int cols;
+	size_t rows;
+	size_t cols;
 	unsigned int *data;
+	void *mapping; /* base of the file mapping behind data, NULL when data is heap allocated */
+	size_t mapping_len;
+	Matrix_Shm_Header_t *shm; /* header of the shared memory segment that is the mapping, else NULL */
+	size_t *shared; /* reference count of data while copy-on-write duplicates share it, else NULL */
+	uint64_t generation; /* bumped by every write to data, see touch_matrix */
+	Matrix_Summary_t summary;
 }Matrix_t;
 
-bool create_matrix (Matrix_t** new_matrix, const char* name, const unsigned int rows, const unsigned int cols);
+bool create_matrix (Matrix_t** new_matrix, const char* name, const size_t rows, const size_t cols);
 void destroy_matrix (Matrix_t** m); 
 bool write_matrix (const char* matrix_output_filename, Matrix_t* m);
+bool write_matrix_stream (const char* matrix_output_filename, Matrix_t* m, bool sync);
+bool write_matrix_compressed (const char* matrix_output_filename, Matrix_t* m, bool sync);
+bool write_matrix_tiled (const char* matrix_output_filename, Matrix_t* m, bool sync);
 bool read_matrix (const char* matrix_input_filename, Matrix_t** m);
-int sum_matrix (Matrix_t* m);
+void init_matrix_file_header (Matrix_File_Header_t* header, const char* name, size_t rows,
+			size_t cols, uint32_t flags);
+bool read_matrix_file_header (int fd, char name[MATRIX_NAME_LEN], size_t* rows, size_t* cols,
+			size_t* data_offset, uint32_t* flags);
+bool read_matrix_mmap (const char* matrix_input_filename, Matrix_t** m);
+bool read_matrix_region (const char* matrix_input_filename, size_t r0, size_t c0, size_t rows,
+			size_t cols, const char* name, Matrix_t** m);
+bool share_matrix_shm (Matrix_t* m, const char* shm_name);
+bool attach_matrix_shm (const char* shm_name, const char* name, Matrix_t** m);
+bool sum_matrix (Matrix_t* m, uint64_t* sum);
+bool describe_matrix (Matrix_t* m, Matrix_Stats_t* stats);
+bool rowsum_matrix (Matrix_t* m, Matrix_t* result);
+bool colsum_matrix (Matrix_t* m, Matrix_t* result);
 bool add_matrices (Matrix_t* a, Matrix_t* b, Matrix_t* c); 
+bool multiply_matrices (Matrix_t* a, Matrix_t* b, Matrix_t* c);
 bool bitwise_shift_matrix (Matrix_t* a, char direction, unsigned int shift);
+bool transpose_matrix (Matrix_t* src, Matrix_t* dst);
+bool reshape_matrix (Matrix_t* m, size_t rows, size_t cols);
 bool duplicate_matrix (Matrix_t* src, Matrix_t* dest);
+bool clone_matrix (Matrix_t** new_matrix, const char* name, Matrix_t* src);
+bool unshare_matrix (Matrix_t* m);
+void touch_matrix (Matrix_t* m);
+bool summarize_matrix (Matrix_t* m, Matrix_Summary_t* summary);
 bool equal_matrices (Matrix_t* a, Matrix_t* b); 
-void display_matrix (Matrix_t* m); 
-bool random_matrix(Matrix_t* m, unsigned int start_range, unsigned int end_range);
-unsigned int add_matrix_to_array (Matrix_t** mats, Matrix_t* new_matrix, unsigned int num_mats);
+void display_matrix (FILE* out, Matrix_t* m);
+bool display_matrix_window (FILE* out, Matrix_t* m, size_t r0, size_t c0, size_t rows, size_t cols);
+bool random_matrix(Matrix_t* m, unsigned int start_range, unsigned int end_range, uint64_t seed);
 
 
 #endif
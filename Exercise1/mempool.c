@@ -0,0 +1,343 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "mempool.h"
+
+/* distinct buffer sizes kept around, the least recently used size is evicted */
+#define MEMPOOL_MAX_CLASSES 32
+/* freed buffers kept per size */
+#define MEMPOOL_MAX_PER_CLASS 8
+/* freed data above this total goes straight back to the system */
+#define MEMPOOL_MAX_RETAINED_BYTES ((size_t) 512 << 20)
+/* buffers from this size up are mapped straight from the kernel, page aligned
+ * and zeroed lazily as they are first touched */
+#define MEMPOOL_MAP_BYTES ((size_t) 128 << 10)
+/* Matrix_t headers carved out of one slab allocation */
+#define MEMPOOL_SLAB_HEADERS 64
+
+typedef struct {
+	size_t bytes;
+	unsigned int count;
+	uint64_t last_use;
+	void* buffers[MEMPOOL_MAX_PER_CLASS];
+}Size_Class_t;
+
+typedef union Header_Node {
+	Matrix_t matrix;
+	union Header_Node* next;
+}Header_Node_t;
+
+typedef struct Header_Slab {
+	struct Header_Slab* next;
+	Header_Node_t nodes[MEMPOOL_SLAB_HEADERS];
+}Header_Slab_t;
+
+static struct {
+	pthread_mutex_t lock;
+	Size_Class_t classes[MEMPOOL_MAX_CLASSES];
+	unsigned int num_classes;
+	uint64_t clock;
+	Header_Node_t* free_headers;
+	Header_Slab_t* slabs;
+	Mempool_Stats_t stats;
+}pool = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/*
+ * PURPOSE: buffer size in bytes for a number of elements, rounded up to the
+ *	alignment so equal shaped matrices land in the same class
+ * INPUTS:
+ *	elements number of unsigned ints
+ * RETURN:
+ *  the rounded byte count, never 0
+ *
+ **/
+static size_t class_bytes (size_t elements) {
+	size_t bytes = elements * sizeof(unsigned int);
+	if (bytes == 0) {
+		bytes = MEMPOOL_ALIGNMENT;
+	}
+	return (bytes + MEMPOOL_ALIGNMENT - 1) & ~((size_t) MEMPOOL_ALIGNMENT - 1);
+}
+
+/*
+ * PURPOSE: finds the class for a byte count, caller holds the lock
+ * INPUTS:
+ *	bytes rounded byte count
+ * RETURN:
+ *  the class or NULL when there is none for that size
+ *
+ **/
+static Size_Class_t* find_class (size_t bytes) {
+	for (unsigned int i = 0; i < pool.num_classes; ++i) {
+		if (pool.classes[i].bytes == bytes) {
+			return &pool.classes[i];
+		}
+	}
+	return NULL;
+}
+
+/*
+ * PURPOSE: a new buffer from the system, mapped when it is large enough
+ * INPUTS:
+ *	bytes rounded byte count
+ *  zeroed set to whether the buffer is known to hold only zeros
+ * RETURN:
+ *  the buffer, or NULL when it could not be allocated
+ *
+ **/
+static void* system_alloc (size_t bytes, bool* zeroed) {
+	void* buffer = NULL;
+	if (bytes >= MEMPOOL_MAP_BYTES) {
+		buffer = mmap(NULL,bytes,PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+		*zeroed = true;
+		return buffer == MAP_FAILED ? NULL : buffer;
+	}
+	*zeroed = false;
+	return posix_memalign(&buffer,MEMPOOL_ALIGNMENT,bytes) == 0 ? buffer : NULL;
+}
+
+/* gives a buffer of system_alloc back, bytes decides how it was allocated */
+static void system_free (void* buffer, size_t bytes) {
+	if (bytes >= MEMPOOL_MAP_BYTES) {
+		munmap(buffer,bytes);
+	}
+	else {
+		free(buffer);
+	}
+}
+
+/*
+ * PURPOSE: frees every buffer held by a class, caller holds the lock
+ * INPUTS:
+ *	c the class to empty
+ * RETURN:
+ *  nothing
+ *
+ **/
+static void drain_class (Size_Class_t* c) {
+	for (unsigned int i = 0; i < c->count; ++i) {
+		system_free(c->buffers[i],c->bytes);
+	}
+	pool.stats.buffers_retained -= c->count;
+	pool.stats.bytes_retained -= c->count * c->bytes;
+	c->count = 0;
+}
+
+/*
+ * PURPOSE: a zeroed Matrix_t header taken from the slab free list
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  the header, or NULL when a new slab could not be allocated
+ *
+ **/
+Matrix_t* mempool_header_alloc (void) {
+	pthread_mutex_lock(&pool.lock);
+	if (pool.free_headers == NULL) {
+		Header_Slab_t* slab = malloc(sizeof(Header_Slab_t));
+		if (!slab) {
+			pthread_mutex_unlock(&pool.lock);
+			return NULL;
+		}
+		slab->next = pool.slabs;
+		pool.slabs = slab;
+		pool.stats.header_slabs++;
+		for (int i = MEMPOOL_SLAB_HEADERS - 1; i >= 0; --i) {
+			slab->nodes[i].next = pool.free_headers;
+			pool.free_headers = &slab->nodes[i];
+		}
+		pool.stats.headers_free += MEMPOOL_SLAB_HEADERS;
+		pool.stats.header_misses++;
+	}
+	else {
+		pool.stats.header_hits++;
+	}
+	Header_Node_t* node = pool.free_headers;
+	pool.free_headers = node->next;
+	pool.stats.headers_free--;
+	pthread_mutex_unlock(&pool.lock);
+
+	memset(&node->matrix,0,sizeof(Matrix_t));
+	return &node->matrix;
+}
+
+/*
+ * PURPOSE: returns a header from mempool_header_alloc to the slab free list
+ * INPUTS:
+ *	m the header
+ * RETURN:
+ *  nothing
+ *
+ **/
+void mempool_header_free (Matrix_t* m) {
+	if (m == NULL) {
+		return;
+	}
+	Header_Node_t* node = (Header_Node_t*) m;
+	pthread_mutex_lock(&pool.lock);
+	node->next = pool.free_headers;
+	pool.free_headers = node;
+	pool.stats.headers_free++;
+	pthread_mutex_unlock(&pool.lock);
+}
+
+/*
+ * PURPOSE: a MEMPOOL_ALIGNMENT aligned data buffer, reusing a freed buffer of
+ *	the same size when one is retained
+ * INPUTS:
+ *	elements number of unsigned ints
+ *  zero return the buffer cleared; only reused buffers need a memset,
+ *	new large ones come zeroed from the kernel
+ * RETURN:
+ *  the buffer, or NULL when it could not be allocated
+ *
+ **/
+unsigned int* mempool_data_alloc (size_t elements, bool zero) {
+	if (elements > SIZE_MAX / sizeof(unsigned int) - MEMPOOL_ALIGNMENT) {
+		return NULL;
+	}
+	const size_t bytes = class_bytes(elements);
+	void* buffer = NULL;
+
+	pthread_mutex_lock(&pool.lock);
+	Size_Class_t* c = find_class(bytes);
+	if (c != NULL && c->count > 0) {
+		buffer = c->buffers[--c->count];
+		c->last_use = ++pool.clock;
+		pool.stats.buffers_retained--;
+		pool.stats.bytes_retained -= bytes;
+		pool.stats.data_hits++;
+	}
+	else {
+		pool.stats.data_misses++;
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	bool zeroed = false;
+	if (buffer == NULL) {
+		buffer = system_alloc(bytes,&zeroed);
+		if (buffer == NULL) {
+			return NULL;
+		}
+	}
+	if (zero && !zeroed) {
+		memset(buffer,0,bytes);
+	}
+	return buffer;
+}
+
+/*
+ * PURPOSE: gives a buffer from mempool_data_alloc back, it is kept for reuse
+ *	while its size class and the retained byte budget have room
+ * INPUTS:
+ *	data the buffer
+ *  elements the element count it was allocated with
+ * RETURN:
+ *  nothing
+ *
+ **/
+void mempool_data_free (unsigned int* data, size_t elements) {
+	if (data == NULL) {
+		return;
+	}
+	const size_t bytes = class_bytes(elements);
+
+	pthread_mutex_lock(&pool.lock);
+	if (bytes > MEMPOOL_MAX_RETAINED_BYTES - pool.stats.bytes_retained) {
+		pthread_mutex_unlock(&pool.lock);
+		system_free(data,bytes);
+		return;
+	}
+	Size_Class_t* c = find_class(bytes);
+	if (c == NULL) {
+		if (pool.num_classes < MEMPOOL_MAX_CLASSES) {
+			c = &pool.classes[pool.num_classes++];
+		}
+		else {
+			/* recycle the least recently used size */
+			c = &pool.classes[0];
+			for (unsigned int i = 1; i < pool.num_classes; ++i) {
+				if (pool.classes[i].last_use < c->last_use) {
+					c = &pool.classes[i];
+				}
+			}
+			drain_class(c);
+		}
+		c->bytes = bytes;
+		c->count = 0;
+	}
+	c->last_use = ++pool.clock;
+	if (c->count == MEMPOOL_MAX_PER_CLASS) {
+		pthread_mutex_unlock(&pool.lock);
+		system_free(data,bytes);
+		return;
+	}
+	c->buffers[c->count++] = data;
+	pool.stats.buffers_retained++;
+	pool.stats.bytes_retained += bytes;
+	pthread_mutex_unlock(&pool.lock);
+}
+
+/*
+ * PURPOSE: snapshot of the pool counters
+ * INPUTS:
+ *	stats where the counters are copied
+ * RETURN:
+ *  nothing
+ *
+ **/
+void mempool_get_stats (Mempool_Stats_t* stats) {
+	if (stats == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&pool.lock);
+	*stats = pool.stats;
+	pthread_mutex_unlock(&pool.lock);
+}
+
+/*
+ * PURPOSE: frees every retained data buffer, headers stay in their slabs
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  nothing
+ *
+ **/
+void mempool_trim (void) {
+	pthread_mutex_lock(&pool.lock);
+	for (unsigned int i = 0; i < pool.num_classes; ++i) {
+		drain_class(&pool.classes[i]);
+	}
+	pool.num_classes = 0;
+	pthread_mutex_unlock(&pool.lock);
+}
+
+/*
+ * PURPOSE: releases everything the pool holds, every header must already be
+ *	freed since the slabs go away
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  nothing
+ *
+ **/
+void mempool_destroy (void) {
+	mempool_trim();
+	pthread_mutex_lock(&pool.lock);
+	while (pool.slabs) {
+		Header_Slab_t* next = pool.slabs->next;
+		free(pool.slabs);
+		pool.slabs = next;
+	}
+	pool.free_headers = NULL;
+	pool.stats.headers_free = 0;
+	pool.stats.header_slabs = 0;
+	pthread_mutex_unlock(&pool.lock);
+}
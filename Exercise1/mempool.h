@@ -0,0 +1,32 @@
+#ifndef _MEMPOOL_H_
+#define _MEMPOOL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "matrix.h"
+
+/* every data buffer handed out is aligned to this many bytes */
+#define MEMPOOL_ALIGNMENT 64
+
+typedef struct {
+	uint64_t data_hits;
+	uint64_t data_misses;
+	uint64_t header_hits;
+	uint64_t header_misses;
+	size_t buffers_retained;
+	size_t bytes_retained;
+	size_t headers_free;
+	size_t header_slabs;
+}Mempool_Stats_t;
+
+Matrix_t* mempool_header_alloc (void);
+void mempool_header_free (Matrix_t* m);
+unsigned int* mempool_data_alloc (size_t elements, bool zero);
+void mempool_data_free (unsigned int* data, size_t elements);
+void mempool_get_stats (Mempool_Stats_t* stats);
+void mempool_trim (void);
+void mempool_destroy (void);
+
+#endif
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <errno.h>
+
+#include "message.h"
+
+/* where the messages of this thread go, NULL for stdout and stderr */
+static __thread FILE* thread_stream = NULL;
+
+/*
+ * PURPOSE: sends the messages of the calling thread to out
+ * INPUTS:
+ *	out stream for the messages, NULL to print them as usual again
+ * RETURN:
+ *  nothing
+ *
+ **/
+void message_set_stream (FILE* out) {
+	thread_stream = out;
+}
+
+/*
+ * PURPOSE: stream the messages of the calling thread go to
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  the stream set by message_set_stream, else NULL
+ *
+ **/
+FILE* message_stream (void) {
+	return thread_stream;
+}
+
+/*
+ * PURPOSE: printf to the message stream of the calling thread
+ * INPUTS:
+ *	format printf format
+ *  ... its arguments
+ * RETURN:
+ *  nothing
+ *
+ **/
+void message_printf (const char* format, ...) {
+	va_list args;
+	va_start(args,format);
+	vfprintf(thread_stream ? thread_stream : stdout,format,args);
+	va_end(args);
+}
+
+/*
+ * PURPOSE: perror to the message stream of the calling thread
+ * INPUTS:
+ *	what text printed before the description of errno
+ * RETURN:
+ *  nothing, errno is left as it was
+ *
+ **/
+void message_perror (const char* what) {
+	if (thread_stream == NULL) {
+		perror(what);
+		return;
+	}
+	const int saved = errno;
+	fprintf(thread_stream,"%s: %m\n", what);
+	errno = saved;
+}
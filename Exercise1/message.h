@@ -0,0 +1,14 @@
+#ifndef _MESSAGE_H_
+#define _MESSAGE_H_
+
+#include <stdio.h>
+
+/* messages of the matrix library go to the stream the calling thread set
+ * with message_set_stream, a server sets the reply of the request it runs;
+ * without one they are printed like printf and perror would */
+void message_set_stream (FILE* out);
+FILE* message_stream (void);
+void message_printf (const char* format, ...) __attribute__((format(printf,1,2)));
+void message_perror (const char* what);
+
+#endif
@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "netclient.h"
+#include "server.h"
+
+/*
+ * PURPOSE: connects to a matlab --serve socket
+ * INPUTS:
+ *	client connection to set up
+ *  socket_path path the server listens on
+ * RETURN:
+ *  If the connection was made then true
+ *  else false.
+ *
+ **/
+bool client_connect (Net_Client_t* client, const char* socket_path) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (client == NULL || socket_path == NULL){
+		printf("no client or socket to connect");
+		return false;
+	}
+
+	memset(client,0,sizeof(Net_Client_t));
+	client->fd = -1;
+	struct sockaddr_un addr;
+	memset(&addr,0,sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+		printf("socket path %s is too long\n", socket_path);
+		return false;
+	}
+	strcpy(addr.sun_path,socket_path);
+	const int fd = socket(AF_UNIX,SOCK_STREAM | SOCK_CLOEXEC,0);
+	if (fd < 0) {
+		perror("SOCKET");
+		return false;
+	}
+	if (connect(fd,(struct sockaddr*) &addr,sizeof(addr)) < 0) {
+		perror("CONNECT");
+		close(fd);
+		return false;
+	}
+	client->fd = fd;
+	return true;
+}
+
+/* sends all of buf, false when the server is gone */
+static bool send_fully (int fd, const char* buf, size_t len) {
+	while (len > 0) {
+		const ssize_t sent = send(fd,buf,len,MSG_NOSIGNAL);
+		if (sent < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		buf += sent;
+		len -= (size_t) sent;
+	}
+	return true;
+}
+
+/*
+ * PURPOSE: runs one command line on the server and waits for its reply
+ * INPUTS:
+ *	client connected client, the reply is left in client->reply
+ *  line command line without the trailing newline
+ *  ok set to whether the command succeeded
+ * RETURN:
+ *  If a complete reply arrived then true
+ *  else false when the connection failed.
+ *
+ **/
+bool client_request (Net_Client_t* client, const char* line, bool* ok) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (client == NULL || client->fd < 0 || line == NULL || ok == NULL){
+		printf("no connection or request");
+		return false;
+	}
+
+	const size_t line_len = strlen(line);
+	if (line_len >= SERVER_MAX_LINE || memchr(line,'\n',line_len) != NULL) {
+		printf("a request must be a single line shorter than %d bytes\n", SERVER_MAX_LINE);
+		return false;
+	}
+	if (!send_fully(client->fd,line,line_len) || !send_fully(client->fd,"\n",1)) {
+		perror("SEND");
+		return false;
+	}
+
+	/* the reply ends with SERVER_REPLY_END and one status byte, and nothing
+	 * follows it since only one request is in flight */
+	client->reply_len = 0;
+	for (;;) {
+		if (client->reply_len >= 2
+			&& client->reply[client->reply_len - 2] == SERVER_REPLY_END) {
+			break;
+		}
+		if (client->reply_cap - client->reply_len < 4096) {
+			const size_t cap = client->reply_cap ? client->reply_cap * 2 : 16384;
+			char* grown = realloc(client->reply,cap);
+			if (!grown) {
+				printf("out of memory\n");
+				return false;
+			}
+			client->reply = grown;
+			client->reply_cap = cap;
+		}
+		const ssize_t got = recv(client->fd,&client->reply[client->reply_len],
+			client->reply_cap - client->reply_len,0);
+		if (got < 0 && errno == EINTR) {
+			continue;
+		}
+		if (got <= 0) {
+			if (got < 0) {
+				perror("RECV");
+			}
+			return false;
+		}
+		client->reply_len += (size_t) got;
+	}
+	*ok = client->reply[client->reply_len - 1] == '0';
+	client->reply_len -= 2;
+	client->reply[client->reply_len] = '\0';
+	return true;
+}
+
+/*
+ * PURPOSE: closes the connection and frees the reply buffer
+ * INPUTS:
+ *	client connection to close
+ * RETURN:
+ *  nothing
+ *
+ **/
+void client_close (Net_Client_t* client) {
+	if (client == NULL) {
+		return;
+	}
+	if (client->fd >= 0) {
+		close(client->fd);
+	}
+	free(client->reply);
+	memset(client,0,sizeof(Net_Client_t));
+	client->fd = -1;
+}
@@ -0,0 +1,19 @@
+#ifndef _NETCLIENT_H_
+#define _NETCLIENT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* client side of the --serve protocol, see server.h */
+typedef struct {
+	int fd;
+	char* reply; /* output of the last request, NUL terminated */
+	size_t reply_len;
+	size_t reply_cap;
+}Net_Client_t;
+
+bool client_connect (Net_Client_t* client, const char* socket_path);
+bool client_request (Net_Client_t* client, const char* line, bool* ok);
+void client_close (Net_Client_t* client);
+
+#endif
@@ -0,0 +1,377 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "registry.h"
+#include "message.h"
+
+#define REGISTRY_MIN_CAPACITY 16
+/* grow once live entries plus tombstones pass 7/10 of the table */
+#define REGISTRY_MAX_LOAD_NUM 7
+#define REGISTRY_MAX_LOAD_DEN 10
+
+/* table_lock of a registry passed as const, taking a lock does not change its contents */
+#define TABLE_LOCK(reg) ((pthread_rwlock_t*) &(reg)->table_lock)
+
+/* marks a slot whose matrix was removed, probing continues past it */
+static Matrix_t tombstone;
+#define TOMBSTONE (&tombstone)
+
+/*
+ * PURPOSE: 64 bit FNV-1a hash of a matrix name
+ * INPUTS:
+ *	name NUL terminated matrix name
+ * RETURN:
+ *  the hash value
+ *
+ **/
+static uint64_t hash_name (const char* name) {
+	uint64_t h = 14695981039346656037ULL;
+	for (; *name; ++name) {
+		h ^= (unsigned char) *name;
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+/*
+ * PURPOSE: finds the slot holding name, or the slot where it would be inserted
+ * INPUTS:
+ *	reg the registry
+ *  name the matrix name
+ *  found set to true when the returned slot holds name
+ * RETURN:
+ *  slot index, the first tombstone on the probe path is preferred for inserts
+ *
+ **/
+static size_t probe (const Registry_t* reg, const char* name, bool* found) {
+	const size_t mask = reg->capacity - 1;
+	size_t i = hash_name(name) & mask;
+	size_t first_free = reg->capacity;
+	for (;;) {
+		Matrix_t* slot = reg->slots[i];
+		if (slot == NULL) {
+			*found = false;
+			return first_free < reg->capacity ? first_free : i;
+		}
+		if (slot == TOMBSTONE) {
+			if (first_free == reg->capacity) {
+				first_free = i;
+			}
+		}
+		else if (strncmp(slot->name,name,MATRIX_NAME_LEN) == 0) {
+			*found = true;
+			return i;
+		}
+		i = (i + 1) & mask;
+	}
+}
+
+/*
+ * PURPOSE: rehashes every live matrix into a table of new_capacity slots,
+ *	dropping tombstones
+ * INPUTS:
+ *	reg the registry
+ *  new_capacity power of two larger than the live count
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false and the registry is left unchanged.
+ *
+ **/
+static bool rehash (Registry_t* reg, size_t new_capacity) {
+	Matrix_t** old_slots = reg->slots;
+	const size_t old_capacity = reg->capacity;
+	Matrix_t** slots = calloc(new_capacity,sizeof(Matrix_t*));
+	if (!slots) {
+		return false;
+	}
+	reg->slots = slots;
+	reg->capacity = new_capacity;
+	reg->tombstones = 0;
+	for (size_t i = 0; i < old_capacity; ++i) {
+		if (old_slots[i] != NULL && old_slots[i] != TOMBSTONE) {
+			bool found = false;
+			reg->slots[probe(reg,old_slots[i]->name,&found)] = old_slots[i];
+		}
+	}
+	free(old_slots);
+	return true;
+}
+
+/*
+ * PURPOSE: sets up an empty registry
+ * INPUTS:
+ *	reg the registry to initialize
+ *  initial_capacity expected number of matrices, 0 for a small default
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+bool registry_init (Registry_t* reg, size_t initial_capacity) {
+	if (reg == NULL) {
+		message_printf("no registry to initialize");
+		return false;
+	}
+	size_t capacity = REGISTRY_MIN_CAPACITY;
+	while (capacity * REGISTRY_MAX_LOAD_NUM < initial_capacity * REGISTRY_MAX_LOAD_DEN) {
+		capacity <<= 1;
+	}
+	reg->slots = calloc(capacity,sizeof(Matrix_t*));
+	if (!reg->slots) {
+		return false;
+	}
+	reg->capacity = capacity;
+	reg->count = 0;
+	reg->tombstones = 0;
+	pthread_rwlock_init(&reg->table_lock,NULL);
+	for (unsigned int i = 0; i < REGISTRY_LOCK_STRIPES; ++i) {
+		pthread_rwlock_init(&reg->name_locks[i],NULL);
+	}
+	return true;
+}
+
+/*
+ * PURPOSE: destroys every matrix still registered and releases the table
+ * INPUTS:
+ *	reg the registry
+ * RETURN:
+ *  nothing
+ *
+ **/
+void registry_destroy (Registry_t* reg) {
+	if (reg == NULL || reg->slots == NULL) {
+		return;
+	}
+	for (size_t i = 0; i < reg->capacity; ++i) {
+		if (reg->slots[i] != NULL && reg->slots[i] != TOMBSTONE) {
+			destroy_matrix(&reg->slots[i]);
+		}
+	}
+	free(reg->slots);
+	reg->slots = NULL;
+	reg->capacity = 0;
+	reg->count = 0;
+	reg->tombstones = 0;
+	pthread_rwlock_destroy(&reg->table_lock);
+	for (unsigned int i = 0; i < REGISTRY_LOCK_STRIPES; ++i) {
+		pthread_rwlock_destroy(&reg->name_locks[i]);
+	}
+}
+
+/*
+ * PURPOSE: looks a matrix up by its exact name
+ * INPUTS:
+ *	reg the registry
+ *  name the matrix name
+ * RETURN:
+ *  the matrix, or NULL when no matrix has that name
+ *
+ **/
+Matrix_t* registry_find (const Registry_t* reg, const char* name) {
+	if (reg == NULL || name == NULL || reg->slots == NULL) {
+		return NULL;
+	}
+	pthread_rwlock_rdlock(TABLE_LOCK(reg));
+	bool found = false;
+	const size_t i = probe(reg,name,&found);
+	Matrix_t* m = found ? reg->slots[i] : NULL;
+	pthread_rwlock_unlock(TABLE_LOCK(reg));
+	return m;
+}
+
+/*
+ * PURPOSE: registers m under its name, a matrix already registered under the
+ *	same name is destroyed and replaced
+ * INPUTS:
+ *	reg the registry
+ *  m the matrix, owned by the registry afterwards
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false and m is still owned by the caller.
+ *
+ **/
+bool registry_insert (Registry_t* reg, Matrix_t* m) {
+	if (reg == NULL || m == NULL) {
+		message_printf("no matrix to register");
+		return false;
+	}
+	pthread_rwlock_wrlock(&reg->table_lock);
+	if ((reg->count + reg->tombstones + 1) * REGISTRY_MAX_LOAD_DEN > reg->capacity * REGISTRY_MAX_LOAD_NUM) {
+		/* only double when live entries need it, otherwise just sweep tombstones */
+		const size_t grown = (reg->count + 1) * REGISTRY_MAX_LOAD_DEN > reg->capacity * REGISTRY_MAX_LOAD_NUM / 2
+			? reg->capacity << 1 : reg->capacity;
+		if (!rehash(reg,grown)) {
+			pthread_rwlock_unlock(&reg->table_lock);
+			return false;
+		}
+	}
+	bool found = false;
+	const size_t i = probe(reg,m->name,&found);
+	if (found) {
+		if (reg->slots[i] != m) {
+			destroy_matrix(&reg->slots[i]);
+		}
+	}
+	else {
+		if (reg->slots[i] == TOMBSTONE) {
+			reg->tombstones--;
+		}
+		reg->count++;
+	}
+	reg->slots[i] = m;
+	pthread_rwlock_unlock(&reg->table_lock);
+	return true;
+}
+
+/*
+ * PURPOSE: unregisters and destroys the matrix with the given name
+ * INPUTS:
+ *	reg the registry
+ *  name the matrix name
+ * RETURN:
+ *  true when a matrix was removed, false when none had that name
+ *
+ **/
+bool registry_remove (Registry_t* reg, const char* name) {
+	if (reg == NULL || name == NULL || reg->slots == NULL) {
+		return false;
+	}
+	pthread_rwlock_wrlock(&reg->table_lock);
+	bool found = false;
+	const size_t i = probe(reg,name,&found);
+	if (found) {
+		destroy_matrix(&reg->slots[i]);
+		reg->slots[i] = TOMBSTONE;
+		reg->count--;
+		reg->tombstones++;
+	}
+	pthread_rwlock_unlock(&reg->table_lock);
+	return found;
+}
+
+/*
+ * PURPOSE: number of registered matrices
+ * INPUTS:
+ *	reg the registry
+ * RETURN:
+ *  the live count
+ *
+ **/
+size_t registry_count (const Registry_t* reg) {
+	if (reg == NULL) {
+		return 0;
+	}
+	pthread_rwlock_rdlock(TABLE_LOCK(reg));
+	const size_t count = reg->count;
+	pthread_rwlock_unlock(TABLE_LOCK(reg));
+	return count;
+}
+
+/*
+ * PURPOSE: calls visit once for every registered matrix, in table order;
+ *	visit must not insert into or remove from the registry
+ * INPUTS:
+ *	reg the registry
+ *  visit callback
+ *  arg passed through to visit
+ * RETURN:
+ *  nothing
+ *
+ **/
+void registry_foreach (const Registry_t* reg, Registry_Visit_t visit, void* arg) {
+	if (reg == NULL || visit == NULL || reg->slots == NULL) {
+		return;
+	}
+	pthread_rwlock_rdlock(TABLE_LOCK(reg));
+	for (size_t i = 0; i < reg->capacity; ++i) {
+		if (reg->slots[i] != NULL && reg->slots[i] != TOMBSTONE) {
+			visit(reg->slots[i],arg);
+		}
+	}
+	pthread_rwlock_unlock(TABLE_LOCK(reg));
+}
+
+/*
+ * PURPOSE: locks the names a caller is about to use, shared for matrices it
+ *	only reads and exclusive for matrices it writes, creates, replaces or
+ *	deletes. Names map onto REGISTRY_LOCK_STRIPES locks taken in index order,
+ *	so callers never deadlock; a name listed both ways is locked exclusive
+ * INPUTS:
+ *	reg the registry
+ *  held receives the locks taken, pass it to registry_unlock_names
+ *  names matrix names, need not be registered
+ *  exclusive per name, true to lock it for writing
+ *  count number of names
+ * RETURN:
+ *  nothing
+ *
+ **/
+void registry_lock_names (Registry_t* reg, Registry_Locks_t* held, const char* const* names,
+			const bool* exclusive, size_t count) {
+	signed char mode[REGISTRY_LOCK_STRIPES];
+	memset(mode,-1,sizeof(mode));
+	for (size_t i = 0; i < count; ++i) {
+		const unsigned int stripe = (hash_name(names[i]) >> 32) % REGISTRY_LOCK_STRIPES;
+		if (mode[stripe] < (signed char) exclusive[i]) {
+			mode[stripe] = exclusive[i];
+		}
+	}
+	held->count = 0;
+	for (unsigned int stripe = 0; stripe < REGISTRY_LOCK_STRIPES; ++stripe) {
+		if (mode[stripe] < 0) {
+			continue;
+		}
+		if (mode[stripe]) {
+			pthread_rwlock_wrlock(&reg->name_locks[stripe]);
+		}
+		else {
+			pthread_rwlock_rdlock(&reg->name_locks[stripe]);
+		}
+		held->stripes[held->count] = stripe;
+		held->exclusive[held->count++] = mode[stripe];
+	}
+}
+
+/*
+ * PURPOSE: locks every name, for callers that can not tell in advance which
+ *	matrices they will touch
+ * INPUTS:
+ *	reg the registry
+ *  held receives the locks taken, pass it to registry_unlock_names
+ *  exclusive true to lock every name for writing
+ * RETURN:
+ *  nothing
+ *
+ **/
+void registry_lock_all (Registry_t* reg, Registry_Locks_t* held, bool exclusive) {
+	held->count = 0;
+	for (unsigned int stripe = 0; stripe < REGISTRY_LOCK_STRIPES; ++stripe) {
+		if (exclusive) {
+			pthread_rwlock_wrlock(&reg->name_locks[stripe]);
+		}
+		else {
+			pthread_rwlock_rdlock(&reg->name_locks[stripe]);
+		}
+		held->stripes[held->count] = stripe;
+		held->exclusive[held->count++] = exclusive;
+	}
+}
+
+/*
+ * PURPOSE: releases the locks taken by registry_lock_names or registry_lock_all
+ * INPUTS:
+ *	reg the registry
+ *  held the locks, empty afterwards
+ * RETURN:
+ *  nothing
+ *
+ **/
+void registry_unlock_names (Registry_t* reg, Registry_Locks_t* held) {
+	while (held->count > 0) {
+		pthread_rwlock_unlock(&reg->name_locks[held->stripes[--held->count]]);
+	}
+}
@@ -0,0 +1,48 @@
+#ifndef _REGISTRY_H_
+#define _REGISTRY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <pthread.h>
+
+#include "matrix.h"
+
+/* reader/writer locks the matrix names are hashed onto, see registry_lock_names */
+#define REGISTRY_LOCK_STRIPES 64
+
+/* open addressing hash table of live matrices keyed by their name. table_lock
+ * guards the table itself for the length of one call; a caller sharing the
+ * registry between threads also holds the name locks of the matrices it uses
+ * for as long as it uses them */
+typedef struct {
+	Matrix_t** slots;
+	size_t capacity;
+	size_t count;
+	size_t tombstones;
+	pthread_rwlock_t table_lock;
+	pthread_rwlock_t name_locks[REGISTRY_LOCK_STRIPES];
+}Registry_t;
+
+/* name locks held by one caller, filled by registry_lock_names */
+typedef struct {
+	unsigned int count;
+	unsigned char stripes[REGISTRY_LOCK_STRIPES];
+	bool exclusive[REGISTRY_LOCK_STRIPES];
+}Registry_Locks_t;
+
+typedef void (*Registry_Visit_t) (Matrix_t* m, void* arg);
+
+bool registry_init (Registry_t* reg, size_t initial_capacity);
+void registry_destroy (Registry_t* reg);
+Matrix_t* registry_find (const Registry_t* reg, const char* name);
+bool registry_insert (Registry_t* reg, Matrix_t* m);
+bool registry_remove (Registry_t* reg, const char* name);
+size_t registry_count (const Registry_t* reg);
+void registry_foreach (const Registry_t* reg, Registry_Visit_t visit, void* arg);
+void registry_lock_names (Registry_t* reg, Registry_Locks_t* held, const char* const* names,
+			const bool* exclusive, size_t count);
+void registry_lock_all (Registry_t* reg, Registry_Locks_t* held, bool exclusive);
+void registry_unlock_names (Registry_t* reg, Registry_Locks_t* held);
+
+#endif
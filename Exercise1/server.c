@@ -0,0 +1,433 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "server.h"
+
+/*
+ * Unix domain socket server. The calling thread polls the listening socket
+ * and every idle client; a complete request line is handed to a worker pool,
+ * and the client is left out of the poll set until its reply is sent, so the
+ * requests of one client run in order while different clients run in
+ * parallel. Workers capture the handler output in memory and send it with
+ * the reply trailer in one go.
+ **/
+
+#define SERVER_BACKLOG 64
+
+typedef struct {
+	int fd;
+	char in[SERVER_MAX_LINE];
+	size_t len;
+	bool busy; /* a request of this client is queued or running */
+	bool hangup; /* the peer closed its side, drop it once idle */
+	bool rejected; /* sent a line too long, its input is dropped until it hangs up */
+}Server_Client_t;
+
+typedef struct Server_Job {
+	struct Server_Job* next;
+	Server_Client_t* client;
+	char* line;
+}Server_Job_t;
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t job_ready;
+	Server_Job_t* head;
+	Server_Job_t* tail;
+	bool stopping;
+	int wake[2]; /* written by workers and server_stop to interrupt poll */
+	Server_Handler_t handler;
+	void* arg;
+}srv = { .lock = PTHREAD_MUTEX_INITIALIZER, .job_ready = PTHREAD_COND_INITIALIZER,
+	.wake = { -1, -1 } };
+
+static volatile sig_atomic_t stop_requested = 0;
+
+/*
+ * PURPOSE: asks a running serve to return, safe to call from a signal handler
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  nothing
+ *
+ **/
+void server_stop (void) {
+	stop_requested = 1;
+	if (srv.wake[1] >= 0) {
+		const char c = 's';
+		if (write(srv.wake[1],&c,1) < 0) {
+			/* the pipe is full, poll wakes up anyway */
+		}
+	}
+}
+
+static void wake_poller (void) {
+	const char c = 'w';
+	if (write(srv.wake[1],&c,1) < 0) {
+		/* the pipe is full, poll wakes up anyway */
+	}
+}
+
+/* sends all of buf, false when the client is gone */
+static bool send_fully (int fd, const char* buf, size_t len) {
+	while (len > 0) {
+		const ssize_t sent = send(fd,buf,len,MSG_NOSIGNAL);
+		if (sent < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		buf += sent;
+		len -= (size_t) sent;
+	}
+	return true;
+}
+
+/*
+ * PURPOSE: runs queued requests until the server stops
+ * INPUTS:
+ *	arg unused
+ * RETURN:
+ *  NULL
+ *
+ **/
+static void* server_worker (void* arg) {
+	(void) arg;
+	pthread_mutex_lock(&srv.lock);
+	for (;;) {
+		while (srv.head == NULL && !srv.stopping) {
+			pthread_cond_wait(&srv.job_ready,&srv.lock);
+		}
+		if (srv.head == NULL) {
+			break;
+		}
+		Server_Job_t* job = srv.head;
+		srv.head = job->next;
+		if (srv.head == NULL) {
+			srv.tail = NULL;
+		}
+		pthread_mutex_unlock(&srv.lock);
+
+		char* reply = NULL;
+		size_t reply_len = 0;
+		FILE* out = open_memstream(&reply,&reply_len);
+		bool ok = false;
+		if (out != NULL) {
+			ok = srv.handler(job->line,out,srv.arg);
+			fputc(SERVER_REPLY_END,out);
+			fputc(ok ? '0' : '1',out);
+			fclose(out);
+			send_fully(job->client->fd,reply,reply_len);
+		}
+		else {
+			const char failed[] = { 'o', 'u', 't', ' ', 'o', 'f', ' ', 'm', 'e', 'm', 'o', 'r', 'y',
+				'\n', SERVER_REPLY_END, '1' };
+			send_fully(job->client->fd,failed,sizeof(failed));
+		}
+		free(reply);
+		free(job->line);
+
+		pthread_mutex_lock(&srv.lock);
+		job->client->busy = false;
+		free(job);
+		wake_poller();
+	}
+	pthread_mutex_unlock(&srv.lock);
+	return NULL;
+}
+
+/* queues the first complete line of an idle client, srv.lock held */
+static void dispatch_line (Server_Client_t* c) {
+	char* newline = memchr(c->in,'\n',c->len);
+	if (newline == NULL) {
+		if (c->len == sizeof(c->in) && !c->rejected) {
+			/* the line can not fit: fail it and close our side, but keep reading
+			 * until the peer closes, so the rest of the line it still sends can
+			 * not reset the connection before the reply is read */
+			char failed[128];
+			int len = snprintf(failed,sizeof(failed),"request line is longer than %d bytes\n",
+				SERVER_MAX_LINE - 1);
+			failed[len++] = SERVER_REPLY_END;
+			failed[len++] = '1';
+			send_fully(c->fd,failed,len);
+			shutdown(c->fd,SHUT_WR);
+			c->rejected = true;
+			c->len = 0;
+		}
+		return;
+	}
+	const size_t line_len = (size_t) (newline - c->in);
+	Server_Job_t* job = malloc(sizeof(Server_Job_t));
+	char* line = malloc(line_len + 1);
+	if (!job || !line) {
+		free(job);
+		free(line);
+		c->hangup = true;
+		return;
+	}
+	memcpy(line,c->in,line_len);
+	line[line_len] = '\0';
+	if (line_len > 0 && line[line_len - 1] == '\r') {
+		line[line_len - 1] = '\0';
+	}
+	c->len -= line_len + 1;
+	memmove(c->in,newline + 1,c->len);
+
+	if (strncmp(line,"exit",strlen("exit") + 1) == 0) {
+		free(job);
+		free(line);
+		c->hangup = true;
+		return;
+	}
+	job->next = NULL;
+	job->client = c;
+	job->line = line;
+	c->busy = true;
+	if (srv.tail) {
+		srv.tail->next = job;
+	}
+	else {
+		srv.head = job;
+	}
+	srv.tail = job;
+	pthread_cond_signal(&srv.job_ready);
+}
+
+/* reads what the client sent, false once it hung up; a full buffer is left
+ * for dispatch_line to take a line from or to reject */
+static bool read_client (Server_Client_t* c) {
+	if (c->len == sizeof(c->in)) {
+		return true;
+	}
+	const ssize_t got = read(c->fd,&c->in[c->len],sizeof(c->in) - c->len);
+	if (got < 0) {
+		return errno == EINTR || errno == EAGAIN;
+	}
+	if (got == 0) {
+		return false;
+	}
+	if (!c->rejected) {
+		c->len += (size_t) got;
+	}
+	return true;
+}
+
+static int open_listener (const char* socket_path) {
+	struct sockaddr_un addr;
+	memset(&addr,0,sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+		printf("socket path %s is too long\n", socket_path);
+		return -1;
+	}
+	strcpy(addr.sun_path,socket_path);
+	/* a socket file left by a previous run would make bind fail, anything
+	 * else at the path is not ours to remove */
+	struct stat st;
+	if (lstat(socket_path,&st) == 0) {
+		if (!S_ISSOCK(st.st_mode)) {
+			printf("%s exists and is not a socket\n", socket_path);
+			return -1;
+		}
+		unlink(socket_path);
+	}
+	const int fd = socket(AF_UNIX,SOCK_STREAM | SOCK_CLOEXEC,0);
+	if (fd < 0) {
+		perror("SOCKET");
+		return -1;
+	}
+	if (bind(fd,(struct sockaddr*) &addr,sizeof(addr)) < 0 || listen(fd,SERVER_BACKLOG) < 0) {
+		perror("BIND");
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/*
+ * PURPOSE: serves clients on a Unix domain socket until server_stop is called,
+ *	running every request line through handler on a pool of worker threads
+ * INPUTS:
+ *	socket_path path of the socket, a stale socket there is replaced but any
+ *	other file makes the server refuse to start; removed on return
+ *  workers number of requests run at once, at least 1
+ *  handler runs one request
+ *  arg passed through to handler
+ * RETURN:
+ *  If the server ran and stopped cleanly then true
+ *  else false when it could not start.
+ *
+ **/
+bool serve (const char* socket_path, unsigned int workers, Server_Handler_t handler, void* arg) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (socket_path == NULL || handler == NULL){
+		printf("no socket or handler to serve");
+		return false;
+	}
+	if (workers == 0) {
+		workers = 1;
+	}
+
+	const int listener = open_listener(socket_path);
+	if (listener < 0) {
+		return false;
+	}
+	if (pipe(srv.wake) < 0) {
+		perror("PIPE");
+		close(listener);
+		return false;
+	}
+	fcntl(srv.wake[0],F_SETFL,O_NONBLOCK);
+	fcntl(srv.wake[1],F_SETFL,O_NONBLOCK);
+	srv.handler = handler;
+	srv.arg = arg;
+	srv.stopping = false;
+
+	pthread_t* threads = calloc(workers,sizeof(pthread_t));
+	unsigned int started = 0;
+	while (threads && started < workers
+		&& pthread_create(&threads[started],NULL,server_worker,NULL) == 0) {
+		++started;
+	}
+	if (started == 0) {
+		printf("failed to start the server workers\n");
+		free(threads);
+		close(listener);
+		close(srv.wake[0]);
+		close(srv.wake[1]);
+		srv.wake[0] = srv.wake[1] = -1;
+		return false;
+	}
+	printf("serving on %s with %u workers\n", socket_path, started);
+	fflush(stdout);
+
+	Server_Client_t** clients = NULL;
+	size_t num_clients = 0;
+	size_t cap_clients = 0;
+	struct pollfd* fds = NULL;
+	Server_Client_t** polled = NULL;
+
+	while (!stop_requested) {
+		/* listener, wake pipe, then every idle client */
+		pthread_mutex_lock(&srv.lock);
+		size_t nfds = 2;
+		struct pollfd* grown = realloc(fds,(num_clients + 2) * sizeof(struct pollfd));
+		Server_Client_t** grown_polled = realloc(polled,(num_clients + 2) * sizeof(Server_Client_t*));
+		if (grown) {
+			fds = grown;
+		}
+		if (grown_polled) {
+			polled = grown_polled;
+		}
+		if (!grown || !grown_polled) {
+			pthread_mutex_unlock(&srv.lock);
+			break;
+		}
+		fds[0] = (struct pollfd) { .fd = listener, .events = POLLIN };
+		fds[1] = (struct pollfd) { .fd = srv.wake[0], .events = POLLIN };
+		for (size_t i = 0; i < num_clients; ++i) {
+			if (!clients[i]->busy) {
+				polled[nfds] = clients[i];
+				fds[nfds++] = (struct pollfd) { .fd = clients[i]->fd, .events = POLLIN };
+			}
+		}
+		pthread_mutex_unlock(&srv.lock);
+
+		if (poll(fds,nfds,-1) < 0 && errno != EINTR) {
+			perror("POLL");
+			break;
+		}
+		if (fds[1].revents & POLLIN) {
+			char drain[64];
+			while (read(srv.wake[0],drain,sizeof(drain)) > 0) {
+			}
+		}
+		if (fds[0].revents & POLLIN) {
+			const int fd = accept(listener,NULL,NULL);
+			if (fd >= 0) {
+				fcntl(fd,F_SETFD,FD_CLOEXEC);
+				Server_Client_t* c = calloc(1,sizeof(Server_Client_t));
+				if (num_clients == cap_clients) {
+					const size_t cap = cap_clients ? cap_clients * 2 : 16;
+					Server_Client_t** more = realloc(clients,cap * sizeof(Server_Client_t*));
+					if (more) {
+						clients = more;
+						cap_clients = cap;
+					}
+				}
+				if (c && num_clients < cap_clients) {
+					c->fd = fd;
+					clients[num_clients++] = c;
+				}
+				else {
+					free(c);
+					close(fd);
+				}
+			}
+		}
+
+		pthread_mutex_lock(&srv.lock);
+		for (size_t i = 2; i < nfds; ++i) {
+			if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+				if (!read_client(polled[i])) {
+					polled[i]->hangup = true;
+				}
+			}
+		}
+		/* start the next request of every idle client, drop idle hung up ones */
+		for (size_t i = 0; i < num_clients;) {
+			Server_Client_t* c = clients[i];
+			if (!c->busy) {
+				dispatch_line(c);
+			}
+			if (!c->busy && c->hangup) {
+				close(c->fd);
+				free(c);
+				clients[i] = clients[--num_clients];
+				continue;
+			}
+			++i;
+		}
+		pthread_mutex_unlock(&srv.lock);
+	}
+
+	/* let the queued requests finish, then stop the workers */
+	pthread_mutex_lock(&srv.lock);
+	srv.stopping = true;
+	pthread_cond_broadcast(&srv.job_ready);
+	pthread_mutex_unlock(&srv.lock);
+	for (unsigned int i = 0; i < started; ++i) {
+		pthread_join(threads[i],NULL);
+	}
+	free(threads);
+	for (size_t i = 0; i < num_clients; ++i) {
+		close(clients[i]->fd);
+		free(clients[i]);
+	}
+	free(clients);
+	free(fds);
+	free(polled);
+	close(listener);
+	unlink(socket_path);
+	close(srv.wake[0]);
+	close(srv.wake[1]);
+	srv.wake[0] = srv.wake[1] = -1;
+	stop_requested = 0;
+	return true;
+}
@@ -0,0 +1,18 @@
+#ifndef _SERVER_H_
+#define _SERVER_H_
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/* a request is one command line; the reply is the command output followed by
+ * SERVER_REPLY_END and then '0' when the command succeeded or '1' when not */
+#define SERVER_REPLY_END '\0'
+#define SERVER_MAX_LINE 4096
+
+/* runs one request line, writing its output to out, on a worker thread */
+typedef bool (*Server_Handler_t) (char* line, FILE* out, void* arg);
+
+bool serve (const char* socket_path, unsigned int workers, Server_Handler_t handler, void* arg);
+void server_stop (void);
+
+#endif
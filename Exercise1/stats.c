@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <pthread.h>
+
+#include "stats.h"
+#include "message.h"
+
+/* distinct command names tracked, later names are folded into "other" */
+#define STATS_MAX_COMMANDS 64
+#define STATS_NAME_LEN 24
+/* log-linear latency histogram: 8 buckets per power of two of nanoseconds */
+#define STATS_SUB_BUCKETS 8
+#define STATS_BUCKETS (64 * STATS_SUB_BUCKETS)
+
+typedef struct {
+	char name[STATS_NAME_LEN];
+	uint64_t count;
+	uint64_t total_ns;
+	uint64_t max_ns;
+	uint32_t buckets[STATS_BUCKETS];
+}Command_Stats_t;
+
+static struct {
+	pthread_mutex_t lock;
+	Command_Stats_t commands[STATS_MAX_COMMANDS];
+	unsigned int num_commands;
+	uint64_t bytes_allocated;
+	uint64_t bytes_freed;
+	uint64_t bytes_current;
+	uint64_t bytes_peak;
+}stats = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/*
+ * PURPOSE: current monotonic time, the clock every command is timed with
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  nanoseconds since an arbitrary start
+ *
+ **/
+uint64_t stats_now_ns (void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * PURPOSE: histogram bucket of a latency, exact below 8 ns and within 1/8
+ *	of the value above
+ * INPUTS:
+ *	ns latency
+ * RETURN:
+ *  bucket index
+ *
+ **/
+static unsigned int bucket_of (uint64_t ns) {
+	if (ns < STATS_SUB_BUCKETS) {
+		return (unsigned int) ns;
+	}
+	const unsigned int exponent = 63 - __builtin_clzll(ns);
+	const unsigned int sub = (ns >> (exponent - 3)) & (STATS_SUB_BUCKETS - 1);
+	return (exponent - 2) * STATS_SUB_BUCKETS + sub;
+}
+
+/*
+ * PURPOSE: largest latency that falls into a bucket
+ * INPUTS:
+ *	bucket index
+ * RETURN:
+ *  upper bound in nanoseconds
+ *
+ **/
+static uint64_t bucket_upper (unsigned int bucket) {
+	if (bucket < STATS_SUB_BUCKETS) {
+		return bucket;
+	}
+	const unsigned int exponent = bucket / STATS_SUB_BUCKETS + 2;
+	const uint64_t sub = bucket % STATS_SUB_BUCKETS;
+	return ((STATS_SUB_BUCKETS + sub + 1) << (exponent - 3)) - 1;
+}
+
+/*
+ * PURPOSE: latency at a percentile of one command, read from its histogram
+ * INPUTS:
+ *	c the command
+ *  percentile between 0 and 100
+ * RETURN:
+ *  the latency in nanoseconds, capped at the largest one seen
+ *
+ **/
+static uint64_t percentile_ns (const Command_Stats_t* c, double percentile) {
+	if (c->count == 0) {
+		return 0;
+	}
+	uint64_t rank = (uint64_t) (c->count * percentile / 100.0 + 0.5);
+	if (rank == 0) {
+		rank = 1;
+	}
+	uint64_t seen = 0;
+	for (unsigned int i = 0; i < STATS_BUCKETS; ++i) {
+		seen += c->buckets[i];
+		if (seen >= rank) {
+			const uint64_t upper = bucket_upper(i);
+			return upper < c->max_ns ? upper : c->max_ns;
+		}
+	}
+	return c->max_ns;
+}
+
+/*
+ * PURPOSE: adds one timed run of a command
+ * INPUTS:
+ *	name command name, the first token of the line
+ *  elapsed_ns how long it took
+ * RETURN:
+ *  nothing
+ *
+ **/
+void stats_record_command (const char* name, uint64_t elapsed_ns) {
+	if (name == NULL) {
+		return;
+	}
+	/* names end up in JSON, keep only characters that need no escaping */
+	char key[STATS_NAME_LEN];
+	memset(key,0,sizeof(key));
+	for (unsigned int i = 0; i < STATS_NAME_LEN - 1 && name[i]; ++i) {
+		const char ch = name[i];
+		const bool plain = (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z')
+			|| (ch >= '0' && ch <= '9') || ch == '_' || ch == '-';
+		key[i] = plain ? ch : '_';
+	}
+
+	pthread_mutex_lock(&stats.lock);
+	Command_Stats_t* c = NULL;
+	for (unsigned int i = 0; i < stats.num_commands; ++i) {
+		if (strncmp(stats.commands[i].name,key,STATS_NAME_LEN) == 0) {
+			c = &stats.commands[i];
+			break;
+		}
+	}
+	if (c == NULL) {
+		if (stats.num_commands < STATS_MAX_COMMANDS - 1) {
+			c = &stats.commands[stats.num_commands++];
+			memcpy(c->name,key,STATS_NAME_LEN);
+		}
+		else {
+			/* the last slot collects every name that did not fit */
+			c = &stats.commands[STATS_MAX_COMMANDS - 1];
+			strncpy(c->name,"other",STATS_NAME_LEN - 1);
+			stats.num_commands = STATS_MAX_COMMANDS;
+		}
+	}
+	c->count++;
+	c->total_ns += elapsed_ns;
+	if (elapsed_ns > c->max_ns) {
+		c->max_ns = elapsed_ns;
+	}
+	c->buckets[bucket_of(elapsed_ns)]++;
+	pthread_mutex_unlock(&stats.lock);
+}
+
+/*
+ * PURPOSE: counts matrix data coming into existence
+ * INPUTS:
+ *	bytes size of the data
+ * RETURN:
+ *  nothing
+ *
+ **/
+void stats_record_alloc (size_t bytes) {
+	__atomic_fetch_add(&stats.bytes_allocated,bytes,__ATOMIC_RELAXED);
+	const uint64_t current = __atomic_add_fetch(&stats.bytes_current,bytes,__ATOMIC_RELAXED);
+	uint64_t peak = __atomic_load_n(&stats.bytes_peak,__ATOMIC_RELAXED);
+	while (current > peak && !__atomic_compare_exchange_n(&stats.bytes_peak,&peak,current,
+		true,__ATOMIC_RELAXED,__ATOMIC_RELAXED)) {
+	}
+}
+
+/*
+ * PURPOSE: counts matrix data going away
+ * INPUTS:
+ *	bytes size of the data
+ * RETURN:
+ *  nothing
+ *
+ **/
+void stats_record_free (size_t bytes) {
+	__atomic_fetch_add(&stats.bytes_freed,bytes,__ATOMIC_RELAXED);
+	__atomic_fetch_sub(&stats.bytes_current,bytes,__ATOMIC_RELAXED);
+}
+
+/*
+ * PURPOSE: prints the per command latency table and matrix memory use
+ * INPUTS:
+ *	out stream to print to
+ * RETURN:
+ *  nothing
+ *
+ **/
+void stats_print (FILE* out) {
+	pthread_mutex_lock(&stats.lock);
+	fprintf(out,"%-16s %10s %14s %12s %12s %12s\n", "command", "count", "total_us",
+		"mean_us", "p50_us", "p99_us");
+	for (unsigned int i = 0; i < stats.num_commands; ++i) {
+		const Command_Stats_t* c = &stats.commands[i];
+		fprintf(out,"%-16s %10llu %14.1f %12.2f %12.2f %12.2f\n", c->name,
+			(unsigned long long) c->count, c->total_ns / 1e3,
+			c->count ? c->total_ns / 1e3 / c->count : 0.0,
+			percentile_ns(c,50) / 1e3, percentile_ns(c,99) / 1e3);
+	}
+	pthread_mutex_unlock(&stats.lock);
+	fprintf(out,"matrix memory: %llu bytes current, %llu bytes peak, %llu allocated, %llu freed\n",
+		(unsigned long long) __atomic_load_n(&stats.bytes_current,__ATOMIC_RELAXED),
+		(unsigned long long) __atomic_load_n(&stats.bytes_peak,__ATOMIC_RELAXED),
+		(unsigned long long) __atomic_load_n(&stats.bytes_allocated,__ATOMIC_RELAXED),
+		(unsigned long long) __atomic_load_n(&stats.bytes_freed,__ATOMIC_RELAXED));
+}
+
+/*
+ * PURPOSE: dumps the same numbers as stats_print as a JSON document
+ * INPUTS:
+ *	filename file to create or overwrite
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+bool stats_write_json (const char* filename) {
+	if (filename == NULL) {
+		message_printf("no stats output file");
+		return false;
+	}
+	FILE* out = fopen(filename,"w");
+	if (out == NULL) {
+		message_perror("FAILED TO OPEN STATS FILE\n");
+		return false;
+	}
+	fprintf(out,"{\n  \"commands\": [");
+	pthread_mutex_lock(&stats.lock);
+	for (unsigned int i = 0; i < stats.num_commands; ++i) {
+		const Command_Stats_t* c = &stats.commands[i];
+		fprintf(out,"%s\n    {\"name\": \"%s\", \"count\": %llu, \"total_ns\": %llu, "
+			"\"mean_ns\": %llu, \"p50_ns\": %llu, \"p99_ns\": %llu, \"max_ns\": %llu}",
+			i ? "," : "", c->name, (unsigned long long) c->count,
+			(unsigned long long) c->total_ns,
+			(unsigned long long) (c->count ? c->total_ns / c->count : 0),
+			(unsigned long long) percentile_ns(c,50), (unsigned long long) percentile_ns(c,99),
+			(unsigned long long) c->max_ns);
+	}
+	pthread_mutex_unlock(&stats.lock);
+	fprintf(out,"\n  ],\n  \"memory\": {\"current_bytes\": %llu, \"peak_bytes\": %llu, "
+		"\"allocated_bytes\": %llu, \"freed_bytes\": %llu}\n}\n",
+		(unsigned long long) __atomic_load_n(&stats.bytes_current,__ATOMIC_RELAXED),
+		(unsigned long long) __atomic_load_n(&stats.bytes_peak,__ATOMIC_RELAXED),
+		(unsigned long long) __atomic_load_n(&stats.bytes_allocated,__ATOMIC_RELAXED),
+		(unsigned long long) __atomic_load_n(&stats.bytes_freed,__ATOMIC_RELAXED));
+	if (fclose(out)) {
+		message_perror("FAILED TO WRITE STATS FILE\n");
+		return false;
+	}
+	return true;
+}
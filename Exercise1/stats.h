@@ -0,0 +1,16 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+uint64_t stats_now_ns (void);
+void stats_record_command (const char* name, uint64_t elapsed_ns);
+void stats_record_alloc (size_t bytes);
+void stats_record_free (size_t bytes);
+void stats_print (FILE* out);
+bool stats_write_json (const char* filename);
+
+#endif
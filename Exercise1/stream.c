@@ -0,0 +1,526 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "stream.h"
+#include "matrix.h"
+#include "kernels.h"
+#include "threadpool.h"
+#include "message.h"
+
+/*
+ * Out-of-core element-wise operations on raw matrix files. The data is
+ * streamed in blocks through STREAM_SLOTS buffer slots: a reader thread
+ * fills the next slot while the calling thread computes the current one on
+ * the worker pool and a writer thread drains the slot before it, so memory
+ * stays at STREAM_SLOTS blocks per operand whatever the matrix size.
+ **/
+
+#define STREAM_SLOTS 2
+
+typedef enum {
+	STREAM_ADD,
+	STREAM_SHIFT,
+	STREAM_SUM
+}Stream_Op_t;
+
+/* a slot cycles EMPTY -> LOADED (reader) -> COMPUTED (compute) -> EMPTY (writer) */
+typedef enum {
+	SLOT_EMPTY,
+	SLOT_LOADED,
+	SLOT_COMPUTED
+}Slot_State_t;
+
+typedef struct {
+	unsigned int* a;
+	unsigned int* b;
+	Slot_State_t state;
+}Stream_Slot_t;
+
+typedef struct {
+	Stream_Op_t op;
+	int in_a;
+	int in_b;
+	int out;
+	uint64_t a_offset;
+	uint64_t b_offset;
+	uint64_t out_offset;
+	size_t n;
+	size_t block;
+	size_t num_blocks;
+	char direction;
+	unsigned int shift;
+	uint64_t sum;
+
+	Stream_Slot_t slots[STREAM_SLOTS];
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	bool failed;
+	int error; /* errno of the thread that failed the stream first */
+}Stream_t;
+
+/*
+ * PURPOSE: pread or pwrite exactly len bytes, retrying short transfers and EINTR
+ * INPUTS:
+ *	fd file
+ *  buf data
+ *  len number of bytes
+ *  offset file offset
+ *  write true to write buf, false to read into it
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false, errno is EIO when a read hit the end of the file.
+ *
+ **/
+static bool transfer_fully (int fd, void* buf, size_t len, uint64_t offset, bool write) {
+	unsigned char* p = buf;
+	size_t done = 0;
+	while (done < len) {
+		const ssize_t n = write ? pwrite(fd,&p[done],len - done,offset + done)
+			: pread(fd,&p[done],len - done,offset + done);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		if (n == 0) {
+			errno = EIO;
+			return false;
+		}
+		done += n;
+	}
+	return true;
+}
+
+/*
+ * PURPOSE: waits until a slot reaches a state or the stream failed
+ * INPUTS:
+ *	s the stream
+ *  slot the slot
+ *  state the state to wait for
+ * RETURN:
+ *  true once the slot is in state, false when the stream failed
+ *
+ **/
+static bool wait_slot (Stream_t* s, Stream_Slot_t* slot, Slot_State_t state) {
+	pthread_mutex_lock(&s->lock);
+	while (slot->state != state && !s->failed) {
+		pthread_cond_wait(&s->changed,&s->lock);
+	}
+	const bool ok = !s->failed;
+	pthread_mutex_unlock(&s->lock);
+	return ok;
+}
+
+/*
+ * PURPOSE: moves a slot to its next state, or fails the whole stream
+ * INPUTS:
+ *	s the stream
+ *  slot the slot
+ *  state the new state
+ *  ok false to fail the stream instead, keeping the errno of the calling thread
+ * RETURN:
+ *  nothing
+ *
+ **/
+static void post_slot (Stream_t* s, Stream_Slot_t* slot, Slot_State_t state, bool ok) {
+	pthread_mutex_lock(&s->lock);
+	if (ok) {
+		slot->state = state;
+	}
+	else if (!s->failed) {
+		s->failed = true;
+		s->error = errno;
+	}
+	pthread_cond_broadcast(&s->changed);
+	pthread_mutex_unlock(&s->lock);
+}
+
+static size_t block_count (const Stream_t* s, size_t blk) {
+	const size_t first = blk * s->block;
+	return (s->n - first < s->block) ? s->n - first : s->block;
+}
+
+static void* reader_main (void* arg) {
+	Stream_t* s = arg;
+	for (size_t blk = 0; blk < s->num_blocks; ++blk) {
+		Stream_Slot_t* slot = &s->slots[blk % STREAM_SLOTS];
+		if (!wait_slot(s,slot,SLOT_EMPTY)) {
+			break;
+		}
+		const uint64_t first = (uint64_t) blk * s->block * sizeof(unsigned int);
+		const size_t bytes = block_count(s,blk) * sizeof(unsigned int);
+		bool ok = transfer_fully(s->in_a,slot->a,bytes,s->a_offset + first,false);
+		if (ok && slot->b) {
+			ok = transfer_fully(s->in_b,slot->b,bytes,s->b_offset + first,false);
+		}
+		/* each block is read once, keep it from pushing everything else out of the page cache */
+		posix_fadvise(s->in_a,s->a_offset + first,bytes,POSIX_FADV_DONTNEED);
+		if (slot->b) {
+			posix_fadvise(s->in_b,s->b_offset + first,bytes,POSIX_FADV_DONTNEED);
+		}
+		post_slot(s,slot,SLOT_LOADED,ok);
+	}
+	return NULL;
+}
+
+static void* writer_main (void* arg) {
+	Stream_t* s = arg;
+	for (size_t blk = 0; blk < s->num_blocks; ++blk) {
+		Stream_Slot_t* slot = &s->slots[blk % STREAM_SLOTS];
+		if (!wait_slot(s,slot,SLOT_COMPUTED)) {
+			break;
+		}
+		const uint64_t first = (uint64_t) blk * s->block * sizeof(unsigned int);
+		const bool ok = transfer_fully(s->out,slot->a,block_count(s,blk) * sizeof(unsigned int),
+			s->out_offset + first,true);
+		post_slot(s,slot,SLOT_EMPTY,ok);
+	}
+	return NULL;
+}
+
+/* the result of every operation lands in slot->a, which is what gets written */
+typedef struct {
+	const Stream_t* s;
+	unsigned int* a;
+	const unsigned int* b;
+	uint64_t sum;
+}Stream_Task_t;
+
+static void compute_task (size_t begin, size_t end, void* arg) {
+	Stream_Task_t* t = arg;
+	switch (t->s->op) {
+		case STREAM_ADD:
+			kernel_add(&t->a[begin],&t->b[begin],&t->a[begin],end - begin);
+			break;
+		case STREAM_SHIFT:
+			kernel_shift(&t->a[begin],end - begin,t->s->direction,t->s->shift);
+			break;
+		case STREAM_SUM:
+			__atomic_fetch_add(&t->sum,kernel_sum(&t->a[begin],end - begin),__ATOMIC_RELAXED);
+			break;
+	}
+}
+
+/*
+ * PURPOSE: opens a raw matrix file for streaming and checks it holds all of
+ *	its data
+ * INPUTS:
+ *	filename file to open
+ *  fd receives the descriptor
+ *  rows, cols receive the dimensions
+ *  data_offset receives the offset of element (0,0)
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false, the file is closed again.
+ *
+ **/
+static bool open_input (const char* filename, int* fd, size_t* rows, size_t* cols,
+			size_t* data_offset) {
+	*fd = open(filename,O_RDONLY);
+	if (*fd < 0) {
+		message_printf("FAILED TO OPEN %s FOR READING\n", filename);
+		message_perror("OPEN");
+		return false;
+	}
+	char name[MATRIX_NAME_LEN];
+	uint32_t flags = 0;
+	struct stat st;
+	if (!read_matrix_file_header(*fd,name,rows,cols,data_offset,&flags) || fstat(*fd,&st) < 0) {
+		close(*fd);
+		return false;
+	}
+	if (flags != 0) {
+		message_printf("%s IS COMPRESSED OR TILED, STREAMING NEEDS A RAW FILE\n", filename);
+		close(*fd);
+		return false;
+	}
+	if ((uint64_t) st.st_size < *data_offset
+		|| (uint64_t) st.st_size - *data_offset < (uint64_t) *rows * *cols * sizeof(unsigned int)) {
+		message_printf("FAILED TO READ MATRIX DATA OF %s\n", filename);
+		close(*fd);
+		return false;
+	}
+	posix_fadvise(*fd,0,0,POSIX_FADV_SEQUENTIAL);
+	return true;
+}
+
+/*
+ * PURPOSE: tells whether a path names the file already open as fd, so an
+ *	output never truncates one of the inputs
+ * INPUTS:
+ *	fd open input
+ *  filename output path
+ * RETURN:
+ *  true when both are the same file
+ *
+ **/
+static bool same_file (int fd, const char* filename) {
+	struct stat in, out;
+	if (fd < 0 || fstat(fd,&in) < 0 || stat(filename,&out) < 0) {
+		return false;
+	}
+	return in.st_dev == out.st_dev && in.st_ino == out.st_ino;
+}
+
+/*
+ * PURPOSE: creates the output file and writes its header and trailer, the
+ *	matrix is named after the last path component of the file
+ * INPUTS:
+ *	filename file to create or truncate
+ *  rows, cols dimensions of the result
+ *  fd receives the descriptor
+ *  data_offset receives the offset the data goes to
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+static bool create_output (const char* filename, size_t rows, size_t cols, int* fd,
+			uint64_t* data_offset) {
+	*fd = open(filename,O_CREAT | O_WRONLY | O_TRUNC,0644);
+	if (*fd < 0) {
+		message_printf("FAILED TO CREATE/OPEN %s FOR WRITING\n", filename);
+		message_perror("OPEN");
+		return false;
+	}
+	const char* name = strrchr(filename,'/');
+	name = name ? name + 1 : filename;
+	Matrix_File_Header_t header;
+	init_matrix_file_header(&header,name,rows,cols,0);
+	*data_offset = header.header_len;
+	unsigned char trailer = EOF;
+	if (!transfer_fully(*fd,&header,sizeof(header),0,true)
+		|| !transfer_fully(*fd,&trailer,sizeof(trailer),*data_offset + (uint64_t) rows * cols * sizeof(unsigned int),true)) {
+		message_printf("FAILED TO WRITE MATRIX TO FILE\n");
+		message_perror("WRITE");
+		close(*fd);
+		return false;
+	}
+	return true;
+}
+
+/*
+ * PURPOSE: runs a prepared stream: starts the reader and writer threads,
+ *	computes every block as it arrives and waits for both threads
+ * INPUTS:
+ *	s stream with its files, offsets, sizes and operation set
+ *  block_bytes block size in bytes, 0 for STREAM_DEFAULT_BLOCK_BYTES
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+static bool run_stream (Stream_t* s, size_t block_bytes) {
+	if (block_bytes == 0) {
+		block_bytes = STREAM_DEFAULT_BLOCK_BYTES;
+	}
+	s->block = block_bytes / sizeof(unsigned int);
+	if (s->block < 1024) {
+		s->block = 1024;
+	}
+	s->num_blocks = (s->n + s->block - 1) / s->block;
+	pthread_mutex_init(&s->lock,NULL);
+	pthread_cond_init(&s->changed,NULL);
+
+	bool ok = true;
+	for (unsigned int i = 0; i < STREAM_SLOTS; ++i) {
+		void* a = NULL;
+		void* b = NULL;
+		ok = ok && posix_memalign(&a,64,s->block * sizeof(unsigned int)) == 0;
+		ok = ok && (s->op != STREAM_ADD || posix_memalign(&b,64,s->block * sizeof(unsigned int)) == 0);
+		s->slots[i].a = a;
+		s->slots[i].b = b;
+		s->slots[i].state = SLOT_EMPTY;
+	}
+	pthread_t reader;
+	pthread_t writer;
+	bool reader_started = false;
+	bool writer_started = false;
+	if (!ok) {
+		message_printf("FAILED TO ALLOCATE STREAM BUFFERS\n");
+	}
+	else {
+		reader_started = pthread_create(&reader,NULL,reader_main,s) == 0;
+		writer_started = s->out < 0 || pthread_create(&writer,NULL,writer_main,s) == 0;
+		if (!reader_started || !writer_started) {
+			message_printf("FAILED TO START STREAM THREADS\n");
+			/* pthread_create only fails here for lack of resources */
+			errno = EAGAIN;
+			post_slot(s,&s->slots[0],SLOT_EMPTY,false);
+		}
+	}
+
+	for (size_t blk = 0; ok && blk < s->num_blocks; ++blk) {
+		Stream_Slot_t* slot = &s->slots[blk % STREAM_SLOTS];
+		if (!wait_slot(s,slot,SLOT_LOADED)) {
+			break;
+		}
+		Stream_Task_t task = { .s = s, .a = slot->a, .b = slot->b };
+		parallel_for(block_count(s,blk),sizeof(unsigned int),compute_task,&task);
+		s->sum += task.sum;
+		post_slot(s,slot,s->out < 0 ? SLOT_EMPTY : SLOT_COMPUTED,true);
+	}
+
+	if (reader_started) {
+		pthread_join(reader,NULL);
+	}
+	if (writer_started && s->out >= 0) {
+		pthread_join(writer,NULL);
+	}
+	if (s->failed) {
+		message_printf("FAILED TO STREAM MATRIX DATA\n");
+		/* errno is per thread, the failure happened in the reader or writer */
+		errno = s->error;
+		message_perror("STREAM");
+		ok = false;
+	}
+	for (unsigned int i = 0; i < STREAM_SLOTS; ++i) {
+		free(s->slots[i].a);
+		free(s->slots[i].b);
+	}
+	pthread_cond_destroy(&s->changed);
+	pthread_mutex_destroy(&s->lock);
+	return ok;
+}
+
+/*
+ * PURPOSE: out = a + b for two raw matrix files without loading either
+ * INPUTS:
+ *	a_filename, b_filename matrices of the same dimensions
+ *  out_filename result file, created or truncated
+ *  block_bytes bytes per operand per block, 0 for the default
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+bool add_files (const char* a_filename, const char* b_filename, const char* out_filename,
+			size_t block_bytes) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (a_filename == NULL || b_filename == NULL || out_filename == NULL) {
+		message_printf("missing file name to add");
+		return false;
+	}
+	Stream_t s = { .op = STREAM_ADD, .in_a = -1, .in_b = -1, .out = -1 };
+	size_t a_rows, a_cols, b_rows, b_cols, a_offset, b_offset;
+	if (!open_input(a_filename,&s.in_a,&a_rows,&a_cols,&a_offset)) {
+		return false;
+	}
+	if (!open_input(b_filename,&s.in_b,&b_rows,&b_cols,&b_offset)) {
+		close(s.in_a);
+		return false;
+	}
+	bool ok = true;
+	if (a_rows != b_rows || a_cols != b_cols) {
+		message_printf("matrices have different dimensions\n");
+		ok = false;
+	}
+	if (ok && (same_file(s.in_a,out_filename) || same_file(s.in_b,out_filename))) {
+		message_printf("the output file can not be one of the inputs\n");
+		ok = false;
+	}
+	ok = ok && create_output(out_filename,a_rows,a_cols,&s.out,&s.out_offset);
+	if (ok) {
+		s.a_offset = a_offset;
+		s.b_offset = b_offset;
+		s.n = a_rows * a_cols;
+		ok = run_stream(&s,block_bytes);
+		if (close(s.out)) {
+			ok = false;
+		}
+	}
+	close(s.in_a);
+	close(s.in_b);
+	return ok;
+}
+
+/*
+ * PURPOSE: writes a shifted copy of a raw matrix file without loading it
+ * INPUTS:
+ *	in_filename matrix to shift
+ *  out_filename result file, created or truncated
+ *  direction 'l' for left, anything else for right
+ *  shift number of bits
+ *  block_bytes bytes per block, 0 for the default
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+bool shift_file (const char* in_filename, const char* out_filename, char direction,
+			unsigned int shift, size_t block_bytes) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (in_filename == NULL || out_filename == NULL) {
+		message_printf("missing file name to shift");
+		return false;
+	}
+	Stream_t s = { .op = STREAM_SHIFT, .in_a = -1, .in_b = -1, .out = -1,
+		.direction = direction, .shift = shift };
+	size_t rows, cols, offset;
+	if (!open_input(in_filename,&s.in_a,&rows,&cols,&offset)) {
+		return false;
+	}
+	if (same_file(s.in_a,out_filename)) {
+		message_printf("the output file can not be the input\n");
+		close(s.in_a);
+		return false;
+	}
+	bool ok = create_output(out_filename,rows,cols,&s.out,&s.out_offset);
+	if (ok) {
+		s.a_offset = offset;
+		s.n = rows * cols;
+		ok = run_stream(&s,block_bytes);
+		if (close(s.out)) {
+			ok = false;
+		}
+	}
+	close(s.in_a);
+	return ok;
+}
+
+/*
+ * PURPOSE: sum of every element of a raw matrix file without loading it
+ * INPUTS:
+ *	in_filename matrix to sum
+ *  sum where the 64 bit total is stored
+ *  block_bytes bytes per block, 0 for the default
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+bool sum_file (const char* in_filename, uint64_t* sum, size_t block_bytes) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (in_filename == NULL || sum == NULL) {
+		message_printf("missing file name or sum to store");
+		return false;
+	}
+	Stream_t s = { .op = STREAM_SUM, .in_a = -1, .in_b = -1, .out = -1 };
+	size_t rows, cols, offset;
+	if (!open_input(in_filename,&s.in_a,&rows,&cols,&offset)) {
+		return false;
+	}
+	s.a_offset = offset;
+	s.n = rows * cols;
+	const bool ok = run_stream(&s,block_bytes);
+	close(s.in_a);
+	if (ok) {
+		*sum = s.sum;
+	}
+	return ok;
+}
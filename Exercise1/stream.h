@@ -0,0 +1,17 @@
+#ifndef _STREAM_H_
+#define _STREAM_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* block size used when a caller passes 0 */
+#define STREAM_DEFAULT_BLOCK_BYTES ((size_t) 16 << 20)
+
+bool add_files (const char* a_filename, const char* b_filename, const char* out_filename,
+			size_t block_bytes);
+bool shift_file (const char* in_filename, const char* out_filename, char direction,
+			unsigned int shift, size_t block_bytes);
+bool sum_file (const char* in_filename, uint64_t* sum, size_t block_bytes);
+
+#endif
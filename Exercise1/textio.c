@@ -0,0 +1,409 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "textio.h"
+#include "matrix.h"
+#include "threadpool.h"
+#include "message.h"
+
+/*
+ * Text conversion of matrices. Numbers are formatted two digits at a time
+ * from a table instead of through printf. CSV export formats batches of
+ * rows on the worker pool into fixed size slots, packs them and writes each
+ * batch with one write. CSV import maps the file and splits it into blocks
+ * of CSV_BLOCK_BYTES; a line belongs to the block holding its first byte.
+ * One parallel pass counts the rows of every block, their prefix sums give
+ * the first row of each block, and a second pass parses every block into
+ * place.
+ **/
+
+/* bytes of the file per unit of work of read_matrix_csv */
+#define CSV_BLOCK_BYTES (256u << 10)
+/* text formatted per write of write_matrix_csv */
+#define CSV_BATCH_BYTES (16u << 20)
+
+static const char digit_pairs[201] =
+	"0001020304050607080910111213141516171819"
+	"2021222324252627282930313233343536373839"
+	"4041424344454647484950515253545556575859"
+	"6061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+/* writes x in decimal to out without a terminator, returns its length */
+static inline size_t format_u32 (unsigned int x, char* out) {
+	char tmp[10];
+	char* p = tmp + sizeof(tmp);
+	while (x >= 100) {
+		const unsigned int q = x / 100;
+		p -= 2;
+		memcpy(p,&digit_pairs[(x - q * 100) * 2],2);
+		x = q;
+	}
+	if (x >= 10) {
+		p -= 2;
+		memcpy(p,&digit_pairs[x * 2],2);
+	}
+	else {
+		*--p = (char) ('0' + x);
+	}
+	const size_t len = (size_t) (tmp + sizeof(tmp) - p);
+	memcpy(out,p,len);
+	return len;
+}
+
+/*
+ * PURPOSE: formats n values in decimal, each followed by sep
+ * INPUTS:
+ *	values : the values
+ *  n : number of values
+ *  sep : character written after every value
+ *  out : room for n * TEXT_U32_MAX_CHARS characters, not terminated
+ * RETURN:
+ *  number of characters written
+ *
+ **/
+size_t text_format_u32s (const unsigned int* values, size_t n, char sep, char* out) {
+	char* p = out;
+	for (size_t i = 0; i < n; ++i) {
+		p += format_u32(values[i],p);
+		*p++ = sep;
+	}
+	return (size_t) (p - out);
+}
+
+/* arguments of the export tasks, every task formats the rows starting inside
+ * its [begin,end) element range into their row_max sized slots */
+typedef struct {
+	const unsigned int* data;
+	size_t cols;
+	char* out;
+	size_t row_max;
+	size_t* lengths;
+}Csv_Format_Task_t;
+
+static void format_task (size_t begin, size_t end, void* arg) {
+	Csv_Format_Task_t* t = arg;
+	const size_t first = (begin + t->cols - 1) / t->cols;
+	const size_t last = (end + t->cols - 1) / t->cols;
+	for (size_t r = first; r < last; ++r) {
+		char* slot = &t->out[r * t->row_max];
+		const size_t len = text_format_u32s(&t->data[r * t->cols],t->cols,',',slot);
+		/* the separator after the last value ends the line */
+		slot[len - 1] = '\n';
+		t->lengths[r] = len;
+	}
+}
+
+static bool write_fully (int fd, const char* buf, size_t len) {
+	while (len > 0) {
+		const ssize_t written = write(fd,buf,len);
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		buf += written;
+		len -= (size_t) written;
+	}
+	return true;
+}
+
+/*
+ * PURPOSE: writes a matrix as CSV text, one line of comma separated values
+ *	per row
+ * INPUTS:
+ *	filename : output file, replaced if it exists
+ *  m : matrix to write
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+bool write_matrix_csv (const char* filename, Matrix_t* m) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (filename == NULL){
+		message_printf("the output file");
+		return false;
+	}
+	if (m == NULL){
+		message_printf("the matrix to be written");
+		return false;
+	}
+	if (m->rows == 0 || m->cols == 0) {
+		message_printf("Matrix (%s) has no elements to export\n", m->name);
+		return false;
+	}
+	if (m->cols > (SIZE_MAX / 2) / TEXT_U32_MAX_CHARS) {
+		message_printf("matrix rows are too long");
+		return false;
+	}
+
+	const size_t row_max = m->cols * TEXT_U32_MAX_CHARS;
+	size_t batch_rows = CSV_BATCH_BYTES / row_max;
+	if (batch_rows == 0) {
+		batch_rows = 1;
+	}
+	if (batch_rows > m->rows) {
+		batch_rows = m->rows;
+	}
+	char* text = malloc(batch_rows * row_max);
+	size_t* lengths = malloc(batch_rows * sizeof(size_t));
+	if (!text || !lengths) {
+		message_printf("no memory to format the matrix");
+		free(text);
+		free(lengths);
+		return false;
+	}
+	const int fd = open(filename,O_CREAT | O_WRONLY | O_TRUNC,0644);
+	if (fd < 0) {
+		message_printf("FAILED TO CREATE/OPEN FILE FOR WRITING\n");
+		message_perror("OPEN");
+		free(text);
+		free(lengths);
+		return false;
+	}
+
+	bool ok = true;
+	for (size_t first = 0; ok && first < m->rows; first += batch_rows) {
+		const size_t rows = m->rows - first < batch_rows ? m->rows - first : batch_rows;
+		Csv_Format_Task_t task = { .data = &m->data[first * m->cols], .cols = m->cols,
+			.out = text, .row_max = row_max, .lengths = lengths };
+		parallel_for(rows * m->cols,sizeof(unsigned int),format_task,&task);
+		/* pack the slots into one run of text */
+		size_t len = 0;
+		for (size_t r = 0; r < rows; ++r) {
+			memmove(&text[len],&text[r * row_max],lengths[r]);
+			len += lengths[r];
+		}
+		ok = write_fully(fd,text,len);
+	}
+	if (!ok) {
+		message_printf("FAILED TO WRITE MATRIX TO FILE\n");
+		message_perror("WRITE");
+	}
+	if (close(fd)) {
+		ok = false;
+	}
+	free(text);
+	free(lengths);
+	return ok;
+}
+
+/* arguments of the import tasks, every task handles the blocks that start
+ * inside its [begin,end) byte range */
+typedef struct {
+	const char* text;
+	size_t len;
+	size_t cols;
+	size_t* block_rows; /* rows starting in each block, then the first row of each block */
+	unsigned int* data;
+	size_t bad_row; /* lowest row that failed to parse, SIZE_MAX when none */
+}Csv_Parse_Task_t;
+
+/* true when no value starts at p, the line is empty */
+static bool blank_line (const char* text, size_t len, size_t p) {
+	return text[p] == '\n' || (text[p] == '\r' && (p + 1 == len || text[p + 1] == '\n'));
+}
+
+/* position of the first line starting at or after p */
+static size_t first_line (const char* text, size_t len, size_t p) {
+	if (p == 0 || text[p - 1] == '\n') {
+		return p;
+	}
+	const char* newline = memchr(&text[p],'\n',len - p);
+	return newline ? (size_t) (newline - text) + 1 : len;
+}
+
+/* position after the line starting at p */
+static size_t next_line (const char* text, size_t len, size_t p) {
+	const char* newline = memchr(&text[p],'\n',len - p);
+	return newline ? (size_t) (newline - text) + 1 : len;
+}
+
+/* parses the cols values of the line starting at p into out */
+static bool parse_line (const char* p, const char* eof, size_t cols, unsigned int* out) {
+	for (size_t j = 0; j < cols; ++j) {
+		while (p < eof && (*p == ' ' || *p == '\t')) {
+			++p;
+		}
+		const char* digits = p;
+		uint64_t value = 0;
+		while (p < eof && (unsigned int) (*p - '0') < 10 && p - digits < 10) {
+			value = value * 10 + (unsigned int) (*p - '0');
+			++p;
+		}
+		if (p == digits || value > UINT_MAX || (p < eof && (unsigned int) (*p - '0') < 10)) {
+			return false;
+		}
+		out[j] = (unsigned int) value;
+		while (p < eof && (*p == ' ' || *p == '\t')) {
+			++p;
+		}
+		if (j + 1 < cols) {
+			if (p == eof || *p != ',') {
+				return false;
+			}
+			++p;
+		}
+	}
+	if (p < eof && *p == '\r') {
+		++p;
+	}
+	return p == eof || *p == '\n';
+}
+
+static void count_task (size_t begin, size_t end, void* arg) {
+	Csv_Parse_Task_t* t = arg;
+	for (size_t b = (begin + CSV_BLOCK_BYTES - 1) / CSV_BLOCK_BYTES;
+		b < (end + CSV_BLOCK_BYTES - 1) / CSV_BLOCK_BYTES; ++b) {
+		const size_t block_end = (b + 1) * CSV_BLOCK_BYTES < t->len ? (b + 1) * CSV_BLOCK_BYTES : t->len;
+		size_t rows = 0;
+		for (size_t p = first_line(t->text,t->len,b * CSV_BLOCK_BYTES); p < block_end;
+			p = next_line(t->text,t->len,p)) {
+			rows += !blank_line(t->text,t->len,p);
+		}
+		t->block_rows[b] = rows;
+	}
+}
+
+static void parse_task (size_t begin, size_t end, void* arg) {
+	Csv_Parse_Task_t* t = arg;
+	for (size_t b = (begin + CSV_BLOCK_BYTES - 1) / CSV_BLOCK_BYTES;
+		b < (end + CSV_BLOCK_BYTES - 1) / CSV_BLOCK_BYTES; ++b) {
+		const size_t block_end = (b + 1) * CSV_BLOCK_BYTES < t->len ? (b + 1) * CSV_BLOCK_BYTES : t->len;
+		size_t row = t->block_rows[b];
+		for (size_t p = first_line(t->text,t->len,b * CSV_BLOCK_BYTES); p < block_end;
+			p = next_line(t->text,t->len,p)) {
+			if (blank_line(t->text,t->len,p)) {
+				continue;
+			}
+			if (!parse_line(&t->text[p],&t->text[t->len],t->cols,&t->data[row * t->cols])) {
+				size_t seen = __atomic_load_n(&t->bad_row,__ATOMIC_RELAXED);
+				while (row < seen && !__atomic_compare_exchange_n(&t->bad_row,&seen,row,true,
+					__ATOMIC_RELAXED,__ATOMIC_RELAXED)) {
+				}
+				break;
+			}
+			++row;
+		}
+	}
+}
+
+/*
+ * PURPOSE: reads a CSV file of unsigned integers, one row per line and the
+ *	same number of comma separated values on every line, into a new matrix;
+ *	empty lines are skipped
+ * INPUTS:
+ *	filename : CSV file
+ *  name : name of the new matrix
+ *  m : where the new matrix is stored
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false for an error in the process.
+ *
+ **/
+bool read_matrix_csv (const char* filename, const char* name, Matrix_t** m) {
+
+	// ERROR CHECK INCOMING PARAMETERS
+	if (filename == NULL || name == NULL){
+		message_printf("no matrix input file or name");
+		return false;
+	}
+	if (m == NULL){
+		message_printf("no matrix will input");
+		return false;
+	}
+
+	const int fd = open(filename,O_RDONLY);
+	if (fd < 0) {
+		message_printf("FAILED TO OPEN FOR READING\n");
+		message_perror("OPEN");
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd,&st) < 0) {
+		message_perror("FAILED TO STAT FILE\n");
+		close(fd);
+		return false;
+	}
+	const size_t len = st.st_size;
+	if (len == 0) {
+		message_printf("%s is empty\n", filename);
+		close(fd);
+		return false;
+	}
+	const char* text = mmap(NULL,len,PROT_READ,MAP_PRIVATE,fd,0);
+	/* the mapping keeps its own reference to the file */
+	close(fd);
+	if (text == MAP_FAILED) {
+		message_perror("FAILED TO MAP FILE\n");
+		return false;
+	}
+	madvise((void*) text,len,MADV_SEQUENTIAL);
+
+	/* the first line with values gives the number of columns */
+	size_t p = 0;
+	while (p < len && blank_line(text,len,p)) {
+		p = next_line(text,len,p);
+	}
+	size_t cols = 0;
+	if (p < len) {
+		const size_t end = next_line(text,len,p);
+		cols = 1;
+		for (size_t i = p; i < end; ++i) {
+			cols += text[i] == ',';
+		}
+	}
+	const size_t num_blocks = (len + CSV_BLOCK_BYTES - 1) / CSV_BLOCK_BYTES;
+	Csv_Parse_Task_t task = { .text = text, .len = len, .cols = cols, .bad_row = SIZE_MAX };
+	task.block_rows = malloc(num_blocks * sizeof(size_t));
+	if (!task.block_rows) {
+		message_printf("no memory to index the file");
+		munmap((void*) text,len);
+		return false;
+	}
+	parallel_for(len,1,count_task,&task);
+	size_t rows = 0;
+	for (size_t b = 0; b < num_blocks; ++b) {
+		const size_t block = task.block_rows[b];
+		task.block_rows[b] = rows;
+		rows += block;
+	}
+	if (rows == 0) {
+		message_printf("%s holds no values\n", filename);
+		free(task.block_rows);
+		munmap((void*) text,len);
+		return false;
+	}
+
+	bool ok = create_matrix(m,name,rows,cols);
+	if (ok) {
+		task.data = (*m)->data;
+		parallel_for(len,1,parse_task,&task);
+		if (task.bad_row != SIZE_MAX) {
+			message_printf("%s: row %zu is not %zu comma separated unsigned integers\n", filename,
+				task.bad_row + 1, cols);
+			destroy_matrix(m);
+			ok = false;
+		}
+		else {
+			touch_matrix(*m);
+		}
+	}
+	free(task.block_rows);
+	munmap((void*) text,len);
+	return ok;
+}
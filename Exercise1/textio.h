@@ -0,0 +1,16 @@
+#ifndef _TEXTIO_H_
+#define _TEXTIO_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "matrix.h"
+
+/* most characters text_format_u32s writes per element */
+#define TEXT_U32_MAX_CHARS 11
+
+size_t text_format_u32s (const unsigned int* values, size_t n, char sep, char* out);
+bool write_matrix_csv (const char* filename, Matrix_t* m);
+bool read_matrix_csv (const char* filename, const char* name, Matrix_t** m);
+
+#endif
@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "threadpool.h"
+
+#define CACHE_LINE_SIZE 64
+/* chunks handed out per thread so uneven cores can steal the remainder */
+#define CHUNKS_PER_THREAD 4
+
+typedef struct {
+	pthread_t* workers;
+	unsigned int num_threads;
+	pthread_mutex_t lock;
+	pthread_cond_t work_ready;
+	pthread_cond_t work_done;
+	pthread_mutex_t dispatch;
+	unsigned long generation;
+	bool shutting_down;
+	unsigned int active;
+
+	Parallel_Task_t task;
+	void* arg;
+	size_t n;
+	size_t chunk;
+	size_t num_chunks;
+	size_t next_chunk;
+}Thread_Pool_t;
+
+static Thread_Pool_t pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.work_ready = PTHREAD_COND_INITIALIZER,
+	.work_done = PTHREAD_COND_INITIALIZER,
+	.dispatch = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/* set on pool threads and on a caller while it dispatches, nested calls run inline */
+static __thread bool inside_pool = false;
+
+/*
+ * PURPOSE: claim chunks of the current job until none are left
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  nothing
+ *
+ **/
+static void run_chunks (void) {
+	for (;;) {
+		const size_t c = __atomic_fetch_add(&pool.next_chunk, 1, __ATOMIC_RELAXED);
+		if (c >= pool.num_chunks) {
+			return;
+		}
+		const size_t begin = c * pool.chunk;
+		const size_t end = (pool.n - begin < pool.chunk) ? pool.n : begin + pool.chunk;
+		pool.task(begin,end,pool.arg);
+	}
+}
+
+/*
+ * PURPOSE: body of every pool thread, sleeps until a new job generation is posted
+ * INPUTS:
+ *	arg the job generation current when the thread was spawned
+ * RETURN:
+ *  NULL once the pool shuts down
+ *
+ **/
+static void* worker_main (void* arg) {
+	inside_pool = true;
+	unsigned long seen = (unsigned long) (uintptr_t) arg;
+
+	pthread_mutex_lock(&pool.lock);
+	for (;;) {
+		while (!pool.shutting_down && pool.generation == seen) {
+			pthread_cond_wait(&pool.work_ready,&pool.lock);
+		}
+		if (pool.shutting_down) {
+			break;
+		}
+		seen = pool.generation;
+		pthread_mutex_unlock(&pool.lock);
+
+		run_chunks();
+
+		pthread_mutex_lock(&pool.lock);
+		if (--pool.active == 0) {
+			pthread_cond_signal(&pool.work_done);
+		}
+	}
+	pthread_mutex_unlock(&pool.lock);
+	return NULL;
+}
+
+/*
+ * PURPOSE: number of threads to use when none was requested explicitly,
+ *	taken from MATLAB_THREADS or else the number of online cpus
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  a thread count of at least 1
+ *
+ **/
+unsigned int threadpool_default_size (void) {
+	const char* env = getenv("MATLAB_THREADS");
+	if (env != NULL) {
+		const int requested = atoi(env);
+		if (requested > 0) {
+			return requested;
+		}
+	}
+	const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	return cpus > 0 ? (unsigned int) cpus : 1;
+}
+
+/*
+ * PURPOSE: starts the process wide worker pool, replacing any previous one
+ * INPUTS:
+ *	num_threads total threads including the caller, 0 for the default
+ * RETURN:
+ *  If no errors occurred then true
+ *  else false and the pool is left single threaded.
+ *
+ **/
+bool threadpool_init (unsigned int num_threads) {
+	threadpool_destroy();
+	if (num_threads == 0) {
+		num_threads = threadpool_default_size();
+	}
+	if (num_threads == 1) {
+		pool.num_threads = 1;
+		return true;
+	}
+
+	pool.workers = calloc(num_threads - 1,sizeof(pthread_t));
+	if (!pool.workers) {
+		return false;
+	}
+	pool.shutting_down = false;
+	for (unsigned int i = 0; i < num_threads - 1; ++i) {
+		if (pthread_create(&pool.workers[i],NULL,worker_main,(void*) (uintptr_t) pool.generation)) {
+			perror("FAILED TO START WORKER THREAD\n");
+			pool.num_threads = i + 1;
+			threadpool_destroy();
+			return false;
+		}
+	}
+	pool.num_threads = num_threads;
+	return true;
+}
+
+/*
+ * PURPOSE: stops and joins every worker of the pool
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  nothing
+ *
+ **/
+void threadpool_destroy (void) {
+	if (pool.workers) {
+		pthread_mutex_lock(&pool.lock);
+		pool.shutting_down = true;
+		pthread_cond_broadcast(&pool.work_ready);
+		pthread_mutex_unlock(&pool.lock);
+		for (unsigned int i = 0; i + 1 < pool.num_threads; ++i) {
+			pthread_join(pool.workers[i],NULL);
+		}
+		free(pool.workers);
+		pool.workers = NULL;
+	}
+	pool.num_threads = 0;
+}
+
+/*
+ * PURPOSE: number of threads a parallel_for can use
+ * INPUTS:
+ *	none
+ * RETURN:
+ *  thread count, 1 when the pool was never started
+ *
+ **/
+unsigned int threadpool_size (void) {
+	return pool.num_threads > 0 ? pool.num_threads : 1;
+}
+
+/*
+ * PURPOSE: runs task over [0,n) split into cache line aligned chunks on the pool,
+ *	small ranges, nested calls and calls racing another dispatch run inline
+ * INPUTS:
+ *	n number of elements
+ *  elem_size size of one element in bytes, used to align chunk boundaries
+ *  task called once per chunk with [begin,end)
+ *  arg passed through to task
+ * RETURN:
+ *  nothing, returns after every chunk has finished
+ *
+ **/
+void parallel_for (size_t n, size_t elem_size, Parallel_Task_t task, void* arg) {
+	if (n == 0) {
+		return;
+	}
+	if (pool.num_threads <= 1 || n < PARALLEL_MIN_ELEMENTS || inside_pool
+		|| pthread_mutex_trylock(&pool.dispatch) != 0) {
+		task(0,n,arg);
+		return;
+	}
+	inside_pool = true;
+
+	const size_t align = (elem_size > 0 && elem_size < CACHE_LINE_SIZE) ? CACHE_LINE_SIZE / elem_size : 1;
+	const size_t wanted = (size_t) pool.num_threads * CHUNKS_PER_THREAD;
+	size_t chunk = (n + wanted - 1) / wanted;
+	chunk = (chunk + align - 1) / align * align;
+
+	pthread_mutex_lock(&pool.lock);
+	pool.task = task;
+	pool.arg = arg;
+	pool.n = n;
+	pool.chunk = chunk;
+	pool.num_chunks = (n + chunk - 1) / chunk;
+	pool.next_chunk = 0;
+	pool.active = pool.num_threads - 1;
+	pool.generation++;
+	pthread_cond_broadcast(&pool.work_ready);
+	pthread_mutex_unlock(&pool.lock);
+
+	run_chunks();
+
+	pthread_mutex_lock(&pool.lock);
+	while (pool.active > 0) {
+		pthread_cond_wait(&pool.work_done,&pool.lock);
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	inside_pool = false;
+	pthread_mutex_unlock(&pool.dispatch);
+}
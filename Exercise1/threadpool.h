@@ -0,0 +1,18 @@
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* element ranges smaller than this are run on the calling thread */
+#define PARALLEL_MIN_ELEMENTS (1 << 16)
+
+typedef void (*Parallel_Task_t) (size_t begin, size_t end, void* arg);
+
+bool threadpool_init (unsigned int num_threads);
+void threadpool_destroy (void);
+unsigned int threadpool_size (void);
+unsigned int threadpool_default_size (void);
+void parallel_for (size_t n, size_t elem_size, Parallel_Task_t task, void* arg);
+
+#endif